@@ -284,14 +284,14 @@ void VehicleCargoList::Append(CargoPacket *cp, MoveToAction action)
 template<class Taction>
 void VehicleCargoList::ShiftCargo(Taction action)
 {
-	Iterator it(this->packets.begin());
-	while (it != this->packets.end() && action.MaxMove() > 0) {
-		CargoPacket *cp = *it;
-		if (action(cp)) {
-			it = this->packets.erase(it);
-		} else {
-			break;
-		}
+	/* Reroute actions may push packets to the front of this very list; they
+	 * end up before the current packet, so skip over them. */
+	size_t pos = 0;
+	while (pos < this->packets.size() && action.MaxMove() > 0) {
+		size_t size = this->packets.size();
+		if (!action(this->packets[pos])) break;
+		pos += this->packets.size() - size;
+		this->packets.erase(this->packets.begin() + pos);
 	}
 }
 
@@ -306,21 +306,9 @@ void VehicleCargoList::ShiftCargo(Taction action)
 template<class Taction>
 void VehicleCargoList::PopCargo(Taction action)
 {
-	if (this->packets.empty()) return;
-	Iterator it(--(this->packets.end()));
-	Iterator begin(this->packets.begin());
-	while (action.MaxMove() > 0) {
-		CargoPacket *cp = *it;
-		if (action(cp)) {
-			if (it != begin) {
-				this->packets.erase(it--);
-			} else {
-				this->packets.erase(it);
-				break;
-			}
-		} else {
-			break;
-		}
+	while (!this->packets.empty() && action.MaxMove() > 0) {
+		if (!action(this->packets.back())) break;
+		this->packets.pop_back();
 	}
 }
 
@@ -448,18 +436,17 @@ bool VehicleCargoList::Stage(bool accepted, StationID current_station, StationID
 	this->AssertCountConsistency();
 	assert(this->action_counts[MTA_LOAD] == 0);
 	this->action_counts[MTA_TRANSFER] = this->action_counts[MTA_DELIVER] = this->action_counts[MTA_KEEP] = 0;
-	Iterator deliver = this->packets.end();
-	Iterator it = this->packets.begin();
-	uint sum = 0;
+	/* Packets to be transferred are collected in reverse order before the ones
+	 * to be delivered; packets to be kept are compacted in place. */
+	CargoPacketList unload;
+	Iterator keep = this->packets.begin();
 
 	bool force_keep = (order_flags & OUFB_NO_UNLOAD) != 0;
 	bool force_unload = (order_flags & OUFB_UNLOAD) != 0;
 	bool force_transfer = (order_flags & (OUFB_TRANSFER | OUFB_UNLOAD)) != 0;
-	assert(this->count > 0 || it == this->packets.end());
-	while (sum < this->count) {
+	for (Iterator it = this->packets.begin(); it != this->packets.end(); ++it) {
 		CargoPacket *cp = *it;
 
-		this->packets.erase(it++);
 		StationID cargo_next = INVALID_STATION;
 		MoveToAction action = MTA_LOAD;
 		if (force_keep) {
@@ -510,14 +497,13 @@ bool VehicleCargoList::Stage(bool accepted, StationID current_station, StationID
 		Money share;
 		switch (action) {
 			case MTA_KEEP:
-				this->packets.push_back(cp);
-				if (deliver == this->packets.end()) --deliver;
+				*keep++ = cp;
 				break;
 			case MTA_DELIVER:
-				this->packets.insert(deliver, cp);
+				unload.push_back(cp);
 				break;
 			case MTA_TRANSFER:
-				this->packets.push_front(cp);
+				unload.push_front(cp);
 				/* Add feeder share here to allow reusing field for next station. */
 				share = payment->PayTransfer(cp, cp->count);
 				cp->AddFeederShare(share);
@@ -528,8 +514,9 @@ bool VehicleCargoList::Stage(bool accepted, StationID current_station, StationID
 				NOT_REACHED();
 		}
 		this->action_counts[action] += cp->count;
-		sum += cp->count;
 	}
+	this->packets.erase(keep, this->packets.end());
+	this->packets.insert(this->packets.begin(), unload.begin(), unload.end());
 	this->AssertCountConsistency();
 	return this->action_counts[MTA_DELIVER] > 0 || this->action_counts[MTA_TRANSFER] > 0;
 }
@@ -584,7 +571,7 @@ uint VehicleCargoList::Reassign<VehicleCargoList::MTA_DELIVER, VehicleCargoList:
 		if (sum > this->action_counts[MTA_TRANSFER] + max_move) {
 			CargoPacket *cp_split = cp->Split(sum - this->action_counts[MTA_TRANSFER] + max_move);
 			sum -= cp_split->Count();
-			this->packets.insert(it, cp_split);
+			it = this->packets.insert(it, cp_split);
 		}
 		cp->next_station = next_station;
 	}
@@ -774,37 +761,49 @@ uint StationCargoList::Truncate(uint max_move, StationCargoAmountMap *cargo_per_
 	uint loop = 0;
 	bool do_count = cargo_per_source != nullptr;
 	while (max_move > moved) {
-		for (Iterator it(this->packets.begin()); it != this->packets.end();) {
-			CargoPacket *cp = *it;
-			if (prev_count > max_move && RandomRange(prev_count) < prev_count - max_move) {
-				if (do_count && loop == 0) {
-					(*cargo_per_source)[cp->source] += cp->count;
+		for (StationCargoPacketMap::MapIterator map_it(this->packets.begin()); map_it != this->packets.end();) {
+			/* Compact the surviving packets of each range in place instead of
+			 * erasing them one by one from the middle of the deque. */
+			StationCargoPacketMap::List &list = map_it->second;
+			StationCargoPacketMap::ListIterator keep = list.begin();
+			for (StationCargoPacketMap::ListIterator it = list.begin(); it != list.end(); ++it) {
+				CargoPacket *cp = *it;
+				if (prev_count > max_move && RandomRange(prev_count) < prev_count - max_move) {
+					if (do_count && loop == 0) {
+						(*cargo_per_source)[cp->source] += cp->count;
+					}
+					*keep++ = cp;
+					continue;
 				}
-				++it;
-				continue;
-			}
-			uint diff = max_move - moved;
-			if (cp->count > diff) {
-				if (diff > 0) {
-					this->RemoveFromCache(cp, diff);
-					cp->Reduce(diff);
-					moved += diff;
-				}
-				if (loop > 0) {
-					if (do_count) (*cargo_per_source)[cp->source] -= diff;
-					return moved;
+				uint diff = max_move - moved;
+				if (cp->count > diff) {
+					if (diff > 0) {
+						this->RemoveFromCache(cp, diff);
+						cp->Reduce(diff);
+						moved += diff;
+					}
+					if (loop > 0) {
+						if (do_count) (*cargo_per_source)[cp->source] -= diff;
+						list.erase(std::copy(it, list.end(), keep), list.end());
+						return moved;
+					} else {
+						if (do_count) (*cargo_per_source)[cp->source] += cp->count;
+						*keep++ = cp;
+					}
 				} else {
-					if (do_count) (*cargo_per_source)[cp->source] += cp->count;
-					++it;
+					if (do_count && loop > 0) {
+						(*cargo_per_source)[cp->source] -= cp->count;
+					}
+					moved += cp->count;
+					this->RemoveFromCache(cp, cp->count);
+					delete cp;
 				}
+			}
+			list.erase(keep, list.end());
+			if (list.empty()) {
+				this->packets.StationCargoPacketMap::Map::erase(map_it++);
 			} else {
-				it = this->packets.erase(it);
-				if (do_count && loop > 0) {
-					(*cargo_per_source)[cp->source] -= cp->count;
-				}
-				moved += cp->count;
-				this->RemoveFromCache(cp, cp->count);
-				delete cp;
+				++map_it;
 			}
 		}
 		loop++;
@@ -251,14 +251,17 @@ static inline void SetFence(TileIndex t, DiagDirection side, uint h)
 
 
 /**
- * Make a clear tile.
+ * Make a clear tile without marking the tile types as changed for the
+ * incremental savegame. Only for filling many tiles at once, possibly from
+ * several threads; the caller has to set #_m_type_changed afterwards.
  * @param t       the tile to make a clear tile
  * @param g       the type of ground
  * @param density the density of the grass/snow/desert etc
  */
-static inline void MakeClear(TileIndex t, ClearGround g, uint density)
+static inline void MakeClearUnmarked(TileIndex t, ClearGround g, uint density)
 {
-	SetTileType(t, MP_CLEAR);
+	assert(IsInnerTile(t));
+	SB(_m_type[t], 4, 4, MP_CLEAR);
 	_m[t].m1 = 0;
 	SetTileOwner(t, OWNER_NONE);
 	_m[t].m2 = 0;
@@ -270,6 +273,18 @@ static inline void MakeClear(TileIndex t, ClearGround g, uint density)
 	_me[t].m8 = 0;
 }
 
+/**
+ * Make a clear tile.
+ * @param t       the tile to make a clear tile
+ * @param g       the type of ground
+ * @param density the density of the grass/snow/desert etc
+ */
+static inline void MakeClear(TileIndex t, ClearGround g, uint density)
+{
+	MakeClearUnmarked(t, g, density);
+	_m_type_changed = true;
+}
+
 
 /**
  * Make a (farm) field tile.
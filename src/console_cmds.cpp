@@ -37,6 +37,10 @@
 #include "console_func.h"
 #include "engine_base.h"
 #include "game/game.hpp"
+#include "pathfinder/yapf/yapf_cache.h"
+#include "pathfinder/pf_benchmark.h"
+#include "linkgraph/mcf.h"
+#include "tgp.h"
 #include "table/strings.h"
 #include <time.h>
 
@@ -1331,6 +1335,121 @@ DEF_CONSOLE_CMD(ConGetDate)
 	return true;
 }
 
+DEF_CONSOLE_CMD(ConYapfCache)
+{
+	if (argc == 0) {
+		IConsoleHelp("Show the hit rate of the rail pathfinder's segment cache. Usage: 'yapf_cache [reset]'");
+		return true;
+	}
+
+	if (argc == 2 && strcmp(argv[1], "reset") == 0) {
+		YapfResetCacheStats();
+		return true;
+	}
+
+	uint segments;
+	YapfCacheStats stats = YapfGetCacheStats(&segments);
+	uint64 lookups = stats.hits + stats.misses;
+	IConsolePrintF(CC_DEFAULT, "Cached segments: %u", segments);
+	IConsolePrintF(CC_DEFAULT, "Hits:            " OTTD_PRINTF64 " (%.1f%%)", (int64)stats.hits, lookups == 0 ? 0.0 : 100.0 * stats.hits / lookups);
+	IConsolePrintF(CC_DEFAULT, "Misses:          " OTTD_PRINTF64, (int64)stats.misses);
+	IConsolePrintF(CC_DEFAULT, "Evictions:       " OTTD_PRINTF64, (int64)stats.evictions);
+	IConsolePrintF(CC_DEFAULT, "Flushes:         " OTTD_PRINTF64, (int64)stats.flushes);
+	return true;
+}
+
+DEF_CONSOLE_CMD(ConPfBenchmark)
+{
+	if (argc == 0) {
+		IConsoleHelp("Replay every pathfinder query of the coming ticks against all pathfinders and report how they compare. Usage: 'pf_benchmark <ticks>'");
+		IConsoleHelp("The replays do not reserve paths nor change path caches, so the game itself continues as usual.");
+		return true;
+	}
+
+	uint32 ticks;
+	if (argc != 2 || !GetArgumentInteger(&ticks, argv[1]) || ticks == 0) return false;
+
+	PfBenchmarkStart(ticks);
+	IConsolePrintF(CC_DEFAULT, "Replaying the pathfinder queries of the coming %u ticks.", ticks);
+	return true;
+}
+
+DEF_CONSOLE_CMD(ConMcfBenchmark)
+{
+	if (argc == 0) {
+		IConsoleHelp("Time both passes of the link graph's flow calculation on synthetic link graphs. Usage: 'mcf_benchmark [<nodes>]'");
+		IConsoleHelp("Without a number of nodes, link graphs of 100, 250, 500 and 1000 nodes are used. Up to 5000 nodes can be given, which takes minutes.");
+		IConsoleHelp("The current link graph settings apply.");
+		return true;
+	}
+
+	static const uint DEFAULT_SIZES[] = {100, 250, 500, 1000};
+	uint32 size = 0;
+	if (argc > 2 || (argc == 2 && (!GetArgumentInteger(&size, argv[1]) || size < 2 || size > 5000))) return false;
+
+	for (uint i = 0; i < lengthof(DEFAULT_SIZES); i++) {
+		uint nodes = size != 0 ? size : DEFAULT_SIZES[i];
+		uint64 first_pass, second_pass;
+		BenchmarkMCF(nodes, &first_pass, &second_pass);
+		IConsolePrintF(CC_DEFAULT, "%4u nodes: first pass %8.1f ms, second pass %8.1f ms", nodes, first_pass / 1000.0, second_pass / 1000.0);
+		if (size != 0) break;
+	}
+	return true;
+}
+
+DEF_CONSOLE_CMD(ConMapBenchmark)
+{
+	if (argc == 0) {
+		IConsoleHelp("Time scans over the tile types and heights of the current map, with the types and heights in arrays of their own and interleaved with the other tile fields. Usage: 'map_benchmark [<runs>]'");
+		IConsoleHelp("One scan counts the tiles of every type, the other visits every tile in tile loop order. The default is 10 runs.");
+		return true;
+	}
+
+	uint32 runs = 10;
+	if (argc > 2 || (argc == 2 && (!GetArgumentInteger(&runs, argv[1]) || runs == 0))) return false;
+
+	MapLayoutBenchmarkResult result = BenchmarkMapLayout(runs);
+	IConsolePrintF(CC_DEFAULT, "Type histogram: %8.2f ms per run separate, %8.2f ms interleaved", result.histogram_planes / 1000.0 / runs, result.histogram_interleaved / 1000.0 / runs);
+	IConsolePrintF(CC_DEFAULT, "Tile loop:      %8.2f ms per run separate, %8.2f ms interleaved", result.tile_loop_planes / 1000.0 / runs, result.tile_loop_interleaved / 1000.0 / runs);
+	if (!result.identical) IConsoleError("The layouts gave different results.");
+	return true;
+}
+
+DEF_CONSOLE_CMD(ConTgpBenchmark)
+{
+	if (argc == 0) {
+		IConsoleHelp("Time generating the height map of the TerraGenesis map generator for every square map size, with every set of kernels. Usage: 'tgp_benchmark [<runs> [<max size>]]'");
+		IConsoleHelp("The current seed and map generation settings are used; the map itself is not changed. The default is 1 run of every size up to 4096.");
+		IConsoleHelp("The height maps are compared with those of the reference, which does the sine transform and curve maps per tile.");
+		return true;
+	}
+
+	uint32 runs = 1;
+	uint32 max_size = MAX_MAP_SIZE;
+	if (argc > 3 || (argc >= 2 && (!GetArgumentInteger(&runs, argv[1]) || runs == 0))) return false;
+	if (argc == 3 && (!GetArgumentInteger(&max_size, argv[2]) || max_size < MIN_MAP_SIZE)) return false;
+
+	if (_generating_world) {
+		IConsoleError("Cannot benchmark the map generator while a map is being generated.");
+		return true;
+	}
+
+	for (uint size_bits = MIN_MAP_SIZE_BITS; size_bits <= MAX_MAP_SIZE_BITS && (1U << size_bits) <= max_size; size_bits++) {
+		IConsolePrintF(CC_DEFAULT, "%ux%u:", 1U << size_bits, 1U << size_bits);
+
+		std::vector<TgpBenchmarkResult> results = BenchmarkTerrainPerlin(size_bits, runs);
+		for (const TgpBenchmarkResult &result : results) {
+			uint64 total = 0;
+			for (uint64 time : result.time) total += time;
+			const uint64 *t = result.time;
+			IConsolePrintF(CC_DEFAULT, "  %-9s %8.1f ms: generate %.1f, water level %.1f, coasts %.1f, smooth slopes %.1f, sine %.1f, curves %.1f%s", result.kernels,
+					total / 1000.0 / runs, t[TGPS_GENERATE] / 1000.0 / runs, t[TGPS_WATER_LEVEL] / 1000.0 / runs, t[TGPS_COASTS] / 1000.0 / runs,
+					t[TGPS_SMOOTH_SLOPES] / 1000.0 / runs, t[TGPS_SINE] / 1000.0 / runs, t[TGPS_CURVES] / 1000.0 / runs, result.identical ? "" : ", height map DIFFERS");
+		}
+	}
+	return true;
+}
+
 DEF_CONSOLE_CMD(ConGetSysDate)
 {
 	if (argc == 0) {
@@ -2092,6 +2211,11 @@ void IConsoleStdLibRegister()
 	IConsoleCmdRegister("getseed",      ConGetSeed);
 	IConsoleCmdRegister("getdate",      ConGetDate);
 	IConsoleCmdRegister("getsysdate",   ConGetSysDate);
+	IConsoleCmdRegister("yapf_cache",   ConYapfCache);
+	IConsoleCmdRegister("pf_benchmark", ConPfBenchmark);
+	IConsoleCmdRegister("mcf_benchmark", ConMcfBenchmark);
+	IConsoleCmdRegister("tgp_benchmark", ConTgpBenchmark);
+	IConsoleCmdRegister("map_benchmark", ConMapBenchmark);
 	IConsoleCmdRegister("quit",         ConExit);
 	IConsoleCmdRegister("resetengines", ConResetEngines, ConHookNoNetwork);
 	IConsoleCmdRegister("reset_enginepool", ConResetEnginePool, ConHookNoNetwork);
@@ -239,8 +239,9 @@ class Kdtree {
 		if (b.first < a.first) return b;
 		NOT_REACHED(); // a.first == b.first: same element must not be inserted twice
 	}
-	/** Search a sub-tree for the element nearest to a given point */
-	node_distance FindNearestRecursive(CoordT xy[2], size_t node_idx, int level, DistT limit = std::numeric_limits<DistT>::max()) const
+	/** Search a sub-tree for the element nearest to a given point, skipping elements rejected by a filter */
+	template <typename Filter>
+	node_distance FindNearestRecursive(CoordT xy[2], size_t node_idx, int level, Filter filter, DistT limit = std::numeric_limits<DistT>::max()) const
 	{
 		/* Dimension index of current level */
 		int dim = level % 2;
@@ -249,8 +250,8 @@ class Kdtree {
 
 		/* Coordinate of element splitting at this node */
 		CoordT c = this->xyfunc(n.element, dim);
-		/* This node's distance to target */
-		DistT thisdist = ManhattanDistance(n.element, xy[0], xy[1]);
+		/* This node's distance to target; rejected elements are infinitely far away */
+		DistT thisdist = filter(n.element) ? ManhattanDistance(n.element, xy[0], xy[1]) : std::numeric_limits<DistT>::max();
 		/* Assume this node is the best choice for now */
 		node_distance best = std::make_pair(n.element, thisdist);
 
@@ -258,7 +259,7 @@ class Kdtree {
 		size_t next = (xy[dim] < c) ? n.left : n.right;
 		if (next != INVALID_NODE) {
 			/* Check if there is a better node down the tree */
-			best = SelectNearestNodeDistance(best, this->FindNearestRecursive(xy, next, level + 1));
+			best = SelectNearestNodeDistance(best, this->FindNearestRecursive(xy, next, level + 1, filter));
 		}
 
 		limit = min(best.second, limit);
@@ -267,7 +268,7 @@ class Kdtree {
 		 * if it is we also need to check the other side of the split. */
 		size_t opposite = (xy[dim] >= c) ? n.left : n.right; // reverse of above
 		if (opposite != INVALID_NODE && limit >= abs((int)xy[dim] - (int)c)) {
-			node_distance other_candidate = this->FindNearestRecursive(xy, opposite, level + 1, limit);
+			node_distance other_candidate = this->FindNearestRecursive(xy, opposite, level + 1, filter, limit);
 			best = SelectNearestNodeDistance(best, other_candidate);
 		}
 
@@ -446,7 +447,25 @@ public:
 		assert(this->Count() > 0);
 
 		CoordT xy[2] = { x, y };
-		return this->FindNearestRecursive(xy, this->root, 0).first;
+		return this->FindNearestRecursive(xy, this->root, 0, [](const T &) { return true; }).first;
+	}
+
+	/**
+	 * Find the element closest to given coordinate, in Manhattan distance, among
+	 * the elements accepted by a filter. Ties are broken like in FindNearest.
+	 * @param x First coordinate of the point to search around.
+	 * @param y Second coordinate of the point to search around.
+	 * @param filter Predicate telling whether an element may be returned.
+	 * @return The nearest accepted element and its distance; the distance is the
+	 *         maximum value of DistT if no element is accepted.
+	 */
+	template <typename Filter>
+	std::pair<T, DistT> FindNearest(CoordT x, CoordT y, Filter filter) const
+	{
+		assert(this->Count() > 0);
+
+		CoordT xy[2] = { x, y };
+		return this->FindNearestRecursive(xy, this->root, 0, filter);
 	}
 
 	/**
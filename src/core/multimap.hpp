@@ -11,7 +11,7 @@
 #define MULTIMAP_HPP
 
 #include <map>
-#include <list>
+#include <deque>
 
 template<typename Tkey, typename Tvalue, typename Tcompare>
 class MultiMap;
@@ -278,12 +278,14 @@ bool operator!=(const Tmap_iter2 &iter2, const MultiMapIterator<Tmap_iter1, Tlis
  * by Tkey so that you can easily look up ranges of equal keys. Those ranges are
  * internally ordered in a deterministic way (contrary to STL multimap). All
  * STL-compatible members are named in STL style, all others are named in OpenTTD
- * style.
+ * style. The ranges are stored as chunked deques, so inserting into or erasing
+ * from a range invalidates all iterators pointing into that range; iterators
+ * into other ranges stay valid.
  */
 template<typename Tkey, typename Tvalue, typename Tcompare = std::less<Tkey> >
-class MultiMap : public std::map<Tkey, std::list<Tvalue>, Tcompare > {
+class MultiMap : public std::map<Tkey, std::deque<Tvalue>, Tcompare > {
 public:
-	typedef typename std::list<Tvalue> List;
+	typedef typename std::deque<Tvalue> List;
 	typedef typename List::iterator ListIterator;
 	typedef typename List::const_iterator ConstListIterator;
 
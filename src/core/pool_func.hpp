@@ -19,8 +19,8 @@
  * @param type The return type of the method.
  */
 #define DEFINE_POOL_METHOD(type) \
-	template <class Titem, typename Tindex, size_t Tgrowth_step, size_t Tmax_size, PoolType Tpool_type, bool Tcache, bool Tzero> \
-	type Pool<Titem, Tindex, Tgrowth_step, Tmax_size, Tpool_type, Tcache, Tzero>
+	template <class Titem, typename Tindex, size_t Tgrowth_step, size_t Tmax_size, PoolType Tpool_type, bool Tcache, bool Tzero, bool Tdense> \
+	type Pool<Titem, Tindex, Tgrowth_step, Tmax_size, Tpool_type, Tcache, Tzero, Tdense>
 
 /**
  * Create a clean pool.
@@ -38,6 +38,8 @@ DEFINE_POOL_METHOD(inline)::Pool(const char *name) :
 #endif /* OTTD_ASSERT */
 		cleaning(false),
 		data(nullptr),
+		used(nullptr),
+		chunks(nullptr),
 		alloc_cache(nullptr)
 { }
 
@@ -57,6 +59,16 @@ DEFINE_POOL_METHOD(inline void)::ResizeFor(size_t index)
 	this->data = ReallocT(this->data, new_size);
 	MemSetT(this->data + this->size, 0, new_size - this->size);
 
+	size_t used_words = CeilDiv(this->size, 32);
+	size_t new_used_words = CeilDiv(new_size, 32);
+	this->used = ReallocT(this->used, new_used_words);
+	MemSetT(this->used + used_words, 0, new_used_words - used_words);
+
+	if (Tdense) {
+		this->chunks = ReallocT(this->chunks, new_size / Tgrowth_step);
+		MemSetT(this->chunks + this->size / Tgrowth_step, 0, (new_size - this->size) / Tgrowth_step);
+	}
+
 	this->size = new_size;
 }
 
@@ -104,7 +116,13 @@ DEFINE_POOL_METHOD(inline void *)::AllocateItem(size_t size, size_t index)
 	this->items++;
 
 	Titem *item;
-	if (Tcache && this->alloc_cache != nullptr) {
+	if (Tdense) {
+		assert(sizeof(Titem) == size);
+		byte *&chunk = this->chunks[index / Tgrowth_step];
+		if (chunk == nullptr) chunk = MallocT<byte>(Tgrowth_step * sizeof(Titem));
+		item = (Titem *)(chunk + (index % Tgrowth_step) * sizeof(Titem));
+		if (Tzero) memset((void *)item, 0, sizeof(Titem));
+	} else if (Tcache && this->alloc_cache != nullptr) {
 		assert(sizeof(Titem) == size);
 		item = (Titem *)this->alloc_cache;
 		this->alloc_cache = this->alloc_cache->next;
@@ -119,6 +137,7 @@ DEFINE_POOL_METHOD(inline void *)::AllocateItem(size_t size, size_t index)
 		item = (Titem *)MallocT<byte>(size);
 	}
 	this->data[index] = item;
+	SetBit(this->used[index / 32], index % 32);
 	item->index = (Tindex)(uint)index;
 	return item;
 }
@@ -179,7 +198,9 @@ DEFINE_POOL_METHOD(void)::FreeItem(size_t index)
 {
 	assert(index < this->size);
 	assert(this->data[index] != nullptr);
-	if (Tcache) {
+	if (Tdense) {
+		/* The memory stays part of the chunk. */
+	} else if (Tcache) {
 		AllocCache *ac = (AllocCache *)this->data[index];
 		ac->next = this->alloc_cache;
 		this->alloc_cache = ac;
@@ -187,6 +208,7 @@ DEFINE_POOL_METHOD(void)::FreeItem(size_t index)
 		free(this->data[index]);
 	}
 	this->data[index] = nullptr;
+	ClrBit(this->used[index / 32], index % 32);
 	this->first_free = min(this->first_free, index);
 	this->items--;
 	if (!this->cleaning) Titem::PostDestructor(index);
@@ -200,9 +222,16 @@ DEFINE_POOL_METHOD(void)::CleanPool()
 		delete this->Get(i); // 'delete nullptr;' is very valid
 	}
 	assert(this->items == 0);
+	if (Tdense) {
+		for (size_t i = 0; i < this->size / Tgrowth_step; i++) free(this->chunks[i]);
+	}
 	free(this->data);
+	free(this->used);
+	free(this->chunks);
 	this->first_unused = this->first_free = this->size = 0;
 	this->data = nullptr;
+	this->used = nullptr;
+	this->chunks = nullptr;
 	this->cleaning = false;
 
 	if (Tcache) {
@@ -12,6 +12,8 @@
 
 #include "smallvec_type.hpp"
 #include "enum_type.hpp"
+#include "bitmath_func.hpp"
+#include "math_func.hpp"
 
 /** Various types of a pool. */
 enum PoolType {
@@ -75,12 +77,17 @@ private:
  * @tparam Tpool_type   Type of this pool
  * @tparam Tcache       Whether to perform 'alloc' caching, i.e. don't actually free/malloc just reuse the memory
  * @tparam Tzero        Whether to zero the memory
- * @warning when Tcache is enabled *all* instances of this pool's item must be of the same size.
+ * @tparam Tdense       Whether to store the items in chunks of Tgrowth_step items, item N being at position N of its chunk, instead of allocating each item separately
+ * @warning when Tcache or Tdense is enabled *all* instances of this pool's item must be of the same size.
  */
-template <class Titem, typename Tindex, size_t Tgrowth_step, size_t Tmax_size, PoolType Tpool_type = PT_NORMAL, bool Tcache = false, bool Tzero = true>
+template <class Titem, typename Tindex, size_t Tgrowth_step, size_t Tmax_size, PoolType Tpool_type = PT_NORMAL, bool Tcache = false, bool Tzero = true, bool Tdense = false>
 struct Pool : PoolBase {
 	/* Ensure Tmax_size is within the bounds of Tindex. */
 	assert_compile((uint64)(Tmax_size - 1) >> 8 * sizeof(Tindex) == 0);
+	/* Dense pools never free the memory of single items, so there is nothing to cache. */
+	assert_compile(!Tdense || !Tcache);
+	/* Dense pools consist of whole chunks only. */
+	assert_compile(!Tdense || Tmax_size % Tgrowth_step == 0);
 
 	static const size_t MAX_SIZE = Tmax_size; ///< Make template parameter accessible from outside
 
@@ -96,6 +103,8 @@ struct Pool : PoolBase {
 	bool cleaning;       ///< True if cleaning pool (deleting all items)
 
 	Titem **data;        ///< Pointer to array of pointers to Titem
+	uint32 *used;        ///< Bitmap of the indexes that are in use, to quickly skip the free ones
+	byte **chunks;       ///< For dense pools, the memory of every Tgrowth_step items; allocated when first needed
 
 	Pool(const char *name);
 	virtual void CleanPool();
@@ -122,6 +131,21 @@ struct Pool : PoolBase {
 		return index < this->first_unused && this->Get(index) != nullptr;
 	}
 
+	/**
+	 * Find the first index, starting at the given one, that is in use.
+	 * @param index index to start searching at
+	 * @return the found index, or this->first_unused when there is none
+	 */
+	inline size_t FindUsedIndex(size_t index)
+	{
+		while (index < this->first_unused) {
+			uint32 bits = this->used[index / 32] >> (index % 32);
+			if (bits != 0) return min(index + FindFirstBit(bits), this->first_unused);
+			index = Align(index + 1, 32);
+		}
+		return this->first_unused;
+	}
+
 	/**
 	 * Tests whether we can allocate 'n' items
 	 * @param n number of items we want to allocate
@@ -160,7 +184,10 @@ struct Pool : PoolBase {
 
 	private:
 		size_t index;
-		void ValidateIndex() { while (this->index < T::GetPoolSize() && !(T::IsValidID(this->index))) this->index++; }
+		void ValidateIndex()
+		{
+			while ((this->index = T::FindUsedIndex(this->index)) < T::GetPoolSize() && !(T::IsValidID(this->index))) this->index++;
+		}
 	};
 
 	/*
@@ -201,7 +228,10 @@ struct Pool : PoolBase {
 	private:
 		size_t index;
 		F filter;
-		void ValidateIndex() { while (this->index < T::GetPoolSize() && !(T::IsValidID(this->index) && this->filter(this->index))) this->index++; }
+		void ValidateIndex()
+		{
+			while ((this->index = T::FindUsedIndex(this->index)) < T::GetPoolSize() && !(T::IsValidID(this->index) && this->filter(this->index))) this->index++;
+		}
 	};
 
 	/*
@@ -222,12 +252,12 @@ struct Pool : PoolBase {
 	 * Base class for all PoolItems
 	 * @tparam Tpool The pool this item is going to be part of
 	 */
-	template <struct Pool<Titem, Tindex, Tgrowth_step, Tmax_size, Tpool_type, Tcache, Tzero> *Tpool>
+	template <struct Pool<Titem, Tindex, Tgrowth_step, Tmax_size, Tpool_type, Tcache, Tzero, Tdense> *Tpool>
 	struct PoolItem {
 		Tindex index; ///< Index of this pool item
 
 		/** Type of the pool this item is going to be part of */
-		typedef struct Pool<Titem, Tindex, Tgrowth_step, Tmax_size, Tpool_type, Tcache, Tzero> Pool;
+		typedef struct Pool<Titem, Tindex, Tgrowth_step, Tmax_size, Tpool_type, Tcache, Tzero, Tdense> Pool;
 
 		/**
 		 * Allocates space for new Titem
@@ -352,6 +382,17 @@ struct Pool : PoolBase {
 			return Tpool->first_unused;
 		}
 
+		/**
+		 * Returns the first index, starting at the given one, that is in use.
+		 * Useful for quickly skipping free indexes when iterating over all pool items.
+		 * @param index index to start searching at
+		 * @return the found index, or GetPoolSize() when there is none
+		 */
+		static inline size_t FindUsedIndex(size_t index)
+		{
+			return Tpool->FindUsedIndex(index);
+		}
+
 		/**
 		 * Returns number of valid items in the pool
 		 * @return number of valid items in the pool
@@ -39,6 +39,7 @@
 #include "object_base.h"
 #include "game/game.hpp"
 #include "error.h"
+#include "industry_kdtree.h"
 
 #include "table/strings.h"
 #include "table/industry_land.h"
@@ -49,6 +50,17 @@
 IndustryPool _industry_pool("Industry");
 INSTANTIATE_POOL_METHODS(Industry)
 
+IndustryKdtree _industry_kdtree(&Kdtree_IndustryXYFunc);
+
+void RebuildIndustryKdtree()
+{
+	std::vector<IndustryID> industryids;
+	for (const Industry *i : Industry::Iterate()) {
+		industryids.push_back(i->index);
+	}
+	_industry_kdtree.Build(industryids.begin(), industryids.end());
+}
+
 void ShowIndustryViewWindow(int industry);
 void BuildOilRig(TileIndex tile);
 
@@ -144,6 +156,8 @@ Industry::~Industry()
 	 * Also we must not decrement industry counts in that case. */
 	if (this->location.w == 0) return;
 
+	_industry_kdtree.Remove(this->index);
+
 	const bool has_neutral_station = this->neutral_station != nullptr;
 
 	TILE_AREA_LOOP(tile_cur, this->location) {
@@ -1390,6 +1404,10 @@ static CommandCost FindTownForIndustry(TileIndex tile, int type, Town **t)
 
 	if (_settings_game.economy.multiple_industry_per_town) return CommandCost();
 
+	/* The town of an industry is not necessarily the one closest to it anymore,
+	 * so the spatial index does not help here; skip the scan if we can. */
+	if (Industry::GetIndustryTypeCount(type) == 0) return CommandCost();
+
 	for (const Industry *i : Industry::Iterate()) {
 		if (i->type == (byte)type && i->town == *t) {
 			*t = nullptr;
@@ -1628,38 +1646,18 @@ static CommandCost CheckIfFarEnoughFromConflictingIndustry(TileIndex tile, int t
 {
 	const IndustrySpec *indspec = GetIndustrySpec(type);
 
-	/* On a large map with many industries, it may be faster to check an area. */
-	static const int dmax = 14;
-	if (Industry::GetNumItems() > (size_t) (dmax * dmax * 2)) {
-		const Industry* i = nullptr;
-		TileArea tile_area = TileArea(tile, 1, 1).Expand(dmax);
-		TILE_AREA_LOOP(atile, tile_area) {
-			if (GetTileType(atile) == MP_INDUSTRY) {
-				const Industry *i2 = Industry::GetByTile(atile);
-				if (i == i2) continue;
-				i = i2;
-				if (DistanceMax(tile, i->location.tile) > (uint)dmax) continue;
-				if (i->type == indspec->conflicting[0] ||
-						i->type == indspec->conflicting[1] ||
-						i->type == indspec->conflicting[2]) {
-					return_cmd_error(STR_ERROR_INDUSTRY_TOO_CLOSE);
-				}
-			}
-		}
-		return CommandCost();
-	}
-
-	for (const Industry *i : Industry::Iterate()) {
-		/* Within 14 tiles from another industry is considered close */
-		if (DistanceMax(tile, i->location.tile) > 14) continue;
-
+	/* Within 14 tiles from another industry is considered close */
+	bool too_close = false;
+	ForAllIndustriesRadius(tile, 14, [&](const Industry *i) {
 		/* check if there are any conflicting industry types around */
 		if (i->type == indspec->conflicting[0] ||
 				i->type == indspec->conflicting[1] ||
 				i->type == indspec->conflicting[2]) {
-			return_cmd_error(STR_ERROR_INDUSTRY_TOO_CLOSE);
+			too_close = true;
 		}
-	}
+	});
+	if (too_close) return_cmd_error(STR_ERROR_INDUSTRY_TOO_CLOSE);
+
 	return CommandCost();
 }
 
@@ -1897,6 +1895,8 @@ static void DoCreateNewIndustry(Industry *i, TileIndex tile, IndustryType type,
 		}
 	}
 
+	_industry_kdtree.Insert(i->index);
+
 	if (GetIndustrySpec(i->type)->behaviour & INDUSTRYBEH_PLANT_ON_BUILT) {
 		for (uint j = 0; j != 50; j++) PlantRandomFarmField(i);
 	}
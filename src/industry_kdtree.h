@@ -0,0 +1,42 @@
+/*
+ * This file is part of OpenTTD.
+ * OpenTTD is free software; you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 2.
+ * OpenTTD is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details. You should have received a copy of the GNU General Public License along with OpenTTD. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file industry_kdtree.h Declarations for accessing the k-d tree of industries */
+
+#ifndef INDUSTRY_KDTREE_H
+#define INDUSTRY_KDTREE_H
+
+#include "core/kdtree.hpp"
+#include "core/math_func.hpp"
+#include "industry.h"
+#include "map_func.h"
+
+inline uint16 Kdtree_IndustryXYFunc(IndustryID iid, int dim) { return (dim == 0) ? TileX(Industry::Get(iid)->location.tile) : TileY(Industry::Get(iid)->location.tile); }
+typedef Kdtree<IndustryID, decltype(&Kdtree_IndustryXYFunc), uint16, int> IndustryKdtree;
+extern IndustryKdtree _industry_kdtree;
+
+/**
+ * Call a function on all industries whose north tile is within a radius of a center tile.
+ * @param center  Central tile to search around.
+ * @param radius  Distance in both X and Y to search within.
+ * @param func    The function to call, must take a single parameter which is Industry*.
+ */
+template <typename Func>
+void ForAllIndustriesRadius(TileIndex center, uint radius, Func func)
+{
+	uint16 x1, y1, x2, y2;
+	x1 = (uint16)max<int>(0, TileX(center) - radius);
+	x2 = (uint16)min<int>(TileX(center) + radius + 1, MapSizeX());
+	y1 = (uint16)max<int>(0, TileY(center) - radius);
+	y2 = (uint16)min<int>(TileY(center) + radius + 1, MapSizeY());
+
+	_industry_kdtree.FindContained(x1, y1, x2, y2, [&](IndustryID id) {
+		func(Industry::Get(id));
+	});
+}
+
+#endif
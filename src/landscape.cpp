@@ -29,10 +29,14 @@
 #include "object_base.h"
 #include "company_func.h"
 #include "pathfinder/npf/aystar.h"
+#include "pathfinder/yapf/yapf_cache.h"
 #include "saveload/saveload.h"
 #include "framerate_type.h"
+#include "worker_pool.h"
+#include <chrono>
 #include <list>
 #include <set>
+#include <vector>
 
 #include "table/strings.h"
 #include "table/sprites.h"
@@ -574,6 +578,7 @@ void DoClearSquare(TileIndex tile)
 
 	MakeClear(tile, CLEAR_GRASS, _generating_world ? 3 : 0);
 	MarkTileDirtyByTile(tile);
+	YapfNotifyWaterLayoutChange(tile);
 }
 
 /**
@@ -796,23 +801,30 @@ CommandCost CmdClearArea(TileIndex tile, DoCommandFlag flags, uint32 p1, uint32
 TileIndex _cur_tileloop_tile;
 
 /**
- * Gradually iterate over all tiles on the map, calling their TileLoopProcs once every 256 ticks.
+ * Run the tile loop for this tick in #TLO_PSEUDORANDOM order.
  */
-void RunTileLoop()
+/**
+ * Get the feedback term of the linear feedback shift register (LFSR) for the
+ * pseudorandom tile loop order on the current map.
+ * @return The feedback term.
+ */
+static uint32 GetTileLoopFeedback()
 {
-	PerformanceAccumulator framerate(PFE_GL_LANDSCAPE);
-
-	/* The pseudorandom sequence of tiles is generated using a Galois linear feedback
-	 * shift register (LFSR). This allows a deterministic pseudorandom ordering, but
-	 * still with minimal state and fast iteration. */
-
 	/* Maximal length LFSR feedback terms, from 12-bit (for 64x64 maps) to 24-bit (for 4096x4096 maps).
 	 * Extracted from http://www.ece.cmu.edu/~koopman/lfsr/ */
 	static const uint32 feedbacks[] = {
 		0xD8F, 0x1296, 0x2496, 0x4357, 0x8679, 0x1030E, 0x206CD, 0x403FE, 0x807B8, 0x1004B2, 0x2006A8, 0x4004B2, 0x800B87
 	};
 	assert_compile(lengthof(feedbacks) == 2 * MAX_MAP_SIZE_BITS - 2 * MIN_MAP_SIZE_BITS + 1);
-	const uint32 feedback = feedbacks[MapLogX() + MapLogY() - 2 * MIN_MAP_SIZE_BITS];
+	return feedbacks[MapLogX() + MapLogY() - 2 * MIN_MAP_SIZE_BITS];
+}
+
+static void RunTileLoopPseudorandom()
+{
+	/* The pseudorandom sequence of tiles is generated using a Galois linear feedback
+	 * shift register (LFSR). This allows a deterministic pseudorandom ordering, but
+	 * still with minimal state and fast iteration. */
+	const uint32 feedback = GetTileLoopFeedback();
 
 	/* We update every tile every 256 ticks, so divide the map size by 2^8 = 256 */
 	uint count = 1 << (MapLogX() + MapLogY() - 8);
@@ -837,6 +849,143 @@ void RunTileLoop()
 	_cur_tileloop_tile = tile;
 }
 
+/**
+ * Run the tile loop for this tick in #TLO_BLOCKED order.
+ */
+static void RunTileLoopBlocked()
+{
+	/* The map is divided in blocks of 16x16 tiles, and every tick the tile at the
+	 * same position in every block is handled. Going through the blocks row by row
+	 * visits the map in memory order, so the accesses to the map arrays are cheap.
+	 * Every 256 ticks all positions within a block are handled once. The position
+	 * is scattered over the block between ticks, so neighbouring tiles are neither
+	 * handled in the same nor in consecutive ticks. */
+	static const uint BLOCK_BITS = 4;
+	static const uint BLOCK_SIZE = 1 << BLOCK_BITS;
+	assert_compile(2 * BLOCK_BITS == 8);
+
+	/* Multiplying with an odd number is a permutation of all 256 positions. */
+	uint position = (_tick_counter * 167) & 0xFF;
+	uint offset_x = GB(position, 0, BLOCK_BITS);
+	uint offset_y = GB(position, BLOCK_BITS, BLOCK_BITS);
+
+	for (uint y = offset_y; y < MapSizeY(); y += BLOCK_SIZE) {
+		for (TileIndex tile = TileXY(offset_x, y); tile < TileXY(MapSizeX(), y); tile += BLOCK_SIZE) {
+			_tile_type_procs[GetTileType(tile)]->tile_loop_proc(tile);
+		}
+	}
+}
+
+/**
+ * Gradually iterate over all tiles on the map, calling their TileLoopProcs once every 256 ticks.
+ */
+void RunTileLoop()
+{
+	PerformanceAccumulator framerate(PFE_GL_LANDSCAPE);
+
+	switch (_settings_game.game_creation.tile_loop_order) {
+		default: NOT_REACHED();
+		case TLO_PSEUDORANDOM: RunTileLoopPseudorandom(); break;
+		case TLO_BLOCKED:      RunTileLoopBlocked(); break;
+	}
+}
+
+/**
+ * Count the tiles of every type over the whole map, for #BenchmarkMapLayout.
+ * @param get_type Function returning the raw type byte of a tile.
+ * @return A checksum of the number of tiles of every type.
+ */
+template <typename Ttype>
+static uint64 CountTileTypes(Ttype get_type)
+{
+	uint counts[16] = {};
+	for (TileIndex tile = 0; tile < MapSize(); tile++) counts[GB(get_type(tile), 4, 4)]++;
+
+	uint64 checksum = 0;
+	for (uint count : counts) checksum = checksum * 31 + count;
+	return checksum;
+}
+
+/**
+ * Visit every tile in the pseudorandom tile loop order, for #BenchmarkMapLayout.
+ * @param read Function reading what the tile loop needs of a tile.
+ * @return The sum of everything read.
+ */
+template <typename Tread>
+static uint64 VisitTilesInTileLoopOrder(Tread read)
+{
+	const uint32 feedback = GetTileLoopFeedback();
+
+	/* The LFSR visits every tile but tile 0 once before it returns to its start. */
+	uint64 sum = read(0);
+	TileIndex tile = 1;
+	do {
+		sum += read(tile);
+		tile = (tile >> 1) ^ (-(int32)(tile & 1) & feedback);
+	} while (tile != 1);
+	return sum;
+}
+
+/**
+ * Time a scan of the map for #BenchmarkMapLayout.
+ * @param runs Number of times to do the scan.
+ * @param scan The scan, returning a checksum of what it read.
+ * @param[out] checksum The checksum of the last run.
+ * @return The time all runs took, in microseconds.
+ */
+template <typename Tscan>
+static uint64 TimeMapScan(uint runs, Tscan scan, uint64 *checksum)
+{
+	auto start = std::chrono::steady_clock::now();
+	for (uint run = 0; run < runs; run++) *checksum = scan();
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * Compare scans over the tile types and heights of the current map between
+ * the current map layout, with the types and heights in arrays of their own,
+ * and a copy in the interleaved layout where every tile kept them next to the
+ * other fields in one 8 byte struct. One scan counts the tiles of every type,
+ * the other visits every tile in the pseudorandom tile loop order and reads
+ * its type and height; the tile loop procedures are not run.
+ * @param runs Number of times to do every scan.
+ * @return The time every scan took.
+ */
+MapLayoutBenchmarkResult BenchmarkMapLayout(uint runs)
+{
+	/** A tile in the interleaved layout. */
+	struct InterleavedTile {
+		byte type;   ///< The type, like #_m_type.
+		byte height; ///< The height, like #_m_height.
+		uint16 m2;   ///< Like Tile::m2.
+		byte m1;     ///< Like Tile::m1.
+		byte m3;     ///< Like Tile::m3.
+		byte m4;     ///< Like Tile::m4.
+		byte m5;     ///< Like Tile::m5.
+	};
+	assert_compile(sizeof(InterleavedTile) == 8);
+
+	std::vector<InterleavedTile> interleaved(MapSize());
+	for (TileIndex tile = 0; tile < MapSize(); tile++) {
+		interleaved[tile] = { _m_type[tile], _m_height[tile], _m[tile].m2, _m[tile].m1, _m[tile].m3, _m[tile].m4, _m[tile].m5 };
+	}
+	const InterleavedTile *it = interleaved.data();
+
+	MapLayoutBenchmarkResult result;
+	uint64 planes_checksum = 0;
+	uint64 interleaved_checksum = 0;
+
+	result.histogram_planes = TimeMapScan(runs, [] { return CountTileTypes([](TileIndex t) { return _m_type[t]; }); }, &planes_checksum);
+	result.histogram_interleaved = TimeMapScan(runs, [it] { return CountTileTypes([it](TileIndex t) { return it[t].type; }); }, &interleaved_checksum);
+	result.identical = planes_checksum == interleaved_checksum;
+
+	result.tile_loop_planes = TimeMapScan(runs, [] { return VisitTilesInTileLoopOrder([](TileIndex t) { return GB(_m_type[t], 4, 4) << 8 | _m_height[t]; }); }, &planes_checksum);
+	result.tile_loop_interleaved = TimeMapScan(runs, [it] { return VisitTilesInTileLoopOrder([it](TileIndex t) { return GB(it[t].type, 4, 4) << 8 | it[t].height; }); }, &interleaved_checksum);
+	result.identical &= planes_checksum == interleaved_checksum;
+
+	return result;
+}
+
 void InitializeLandscape()
 {
 	for (uint y = _settings_game.construction.freeform_edges ? 1 : 0; y < MapMaxY(); y++) {
@@ -966,25 +1115,53 @@ static void GenerateTerrain(int type, uint flag)
 
 #include "table/genland.h"
 
-static void CreateDesertOrRainForest()
+/** Number of tiles checked by a single job of the worker pool when creating desert and rainforest. */
+static const uint DESERT_OR_RAINFOREST_TILES_PER_JOB = 4096;
+
+/**
+ * Find the tiles that have no tile matching a condition in the desert/rainforest area around them.
+ * The tiles are checked in parallel; the map is not modified, so the result
+ * is the same as when checking the tiles one by one.
+ * @param nearby Condition for the tiles around a tile.
+ * @param[out] found Per tile whether no tile around it matches the condition.
+ */
+template <typename Tfunc>
+static void FindTilesWithoutNearby(Tfunc nearby, std::vector<byte> &found)
 {
 	TileIndex update_freq = MapSize() / 4;
-	const TileIndexDiffC *data;
-	uint max_desert_height = CeilDiv(_settings_game.construction.max_heightlevel, 4);
+	found.assign(MapSize(), 0);
 
-	for (TileIndex tile = 0; tile != MapSize(); ++tile) {
-		if ((tile % update_freq) == 0) IncreaseGeneratingWorldProgress(GWP_LANDSCAPE);
+	for (TileIndex begin = 0; begin != MapSize(); begin += update_freq) {
+		IncreaseGeneratingWorldProgress(GWP_LANDSCAPE);
 
-		if (!IsValidTile(tile)) continue;
+		WorkerPool::Run(CeilDiv(update_freq, DESERT_OR_RAINFOREST_TILES_PER_JOB), [&](uint job) {
+			TileIndex first = begin + job * DESERT_OR_RAINFOREST_TILES_PER_JOB;
+			TileIndex last = min<TileIndex>(first + DESERT_OR_RAINFOREST_TILES_PER_JOB, begin + update_freq);
+			for (TileIndex tile = first; tile != last; ++tile) {
+				if (!IsValidTile(tile)) continue;
+
+				const TileIndexDiffC *data;
+				for (data = _make_desert_or_rainforest_data;
+						data != endof(_make_desert_or_rainforest_data); ++data) {
+					TileIndex t = AddTileIndexDiffCWrap(tile, *data);
+					if (t != INVALID_TILE && nearby(t)) break;
+				}
+				found[tile] = (data == endof(_make_desert_or_rainforest_data));
+			}
+		});
+	}
+}
 
-		for (data = _make_desert_or_rainforest_data;
-				data != endof(_make_desert_or_rainforest_data); ++data) {
-			TileIndex t = AddTileIndexDiffCWrap(tile, *data);
-			if (t != INVALID_TILE && (TileHeight(t) >= max_desert_height || IsTileType(t, MP_WATER))) break;
-		}
-		if (data == endof(_make_desert_or_rainforest_data)) {
-			SetTropicZone(tile, TROPICZONE_DESERT);
-		}
+static void CreateDesertOrRainForest()
+{
+	uint max_desert_height = CeilDiv(_settings_game.construction.max_heightlevel, 4);
+	std::vector<byte> found;
+
+	FindTilesWithoutNearby([max_desert_height](TileIndex t) {
+		return TileHeight(t) >= max_desert_height || IsTileType(t, MP_WATER);
+	}, found);
+	for (TileIndex tile = 0; tile != MapSize(); ++tile) {
+		if (found[tile]) SetTropicZone(tile, TROPICZONE_DESERT);
 	}
 
 	for (uint i = 0; i != 256; i++) {
@@ -993,19 +1170,11 @@ static void CreateDesertOrRainForest()
 		RunTileLoop();
 	}
 
+	FindTilesWithoutNearby([](TileIndex t) {
+		return IsTileType(t, MP_CLEAR) && IsClearGround(t, CLEAR_DESERT);
+	}, found);
 	for (TileIndex tile = 0; tile != MapSize(); ++tile) {
-		if ((tile % update_freq) == 0) IncreaseGeneratingWorldProgress(GWP_LANDSCAPE);
-
-		if (!IsValidTile(tile)) continue;
-
-		for (data = _make_desert_or_rainforest_data;
-				data != endof(_make_desert_or_rainforest_data); ++data) {
-			TileIndex t = AddTileIndexDiffCWrap(tile, *data);
-			if (t != INVALID_TILE && IsTileType(t, MP_CLEAR) && IsClearGround(t, CLEAR_DESERT)) break;
-		}
-		if (data == endof(_make_desert_or_rainforest_data)) {
-			SetTropicZone(tile, TROPICZONE_RAINFOREST);
-		}
+		if (found[tile]) SetTropicZone(tile, TROPICZONE_RAINFOREST);
 	}
 }
 
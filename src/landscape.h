@@ -138,6 +138,17 @@ bool HasFoundationNE(TileIndex tile, Slope slope_here, uint z_here);
 void DoClearSquare(TileIndex tile);
 void RunTileLoop();
 
+/** Time taken by the scans of the map layout benchmark, in microseconds. */
+struct MapLayoutBenchmarkResult {
+	uint64 histogram_planes;      ///< Counting the tiles of every type with the current layout.
+	uint64 histogram_interleaved; ///< Counting the tiles of every type with the interleaved layout.
+	uint64 tile_loop_planes;      ///< Visiting every tile in tile loop order with the current layout.
+	uint64 tile_loop_interleaved; ///< Visiting every tile in tile loop order with the interleaved layout.
+	bool identical;               ///< Whether the scans read the same from both layouts.
+};
+
+MapLayoutBenchmarkResult BenchmarkMapLayout(uint runs);
+
 void InitializeLandscape();
 void GenerateLandscape(byte mode);
 
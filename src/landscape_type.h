@@ -33,4 +33,10 @@ enum Borders {
 	BORDERS_RANDOM = 16,
 };
 
+/** Order in which the tile loop visits the tiles of the map. */
+enum TileLoopOrder {
+	TLO_PSEUDORANDOM = 0, ///< Pseudorandom order over the whole map.
+	TLO_BLOCKED      = 1, ///< One tile of every block of tiles per tick, going through the map in memory order.
+};
+
 #endif /* LANDSCAPE_TYPE_H */
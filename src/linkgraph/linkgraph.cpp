@@ -10,6 +10,7 @@
 #include "../stdafx.h"
 #include "../core/pool_func.hpp"
 #include "linkgraph.h"
+#include <algorithm>
 
 #include "../safeguards.h"
 
@@ -17,6 +18,8 @@
 LinkGraphPool _link_graph_pool("LinkGraph");
 INSTANTIATE_POOL_METHODS(LinkGraph)
 
+/* static */ const LinkGraph::BaseEdge LinkGraph::empty_edge = { 0, 0, INVALID_DATE, INVALID_DATE, INVALID_NODE };
+
 /**
  * Create a node or clear it.
  * @param xy Location of the associated station.
@@ -34,14 +37,15 @@ inline void LinkGraph::BaseNode::Init(TileIndex xy, StationID st, uint demand)
 
 /**
  * Create an edge.
+ * @param dest_node Destination of the edge.
  */
-inline void LinkGraph::BaseEdge::Init()
+void LinkGraph::BaseEdge::Init(NodeID dest_node)
 {
 	this->capacity = 0;
 	this->usage = 0;
 	this->last_unrestricted_update = INVALID_DATE;
 	this->last_restricted_update = INVALID_DATE;
-	this->next_edge = INVALID_NODE;
+	this->dest_node = dest_node;
 }
 
 /**
@@ -55,8 +59,7 @@ void LinkGraph::ShiftDates(int interval)
 	for (NodeID node1 = 0; node1 < this->Size(); ++node1) {
 		BaseNode &source = this->nodes[node1];
 		if (source.last_update != INVALID_DATE) source.last_update += interval;
-		for (NodeID node2 = 0; node2 < this->Size(); ++node2) {
-			BaseEdge &edge = this->edges[node1][node2];
+		for (BaseEdge &edge : this->UnshareEdges(node1).edges) {
 			if (edge.last_unrestricted_update != INVALID_DATE) edge.last_unrestricted_update += interval;
 			if (edge.last_restricted_update != INVALID_DATE) edge.last_restricted_update += interval;
 		}
@@ -68,12 +71,9 @@ void LinkGraph::Compress()
 	this->last_compression = (_date + this->last_compression) / 2;
 	for (NodeID node1 = 0; node1 < this->Size(); ++node1) {
 		this->nodes[node1].supply /= 2;
-		for (NodeID node2 = 0; node2 < this->Size(); ++node2) {
-			BaseEdge &edge = this->edges[node1][node2];
-			if (edge.capacity > 0) {
-				edge.capacity = max(1U, edge.capacity / 2);
-				edge.usage /= 2;
-			}
+		for (BaseEdge &edge : this->UnshareEdges(node1).edges) {
+			edge.capacity = max(1U, edge.capacity / 2);
+			edge.usage /= 2;
 		}
 	}
 }
@@ -93,21 +93,13 @@ void LinkGraph::Merge(LinkGraph *other)
 		this->nodes[new_node].supply = LinkGraph::Scale(other->nodes[node1].supply, age, other_age);
 		st->goods[this->cargo].link_graph = this->index;
 		st->goods[this->cargo].node = new_node;
-		for (NodeID node2 = 0; node2 < node1; ++node2) {
-			BaseEdge &forward = this->edges[new_node][first + node2];
-			BaseEdge &backward = this->edges[first + node2][new_node];
-			forward = other->edges[node1][node2];
-			backward = other->edges[node2][node1];
-			forward.capacity = LinkGraph::Scale(forward.capacity, age, other_age);
-			forward.usage = LinkGraph::Scale(forward.usage, age, other_age);
-			if (forward.next_edge != INVALID_NODE) forward.next_edge += first;
-			backward.capacity = LinkGraph::Scale(backward.capacity, age, other_age);
-			backward.usage = LinkGraph::Scale(backward.usage, age, other_age);
-			if (backward.next_edge != INVALID_NODE) backward.next_edge += first;
+		this->edges[new_node] = std::make_shared<NodeEdges>(*other->edges[node1]);
+		for (BaseEdge &edge : this->edges[new_node]->edges) {
+			edge.capacity = LinkGraph::Scale(edge.capacity, age, other_age);
+			edge.usage = LinkGraph::Scale(edge.usage, age, other_age);
+			edge.dest_node += first;
 		}
-		BaseEdge &new_start = this->edges[new_node][new_node];
-		new_start = other->edges[node1][node1];
-		if (new_start.next_edge != INVALID_NODE) new_start.next_edge += first;
+		this->edges[new_node]->RebuildIndex();
 	}
 	delete other;
 }
@@ -123,35 +115,62 @@ void LinkGraph::RemoveNode(NodeID id)
 	NodeID last_node = this->Size() - 1;
 	for (NodeID i = 0; i <= last_node; ++i) {
 		(*this)[i].RemoveEdge(id);
-		BaseEdge *node_edges = this->edges[i];
-		NodeID prev = i;
-		NodeID next = node_edges[i].next_edge;
-		while (next != INVALID_NODE) {
-			if (next == last_node) {
-				node_edges[prev].next_edge = id;
-				break;
-			}
-			prev = next;
-			next = node_edges[prev].next_edge;
-		}
-		node_edges[id] = node_edges[last_node];
+		if (!ConstNode(this, i).HasEdgeTo(last_node)) continue;
+		NodeEdges &edges = this->UnshareEdges(i);
+		edges.Find(last_node)->dest_node = id;
+		edges.RebuildIndex();
 	}
 	Station::Get(this->nodes[last_node].station)->goods[this->cargo].node = id;
 	/* Erase node by swapping with the last element. Node index is referenced
 	 * directly from station goods entries so the order and position must remain. */
 	this->nodes[id] = this->nodes.back();
 	this->nodes.pop_back();
-	this->edges.EraseColumn(id);
-	/* Not doing EraseRow here, as having the extra invalid row doesn't hurt
-	 * and removing it would trigger a lot of memmove. The data has already
-	 * been copied around in the loop above. */
+	if (id != last_node) this->edges[id] = std::move(this->edges.back());
+	this->edges.pop_back();
+}
+
+/**
+ * Get the edges of a node for modification. Copying a link graph for a job
+ * only shares the edges; they are copied here before the first modification
+ * if a job still uses them.
+ * @param node ID of the node.
+ * @return Outgoing edges of the node.
+ */
+LinkGraph::NodeEdges &LinkGraph::UnshareEdges(NodeID node)
+{
+	std::shared_ptr<NodeEdges> &edges = this->edges[node];
+	if (edges.use_count() > 1) edges = std::make_shared<NodeEdges>(*edges);
+	return *edges;
+}
+
+/**
+ * Rebuild the index of the edges by destination after changing them.
+ */
+void LinkGraph::NodeEdges::RebuildIndex()
+{
+	this->index.clear();
+	this->index.reserve(this->edges.size());
+	for (uint i = 0; i < this->edges.size(); ++i) {
+		this->index.emplace_back(this->edges[i].dest_node, i);
+	}
+	std::sort(this->index.begin(), this->index.end());
 }
 
 /**
- * Add a node to the component and create empty edges associated with it. Set
- * the station's last_component to this component. Calculate the distances to all
- * other nodes. The distances to _all_ nodes are important as the demand
- * calculator relies on their availability.
+ * Find the edge to the given node.
+ * @param to Remote end of the edge.
+ * @return The edge or \c nullptr if there is none.
+ */
+const LinkGraph::BaseEdge *LinkGraph::NodeEdges::Find(NodeID to) const
+{
+	auto it = std::lower_bound(this->index.begin(), this->index.end(), std::make_pair(to, 0U));
+	if (it == this->index.end() || it->first != to) return nullptr;
+	return &this->edges[it->second];
+}
+
+/**
+ * Add a node to the component. It doesn't have any edges yet. Set the
+ * station's last_component to this component.
  * @param st New node's station.
  * @return New node's ID.
  */
@@ -161,23 +180,10 @@ NodeID LinkGraph::AddNode(const Station *st)
 
 	NodeID new_node = this->Size();
 	this->nodes.emplace_back();
-	/* Avoid reducing the height of the matrix as that is expensive and we
-	 * most likely will increase it again later which is again expensive. */
-	this->edges.Resize(new_node + 1U,
-			max(new_node + 1U, this->edges.Height()));
+	this->edges.push_back(std::make_shared<NodeEdges>());
 
 	this->nodes[new_node].Init(st->xy, st->index,
 			HasBit(good.status, GoodsEntry::GES_ACCEPTANCE));
-
-	BaseEdge *new_edges = this->edges[new_node];
-
-	/* Reset the first edge starting at the new node */
-	new_edges[new_node].next_edge = INVALID_NODE;
-
-	for (NodeID i = 0; i <= new_node; ++i) {
-		new_edges[i].Init();
-		this->edges[i][new_node].Init();
-	}
 	return new_node;
 }
 
@@ -192,14 +198,18 @@ NodeID LinkGraph::AddNode(const Station *st)
 void LinkGraph::Node::AddEdge(NodeID to, uint capacity, uint usage, EdgeUpdateMode mode)
 {
 	assert(this->index != to);
-	BaseEdge &edge = this->edges[to];
-	BaseEdge &first = this->edges[this->index];
+	assert(!this->HasEdgeTo(to));
+	this->UnshareEdges();
+	/* New edges are iterated first. */
+	EdgeVector &edges = this->edges->edges;
+	edges.emplace(edges.begin());
+	BaseEdge &edge = edges.front();
+	edge.Init(to);
 	edge.capacity = capacity;
 	edge.usage = usage;
-	edge.next_edge = first.next_edge;
-	first.next_edge = to;
 	if (mode & EUM_UNRESTRICTED)  edge.last_unrestricted_update = _date;
 	if (mode & EUM_RESTRICTED) edge.last_restricted_update = _date;
+	this->edges->RebuildIndex();
 }
 
 /**
@@ -213,7 +223,7 @@ void LinkGraph::Node::UpdateEdge(NodeID to, uint capacity, uint usage, EdgeUpdat
 {
 	assert(capacity > 0);
 	assert(usage <= capacity);
-	if (this->edges[to].capacity == 0) {
+	if (!this->HasEdgeTo(to)) {
 		this->AddEdge(to, capacity, usage, mode);
 	} else {
 		(*this)[to].Update(capacity, usage, mode);
@@ -226,26 +236,11 @@ void LinkGraph::Node::UpdateEdge(NodeID to, uint capacity, uint usage, EdgeUpdat
  */
 void LinkGraph::Node::RemoveEdge(NodeID to)
 {
-	if (this->index == to) return;
-	BaseEdge &edge = this->edges[to];
-	edge.capacity = 0;
-	edge.last_unrestricted_update = INVALID_DATE;
-	edge.last_restricted_update = INVALID_DATE;
-	edge.usage = 0;
-
-	NodeID prev = this->index;
-	NodeID next = this->edges[this->index].next_edge;
-	while (next != INVALID_NODE) {
-		if (next == to) {
-			/* Will be removed, skip it. */
-			this->edges[prev].next_edge = edge.next_edge;
-			edge.next_edge = INVALID_NODE;
-			break;
-		} else {
-			prev = next;
-			next = this->edges[next].next_edge;
-		}
-	}
+	if (!this->HasEdgeTo(to)) return;
+	this->UnshareEdges();
+	EdgeVector &edges = this->edges->edges;
+	edges.erase(edges.begin() + (this->FindEdge(to) - edges.data()));
+	this->edges->RebuildIndex();
 }
 
 /**
@@ -274,19 +269,18 @@ void LinkGraph::Edge::Update(uint capacity, uint usage, EdgeUpdateMode mode)
 }
 
 /**
- * Resize the component and fill it with empty nodes and edges. Used when
+ * Resize the component and fill it with empty nodes without edges. Used when
  * loading from save games. The component is expected to be empty before.
  * @param size New size of the component.
  */
 void LinkGraph::Init(uint size)
 {
 	assert(this->Size() == 0);
-	this->edges.Resize(size, size);
+	this->edges.resize(size);
 	this->nodes.resize(size);
 
 	for (uint i = 0; i < size; ++i) {
 		this->nodes[i].Init();
-		BaseEdge *column = this->edges[i];
-		for (uint j = 0; j < size; ++j) column[j].Init();
+		this->edges[i] = std::make_shared<NodeEdges>();
 	}
 }
@@ -12,11 +12,11 @@
 
 #include "../core/pool_type.hpp"
 #include "../core/smallmap_type.hpp"
-#include "../core/smallmatrix_type.hpp"
 #include "../station_base.h"
 #include "../cargotype.h"
 #include "../date_func.h"
 #include "linkgraph_type.h"
+#include <memory>
 
 struct SaveLoad;
 class LinkGraph;
@@ -53,18 +53,38 @@ public:
 	};
 
 	/**
-	 * An edge in the link graph. Corresponds to a link between two stations or at
-	 * least the distance between them. Edges from one node to itself contain the
-	 * ID of the opposite Node of the first active edge (i.e. not just distance) in
-	 * the column as next_edge.
+	 * An edge in the link graph. Corresponds to a link between two stations.
+	 * Only nodes that are actually linked have an edge between them.
 	 */
 	struct BaseEdge {
 		uint capacity;                 ///< Capacity of the link.
 		uint usage;                    ///< Usage of the link.
 		Date last_unrestricted_update; ///< When the unrestricted part of the link was last updated.
 		Date last_restricted_update;   ///< When the restricted part of the link was last updated.
-		NodeID next_edge;              ///< Destination of next valid edge starting at the same source node.
-		void Init();
+		NodeID dest_node;              ///< Destination of the edge.
+		void Init(NodeID dest_node = INVALID_NODE);
+	};
+
+	/** Outgoing edges of a node, in the order they are iterated. */
+	typedef std::vector<BaseEdge> EdgeVector;
+
+	/**
+	 * Outgoing edges of a node with an index to find them by destination.
+	 * Call RebuildIndex after changing the edges or their destinations.
+	 */
+	struct NodeEdges {
+		EdgeVector edges;                           ///< Edges in the order they are iterated.
+		std::vector<std::pair<NodeID, uint>> index; ///< Destination and position of every edge, sorted by destination.
+
+		void RebuildIndex();
+		const BaseEdge *Find(NodeID to) const;
+
+		/**
+		 * Find the edge to the given node.
+		 * @param to Remote end of the edge.
+		 * @return The edge or \c nullptr if there is none.
+		 */
+		BaseEdge *Find(NodeID to) { return const_cast<BaseEdge *>(const_cast<const NodeEdges *>(this)->Find(to)); }
 	};
 
 	/**
@@ -117,15 +137,25 @@ public:
 
 	/**
 	 * Wrapper for a node (const or not) allowing retrieval, but no modification.
-	 * @tparam Tedge Actual node class, may be "const BaseNode" or just "BaseNode".
-	 * @tparam Tedge Actual edge class, may be "const BaseEdge" or just "BaseEdge".
+	 * @tparam Tnode Actual node class, may be "const BaseNode" or just "BaseNode".
+	 * @tparam Tedge_vector Actual edge list class, may be "const NodeEdges" or just "NodeEdges".
 	 */
-	template<typename Tnode, typename Tedge>
+	template<typename Tnode, typename Tedge_vector>
 	class NodeWrapper {
 	protected:
-		Tnode &node;  ///< Node being wrapped.
-		Tedge *edges; ///< Outgoing edges for wrapped node.
-		NodeID index; ///< ID of wrapped node.
+		Tnode &node;          ///< Node being wrapped.
+		Tedge_vector *edges;  ///< Outgoing edges for wrapped node.
+		NodeID index;         ///< ID of wrapped node.
+
+		/**
+		 * Find the edge to the given node.
+		 * @param to Remote end of the edge.
+		 * @return The edge or \c nullptr if there is none.
+		 */
+		auto FindEdge(NodeID to) const -> decltype(this->edges->Find(to))
+		{
+			return this->edges->Find(to);
+		}
 
 	public:
 
@@ -135,8 +165,15 @@ public:
 		 * @param edges Outgoing edges for node to be wrapped.
 		 * @param index ID of node to be wrapped.
 		 */
-		NodeWrapper(Tnode &node, Tedge *edges, NodeID index) : node(node),
-			edges(edges), index(index) {}
+		NodeWrapper(Tnode &node, Tedge_vector &edges, NodeID index) : node(node),
+			edges(&edges), index(index) {}
+
+		/**
+		 * Check if there is an edge to the given node.
+		 * @param to Remote end of the edge.
+		 * @return True if the nodes are linked.
+		 */
+		bool HasEdgeTo(NodeID to) const { return this->FindEdge(to) != nullptr; }
 
 		/**
 		 * Get supply of wrapped node.
@@ -170,17 +207,15 @@ public:
 	};
 
 	/**
-	 * Base class for iterating across outgoing edges of a node. Only the real
-	 * edges (those with capacity) are iterated. The ones with only distance
-	 * information are skipped.
+	 * Base class for iterating across outgoing edges of a node.
 	 * @tparam Tedge Actual edge class. May be "BaseEdge" or "const BaseEdge".
 	 * @tparam Titer Actual iterator class.
 	 */
 	template <class Tedge, class Tedge_wrapper, class Titer>
 	class BaseEdgeIterator {
 	protected:
-		Tedge *base;    ///< Array of edges being iterated.
-		NodeID current; ///< Current offset in edges array.
+		Tedge *base;  ///< Array of edges being iterated.
+		uint current; ///< Current offset in edges array.
 
 		/**
 		 * A "fake" pointer to enable operator-> on temporaries. As the objects
@@ -208,11 +243,11 @@ public:
 		/**
 		 * Constructor.
 		 * @param base Array of edges to be iterated.
-		 * @param current ID of current node (to locate the first edge).
+		 * @param current Offset of the current edge in the array.
 		 */
-		BaseEdgeIterator (Tedge *base, NodeID current) :
+		BaseEdgeIterator (Tedge *base, uint current) :
 			base(base),
-			current(current == INVALID_NODE ? current : base[current].next_edge)
+			current(current)
 		{}
 
 		/**
@@ -221,7 +256,7 @@ public:
 		 */
 		Titer &operator++()
 		{
-			this->current = this->base[this->current].next_edge;
+			this->current++;
 			return static_cast<Titer &>(*this);
 		}
 
@@ -232,7 +267,7 @@ public:
 		Titer operator++(int)
 		{
 			Titer ret(static_cast<Titer &>(*this));
-			this->current = this->base[this->current].next_edge;
+			this->current++;
 			return ret;
 		}
 
@@ -241,7 +276,7 @@ public:
 		 * child class.
 		 * @tparam Tother Class of other iterator.
 		 * @param other Instance of other iterator.
-		 * @return If the iterators have the same edge array and current node.
+		 * @return If the iterators have the same edge array and current offset.
 		 */
 		template<class Tother>
 		bool operator==(const Tother &other)
@@ -254,7 +289,7 @@ public:
 		 * may be of a child class.
 		 * @tparam Tother Class of other iterator.
 		 * @param other Instance of other iterator.
-		 * @return If either the edge arrays or the current nodes differ.
+		 * @return If either the edge arrays or the current offsets differ.
 		 */
 		template<class Tother>
 		bool operator!=(const Tother &other)
@@ -268,7 +303,7 @@ public:
 		 */
 		SmallPair<NodeID, Tedge_wrapper> operator*() const
 		{
-			return SmallPair<NodeID, Tedge_wrapper>(this->current, Tedge_wrapper(this->base[this->current]));
+			return SmallPair<NodeID, Tedge_wrapper>(this->base[this->current].dest_node, Tedge_wrapper(this->base[this->current]));
 		}
 
 		/**
@@ -309,9 +344,9 @@ public:
 		/**
 		 * Constructor.
 		 * @param edges Array of edges to be iterated over.
-		 * @param current ID of current edge's end node.
+		 * @param current Offset of the current edge.
 		 */
-		ConstEdgeIterator(const BaseEdge *edges, NodeID current) :
+		ConstEdgeIterator(const BaseEdge *edges, uint current) :
 			BaseEdgeIterator<const BaseEdge, ConstEdge, ConstEdgeIterator>(edges, current) {}
 	};
 
@@ -324,9 +359,9 @@ public:
 		/**
 		 * Constructor.
 		 * @param edges Array of edges to be iterated over.
-		 * @param current ID of current edge's end node.
+		 * @param current Offset of the current edge.
 		 */
-		EdgeIterator(BaseEdge *edges, NodeID current) :
+		EdgeIterator(BaseEdge *edges, uint current) :
 			BaseEdgeIterator<BaseEdge, Edge, EdgeIterator>(edges, current) {}
 	};
 
@@ -334,7 +369,7 @@ public:
 	 * Constant node class. Only retrieval operations are allowed on both the
 	 * node itself and its edges.
 	 */
-	class ConstNode : public NodeWrapper<const BaseNode, const BaseEdge> {
+	class ConstNode : public NodeWrapper<const BaseNode, const NodeEdges> {
 	public:
 		/**
 		 * Constructor.
@@ -342,34 +377,48 @@ public:
 		 * @param node ID of the node.
 		 */
 		ConstNode(const LinkGraph *lg, NodeID node) :
-			NodeWrapper<const BaseNode, const BaseEdge>(lg->nodes[node], lg->edges[node], node)
+			NodeWrapper<const BaseNode, const NodeEdges>(lg->nodes[node], *lg->edges[node], node)
 		{}
 
 		/**
 		 * Get a ConstEdge. This is not a reference as the wrapper objects are
-		 * not actually persistent.
+		 * not actually persistent. If the nodes aren't linked an empty edge is
+		 * returned.
 		 * @param to ID of end node of edge.
 		 * @return Constant edge wrapper.
 		 */
-		ConstEdge operator[](NodeID to) const { return ConstEdge(this->edges[to]); }
+		ConstEdge operator[](NodeID to) const
+		{
+			const BaseEdge *edge = this->FindEdge(to);
+			return ConstEdge(edge != nullptr ? *edge : LinkGraph::empty_edge);
+		}
 
 		/**
 		 * Get an iterator pointing to the start of the edges array.
 		 * @return Constant edge iterator.
 		 */
-		ConstEdgeIterator Begin() const { return ConstEdgeIterator(this->edges, this->index); }
+		ConstEdgeIterator Begin() const { return ConstEdgeIterator(this->edges->edges.data(), 0); }
 
 		/**
 		 * Get an iterator pointing beyond the end of the edges array.
 		 * @return Constant edge iterator.
 		 */
-		ConstEdgeIterator End() const { return ConstEdgeIterator(this->edges, INVALID_NODE); }
+		ConstEdgeIterator End() const { return ConstEdgeIterator(this->edges->edges.data(), (uint)this->edges->edges.size()); }
 	};
 
 	/**
 	 * Updatable node class. The node itself as well as its edges can be modified.
 	 */
-	class Node : public NodeWrapper<BaseNode, BaseEdge> {
+	class Node : public NodeWrapper<BaseNode, NodeEdges> {
+	protected:
+		LinkGraph *lg; ///< Link graph the node belongs to.
+
+		/**
+		 * Detach the node's edges from any copy of the link graph made for a
+		 * job, as they are about to be modified.
+		 */
+		void UnshareEdges() { this->edges = &this->lg->UnshareEdges(this->index); }
+
 	public:
 		/**
 		 * Constructor.
@@ -377,28 +426,34 @@ public:
 		 * @param node ID of the node.
 		 */
 		Node(LinkGraph *lg, NodeID node) :
-			NodeWrapper<BaseNode, BaseEdge>(lg->nodes[node], lg->edges[node], node)
+			NodeWrapper<BaseNode, NodeEdges>(lg->nodes[node], *lg->edges[node], node), lg(lg)
 		{}
 
 		/**
-		 * Get an Edge. This is not a reference as the wrapper objects are not
-		 * actually persistent.
+		 * Get an Edge for modification. This is not a reference as the wrapper
+		 * objects are not actually persistent. The nodes have to be linked.
 		 * @param to ID of end node of edge.
 		 * @return Edge wrapper.
 		 */
-		Edge operator[](NodeID to) { return Edge(this->edges[to]); }
+		Edge operator[](NodeID to)
+		{
+			this->UnshareEdges();
+			BaseEdge *edge = this->FindEdge(to);
+			assert(edge != nullptr);
+			return Edge(*edge);
+		}
 
 		/**
-		 * Get an iterator pointing to the start of the edges array.
+		 * Get an iterator pointing to the start of the edges array, for modification.
 		 * @return Edge iterator.
 		 */
-		EdgeIterator Begin() { return EdgeIterator(this->edges, this->index); }
+		EdgeIterator Begin() { this->UnshareEdges(); return EdgeIterator(this->edges->edges.data(), 0); }
 
 		/**
-		 * Get an iterator pointing beyond the end of the edges array.
+		 * Get an iterator pointing beyond the end of the edges array, for modification.
 		 * @return Constant edge iterator.
 		 */
-		EdgeIterator End() { return EdgeIterator(this->edges, INVALID_NODE); }
+		EdgeIterator End() { this->UnshareEdges(); return EdgeIterator(this->edges->edges.data(), (uint)this->edges->edges.size()); }
 
 		/**
 		 * Update the node's supply and set last_update to the current date.
@@ -434,7 +489,7 @@ public:
 	};
 
 	typedef std::vector<BaseNode> NodeVector;
-	typedef SmallMatrix<BaseEdge> EdgeMatrix;
+	typedef std::vector<std::shared_ptr<NodeEdges>> EdgeMatrix;
 
 	/** Minimum effective distance for timeout calculation. */
 	static const uint MIN_TIMEOUT_DISTANCE = 32;
@@ -442,6 +497,9 @@ public:
 	/** Minimum number of days between subsequent compressions of a LG. */
 	static const uint COMPRESSION_INTERVAL = 256;
 
+	/** Edge returned when looking up two nodes that aren't linked. */
+	static const BaseEdge empty_edge;
+
 	/**
 	 * Scale a value from a link graph of age orig_age for usage in one of age
 	 * target_age. Make sure that the value stays > 0 if it was > 0 before.
@@ -522,16 +580,19 @@ public:
 	void RemoveNode(NodeID id);
 
 protected:
+	NodeEdges &UnshareEdges(NodeID node);
+
 	friend class LinkGraph::ConstNode;
 	friend class LinkGraph::Node;
 	friend const SaveLoad *GetLinkGraphDesc();
 	friend const SaveLoad *GetLinkGraphJobDesc();
-	friend void SaveLoad_LinkGraph(LinkGraph &lg);
+	friend void Save_LinkGraph(const LinkGraph &lg);
+	friend void Load_LinkGraph(LinkGraph &lg);
 
 	CargoID cargo;         ///< Cargo of this component's link graph.
 	Date last_compression; ///< Last time the capacities and supplies were compressed.
 	NodeVector nodes;      ///< Nodes in the component.
-	EdgeMatrix edges;      ///< Edges in the component.
+	EdgeMatrix edges;      ///< Outgoing edges of each node in the component, shared with the copies made for jobs until modified.
 };
 
 #endif /* LINKGRAPH_H */
@@ -29,7 +29,8 @@ INSTANTIATE_POOL_METHODS(LinkGraphJob)
 /**
  * Create a link graph job from a link graph. The link graph will be copied so
  * that the calculations don't interfer with the normal operations on the
- * original. The job is immediately started.
+ * original. The copy shares the edges with the original until the original
+ * modifies them, so this is cheap. The job is immediately started.
  * @param orig Original LinkGraph to be copied.
  */
 LinkGraphJob::LinkGraphJob(const LinkGraph &orig) :
@@ -80,6 +81,23 @@ void LinkGraphJob::JoinThread()
 	}
 }
 
+/**
+ * Check if new flows contain flows for all origins of the current ones.
+ * @param flows New flows.
+ * @param current Current flows.
+ * @return If no origin of the current flows is missing in the new ones.
+ */
+static bool HasAllOrigins(const FlowStatMap &flows, const FlowStatMap &current)
+{
+	if (flows.size() < current.size()) return false;
+	FlowStatMap::const_iterator it = flows.begin();
+	for (FlowStatMap::const_iterator cur_it = current.begin(); cur_it != current.end(); ++cur_it) {
+		while (it != flows.end() && it->first < cur_it->first) ++it;
+		if (it == flows.end() || it->first != cur_it->first) return false;
+	}
+	return true;
+}
+
 /**
  * Join the link graph job and destroy it.
  */
@@ -113,7 +131,7 @@ LinkGraphJob::~LinkGraphJob()
 			continue;
 		}
 
-		LinkGraph *lg = LinkGraph::Get(ge.link_graph);
+		const LinkGraph *lg = LinkGraph::Get(ge.link_graph);
 		FlowStatMap &flows = from.Flows();
 
 		for (EdgeIterator it(from.Begin()); it != from.End(); ++it) {
@@ -135,6 +153,14 @@ LinkGraphJob::~LinkGraphJob()
 			}
 		}
 
+		/* Usually the new flows cover all origins of the old ones. Then they
+		 * simply replace the old ones, which are freed along with the job. */
+		if (HasAllOrigins(flows, ge.flows)) {
+			ge.flows.swap(flows);
+			InvalidateWindowData(WC_STATION_VIEW, st->index, this->Cargo());
+			continue;
+		}
+
 		/* Swap shares and invalidate ones that are completely deleted. Don't
 		 * really delete them as we could then end up with unroutable cargo
 		 * somewhere. Do delete them and also reroute relevant cargo if
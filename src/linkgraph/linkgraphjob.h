@@ -11,6 +11,7 @@
 #define LINKGRAPHJOB_H
 
 #include "../thread.h"
+#include "../core/smallmatrix_type.hpp"
 #include "linkgraph.h"
 #include <list>
 
@@ -148,10 +149,10 @@ public:
 		/**
 		 * Constructor.
 		 * @param base Array of edges to be iterated.
-		 * @param base_anno Array of annotations to be iterated.
+		 * @param base_anno Annotations of the edges, indexed by destination node.
 		 * @param current Start offset of iteration.
 		 */
-		EdgeIterator(const LinkGraph::BaseEdge *base, EdgeAnnotation *base_anno, NodeID current) :
+		EdgeIterator(const LinkGraph::BaseEdge *base, EdgeAnnotation *base_anno, uint current) :
 				LinkGraph::BaseEdgeIterator<const LinkGraph::BaseEdge, Edge, EdgeIterator>(base, current),
 				base_anno(base_anno) {}
 
@@ -162,7 +163,8 @@ public:
 		 */
 		SmallPair<NodeID, Edge> operator*() const
 		{
-			return SmallPair<NodeID, Edge>(this->current, Edge(this->base[this->current], this->base_anno[this->current]));
+			const LinkGraph::BaseEdge &edge = this->base[this->current];
+			return SmallPair<NodeID, Edge>(edge.dest_node, Edge(edge, this->base_anno[edge.dest_node]));
 		}
 
 		/**
@@ -197,25 +199,28 @@ public:
 
 		/**
 		 * Retrieve an edge starting at this node. Mind that this returns an
-		 * object, not a reference.
+		 * object, not a reference. Nodes that aren't linked still get an edge
+		 * without capacity, so that demand can be annotated between them.
 		 * @param to Remote end of the edge.
 		 * @return Edge between this node and "to".
 		 */
-		Edge operator[](NodeID to) const { return Edge(this->edges[to], this->edge_annos[to]); }
+		Edge operator[](NodeID to) const
+		{
+			const LinkGraph::BaseEdge *edge = this->FindEdge(to);
+			return Edge(edge != nullptr ? *edge : LinkGraph::empty_edge, this->edge_annos[to]);
+		}
 
 		/**
-		 * Iterator for the "begin" of the edge array. Only edges with capacity
-		 * are iterated. The others are skipped.
+		 * Iterator for the "begin" of the edge array.
 		 * @return Iterator pointing to the first edge.
 		 */
-		EdgeIterator Begin() const { return EdgeIterator(this->edges, this->edge_annos, index); }
+		EdgeIterator Begin() const { return EdgeIterator(this->edges->edges.data(), this->edge_annos, 0); }
 
 		/**
-		 * Iterator for the "end" of the edge array. Only edges with capacity
-		 * are iterated. The others are skipped.
+		 * Iterator for the "end" of the edge array.
 		 * @return Iterator pointing beyond the last edge.
 		 */
-		EdgeIterator End() const { return EdgeIterator(this->edges, this->edge_annos, INVALID_NODE); }
+		EdgeIterator End() const { return EdgeIterator(this->edges->edges.data(), this->edge_annos, (uint)this->edges->edges.size()); }
 
 		/**
 		 * Get amount of supply that hasn't been delivered, yet.
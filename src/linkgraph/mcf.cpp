@@ -2,13 +2,22 @@
 
 #include "../stdafx.h"
 #include "../core/math_func.hpp"
+#include "../core/random_func.hpp"
+#include "../worker_pool.h"
 #include "mcf.h"
-#include <set>
+#include <chrono>
 
 #include "../safeguards.h"
 
 typedef std::map<NodeID, Path *> PathViaMap;
 
+/**
+ * Number of sources whose paths are searched in parallel before their flows
+ * are assigned. This must not depend on the number of threads, as the
+ * results depend on it.
+ */
+static const uint MCF_BATCH_SIZE = 16;
+
 /**
  * Distance-based annotation for use in the Dijkstra algorithm. This is close
  * to the original meaning of "annotation" in this context. Paths are rated
@@ -16,6 +25,7 @@ typedef std::map<NodeID, Path *> PathViaMap;
  */
 class DistanceAnnotation : public Path {
 public:
+	typedef uint Value; ///< Type of the annotation value.
 
 	/**
 	 * Constructor.
@@ -37,12 +47,7 @@ public:
 	 */
 	inline void UpdateAnnotation() { }
 
-	/**
-	 * Comparator for std containers.
-	 */
-	struct Comparator {
-		bool operator()(const DistanceAnnotation *x, const DistanceAnnotation *y) const;
-	};
+	static bool IsBefore(Value x_anno, Value y_anno, NodeID x, NodeID y);
 };
 
 /**
@@ -55,6 +60,7 @@ class CapacityAnnotation : public Path {
 	int cached_annotation;
 
 public:
+	typedef int Value; ///< Type of the annotation value.
 
 	/**
 	 * Constructor.
@@ -79,17 +85,148 @@ public:
 		this->cached_annotation = this->GetCapacityRatio();
 	}
 
+	static bool IsBefore(Value x_anno, Value y_anno, NodeID x, NodeID y);
+};
+
+/**
+ * Priority queue for the Dijkstra algorithm. A 4-ary heap of annotation
+ * values that knows the position of each node in it, so that the annotation
+ * of a queued node can be changed in place.
+ * @tparam Tannotation Annotation to be used.
+ */
+template <class Tannotation>
+class AnnotationQueue {
+private:
+	/** Queued node with a copy of its annotation value. */
+	struct Entry {
+		typename Tannotation::Value value; ///< Annotation value of the node.
+		NodeID node;                       ///< ID of the node.
+	};
+
+	static const uint NOT_QUEUED = UINT_MAX; ///< Position of nodes that aren't in the queue.
+
+	std::vector<Entry> heap; ///< Queued nodes, best first.
+	std::vector<uint> pos;   ///< Position of each node in the heap.
+
+	/**
+	 * Check if an entry has to be taken from the queue before another one.
+	 * @param a First entry.
+	 * @param b Second entry.
+	 * @return If a goes before b.
+	 */
+	inline static bool IsBefore(const Entry &a, const Entry &b)
+	{
+		return Tannotation::IsBefore(a.value, b.value, a.node, b.node);
+	}
+
 	/**
-	 * Comparator for std containers.
+	 * Put an entry at a position in the heap and remember that position.
+	 * @param i Position.
+	 * @param entry Entry to be put there.
 	 */
-	struct Comparator {
-		bool operator()(const CapacityAnnotation *x, const CapacityAnnotation *y) const;
-	};
+	inline void Place(uint i, const Entry &entry)
+	{
+		this->heap[i] = entry;
+		this->pos[entry.node] = i;
+	}
+
+	/**
+	 * Move an entry towards the top of the heap until the heap is valid again.
+	 * @param i Current position of the entry.
+	 * @return New position of the entry.
+	 */
+	uint SiftUp(uint i)
+	{
+		Entry entry = this->heap[i];
+		while (i > 0) {
+			uint parent = (i - 1) / 4;
+			if (!IsBefore(entry, this->heap[parent])) break;
+			this->Place(i, this->heap[parent]);
+			i = parent;
+		}
+		this->Place(i, entry);
+		return i;
+	}
+
+	/**
+	 * Move an entry towards the bottom of the heap until the heap is valid again.
+	 * @param i Current position of the entry.
+	 */
+	void SiftDown(uint i)
+	{
+		Entry entry = this->heap[i];
+		uint size = (uint)this->heap.size();
+		for (;;) {
+			uint best = i * 4 + 1;
+			if (best >= size) break;
+			uint last = min(best + 4, size);
+			for (uint child = best + 1; child < last; ++child) {
+				if (IsBefore(this->heap[child], this->heap[best])) best = child;
+			}
+			if (!IsBefore(this->heap[best], entry)) break;
+			this->Place(i, this->heap[best]);
+			i = best;
+		}
+		this->Place(i, entry);
+	}
+
+public:
+	/**
+	 * Create an empty queue.
+	 * @param size Number of nodes in the graph.
+	 */
+	AnnotationQueue(uint size) : pos(size, NOT_QUEUED)
+	{
+		this->heap.reserve(size);
+	}
+
+	/**
+	 * Check if there are any nodes left in the queue.
+	 * @return If the queue is empty.
+	 */
+	inline bool IsEmpty() const { return this->heap.empty(); }
+
+	/**
+	 * Queue a node or move it to the right place after its annotation changed.
+	 * @param anno Annotation of the node.
+	 */
+	void Update(const Tannotation *anno)
+	{
+		Entry entry = { anno->GetAnnotation(), anno->GetNode() };
+		uint i = this->pos[entry.node];
+		if (i == NOT_QUEUED) {
+			i = (uint)this->heap.size();
+			this->heap.push_back(entry);
+		} else {
+			this->heap[i] = entry;
+		}
+		if (this->SiftUp(i) == i) this->SiftDown(i);
+	}
+
+	/**
+	 * Take the best node from the queue.
+	 * @return ID of the node.
+	 */
+	NodeID Pop()
+	{
+		NodeID node = this->heap.front().node;
+		this->pos[node] = NOT_QUEUED;
+		Entry last = this->heap.back();
+		this->heap.pop_back();
+		if (!this->heap.empty()) {
+			this->heap.front() = last;
+			this->SiftDown(0);
+		}
+		return node;
+	}
 };
 
+template <class Tannotation>
+const uint AnnotationQueue<Tannotation>::NOT_QUEUED;
+
 /**
- * Iterator class for getting the edges in the order of their next_edge
- * members.
+ * Iterator class for getting the edges of a node in the order they are stored
+ * in the link graph.
  */
 class GraphEdgeIterator {
 private:
@@ -104,7 +241,7 @@ public:
 	 * @param job Job to iterate on.
 	 */
 	GraphEdgeIterator(LinkGraphJob &job) : job(job),
-		i(nullptr, nullptr, INVALID_NODE), end(nullptr, nullptr, INVALID_NODE)
+		i(nullptr, nullptr, 0), end(nullptr, nullptr, 0)
 	{}
 
 	/**
@@ -258,22 +395,19 @@ bool CapacityAnnotation::IsBetter(const CapacityAnnotation *base, uint cap,
 template<class Tannotation, class Tedge_iterator>
 void MultiCommodityFlow::Dijkstra(NodeID source_node, PathVector &paths)
 {
-	typedef std::set<Tannotation *, typename Tannotation::Comparator> AnnoSet;
 	Tedge_iterator iter(this->job);
 	uint size = this->job.Size();
-	AnnoSet annos;
+	AnnotationQueue<Tannotation> annos(size);
 	paths.resize(size, nullptr);
 	for (NodeID node = 0; node < size; ++node) {
 		Tannotation *anno = new Tannotation(node, node == source_node);
 		anno->UpdateAnnotation();
-		annos.insert(anno);
+		annos.Update(anno);
 		paths[node] = anno;
 	}
-	while (!annos.empty()) {
-		typename AnnoSet::iterator i = annos.begin();
-		Tannotation *source = *i;
-		annos.erase(i);
-		NodeID from = source->GetNode();
+	while (!annos.IsEmpty()) {
+		NodeID from = annos.Pop();
+		Tannotation *source = static_cast<Tannotation *>(paths[from]);
 		iter.SetNode(source_node, from);
 		for (NodeID to = iter.Next(); to != INVALID_NODE; to = iter.Next()) {
 			if (to == from) continue; // Not a real edge but a consumption sign.
@@ -288,15 +422,31 @@ void MultiCommodityFlow::Dijkstra(NodeID source_node, PathVector &paths)
 			uint distance = DistanceMaxPlusManhattan(this->job[from].XY(), this->job[to].XY()) + 1;
 			Tannotation *dest = static_cast<Tannotation *>(paths[to]);
 			if (dest->IsBetter(source, capacity, capacity - edge.Flow(), distance)) {
-				annos.erase(dest);
 				dest->Fork(source, capacity, capacity - edge.Flow(), distance);
 				dest->UpdateAnnotation();
-				annos.insert(dest);
+				annos.Update(dest);
 			}
 		}
 	}
 }
 
+/**
+ * Run Dijkstra for a batch of sources in parallel. Only the job is read
+ * while doing so, every source gets its own set of paths.
+ * @tparam Tannotation Annotation to be used.
+ * @tparam Tedge_iterator Iterator to be used for getting outgoing edges.
+ * @param sources Nodes where the searches start.
+ * @param count Number of sources.
+ * @param paths Containers for the paths to be calculated, one per source.
+ */
+template<class Tannotation, class Tedge_iterator>
+void MultiCommodityFlow::DijkstraBatch(const NodeID *sources, uint count, PathVector *paths)
+{
+	WorkerPool::Run(count, [this, sources, paths](uint i) {
+		this->Dijkstra<Tannotation, Tedge_iterator>(sources[i], paths[i]);
+	});
+}
+
 /**
  * Clean up paths that lead nowhere and the root path.
  * @param source_id ID of the root node.
@@ -490,7 +640,8 @@ bool MCF1stPass::EliminateCycles()
  */
 MCF1stPass::MCF1stPass(LinkGraphJob &job) : MultiCommodityFlow(job)
 {
-	PathVector paths;
+	PathVector paths[MCF_BATCH_SIZE];
+	NodeID batch[MCF_BATCH_SIZE];
 	uint size = job.Size();
 	uint accuracy = job.Settings().accuracy;
 	bool more_loops;
@@ -498,35 +649,53 @@ MCF1stPass::MCF1stPass(LinkGraphJob &job) : MultiCommodityFlow(job)
 
 	do {
 		more_loops = false;
-		for (NodeID source = 0; source < size; ++source) {
-			if (finished_sources[source]) continue;
+		for (NodeID next = 0; next < size;) {
+			uint count = 0;
+			for (; next < size && count < MCF_BATCH_SIZE; ++next) {
+				if (!finished_sources[next]) batch[count++] = next;
+			}
 
 			/* First saturate the shortest paths. */
-			this->Dijkstra<DistanceAnnotation, GraphEdgeIterator>(source, paths);
-
-			bool source_demand_left = false;
-			for (NodeID dest = 0; dest < size; ++dest) {
-				Edge edge = job[source][dest];
-				if (edge.UnsatisfiedDemand() > 0) {
-					Path *path = paths[dest];
-					assert(path != nullptr);
-					/* Generally only allow paths that don't exceed the
-					 * available capacity. But if no demand has been assigned
-					 * yet, make an exception and allow any valid path *once*. */
-					if (path->GetFreeCapacity() > 0 && this->PushFlow(edge, path,
-							accuracy, this->max_saturation) > 0) {
-						/* If a path has been found there is a chance we can
-						 * find more. */
-						more_loops = more_loops || (edge.UnsatisfiedDemand() > 0);
-					} else if (edge.UnsatisfiedDemand() == edge.Demand() &&
-							path->GetFreeCapacity() > INT_MIN) {
-						this->PushFlow(edge, path, accuracy, UINT_MAX);
+			this->DijkstraBatch<DistanceAnnotation, GraphEdgeIterator>(batch, count, paths);
+
+			/* Assign the flows in source order. Once flow has been assigned the
+			 * paths of the following sources in the batch may be outdated. */
+			bool stale = false;
+			for (uint i = 0; i < count; ++i) {
+				NodeID source = batch[i];
+				bool source_demand_left = false;
+				bool pushed = false;
+				for (NodeID dest = 0; dest < size; ++dest) {
+					Edge edge = job[source][dest];
+					if (edge.UnsatisfiedDemand() > 0) {
+						Path *path = paths[i][dest];
+						assert(path != nullptr);
+						/* Generally only allow paths that don't exceed the
+						 * available capacity. But if no demand has been assigned
+						 * yet, make an exception and allow any valid path *once*. */
+						if (path->GetFreeCapacity() > 0 && this->PushFlow(edge, path,
+								accuracy, this->max_saturation) > 0) {
+							/* If a path has been found there is a chance we can
+							 * find more. */
+							more_loops = more_loops || (edge.UnsatisfiedDemand() > 0);
+							pushed = true;
+						} else if (stale && path->GetFreeCapacity() > 0) {
+							/* The capacity has been used up by an earlier source
+							 * of this batch. Search again with the current flows
+							 * before overloading the path. */
+							more_loops = true;
+						} else if (edge.UnsatisfiedDemand() == edge.Demand() &&
+								path->GetFreeCapacity() > INT_MIN) {
+							this->PushFlow(edge, path, accuracy, UINT_MAX);
+							pushed = true;
+						}
+						if (edge.UnsatisfiedDemand() > 0) source_demand_left = true;
 					}
-					if (edge.UnsatisfiedDemand() > 0) source_demand_left = true;
 				}
+				finished_sources[source] = !source_demand_left;
+				this->CleanupPaths(source, paths[i]);
+				stale = stale || pushed;
 			}
-			finished_sources[source] = !source_demand_left;
-			this->CleanupPaths(source, paths);
 		}
 	} while (more_loops || this->EliminateCycles());
 }
@@ -539,41 +708,47 @@ MCF1stPass::MCF1stPass(LinkGraphJob &job) : MultiCommodityFlow(job)
 MCF2ndPass::MCF2ndPass(LinkGraphJob &job) : MultiCommodityFlow(job)
 {
 	this->max_saturation = UINT_MAX; // disable artificial cap on saturation
-	PathVector paths;
+	PathVector paths[MCF_BATCH_SIZE];
+	NodeID batch[MCF_BATCH_SIZE];
 	uint size = job.Size();
 	uint accuracy = job.Settings().accuracy;
 	bool demand_left = true;
 	std::vector<bool> finished_sources(size);
 	while (demand_left) {
 		demand_left = false;
-		for (NodeID source = 0; source < size; ++source) {
-			if (finished_sources[source]) continue;
+		for (NodeID next = 0; next < size;) {
+			uint count = 0;
+			for (; next < size && count < MCF_BATCH_SIZE; ++next) {
+				if (!finished_sources[next]) batch[count++] = next;
+			}
 
-			this->Dijkstra<CapacityAnnotation, FlowEdgeIterator>(source, paths);
+			this->DijkstraBatch<CapacityAnnotation, FlowEdgeIterator>(batch, count, paths);
 
-			bool source_demand_left = false;
-			for (NodeID dest = 0; dest < size; ++dest) {
-				Edge edge = this->job[source][dest];
-				Path *path = paths[dest];
-				if (edge.UnsatisfiedDemand() > 0 && path->GetFreeCapacity() > INT_MIN) {
-					this->PushFlow(edge, path, accuracy, UINT_MAX);
-					if (edge.UnsatisfiedDemand() > 0) {
-						demand_left = true;
-						source_demand_left = true;
+			for (uint i = 0; i < count; ++i) {
+				NodeID source = batch[i];
+				bool source_demand_left = false;
+				for (NodeID dest = 0; dest < size; ++dest) {
+					Edge edge = this->job[source][dest];
+					Path *path = paths[i][dest];
+					if (edge.UnsatisfiedDemand() > 0 && path->GetFreeCapacity() > INT_MIN) {
+						this->PushFlow(edge, path, accuracy, UINT_MAX);
+						if (edge.UnsatisfiedDemand() > 0) {
+							demand_left = true;
+							source_demand_left = true;
+						}
 					}
 				}
+				finished_sources[source] = !source_demand_left;
+				this->CleanupPaths(source, paths[i]);
 			}
-			finished_sources[source] = !source_demand_left;
-			this->CleanupPaths(source, paths);
 		}
 	}
 }
 
 /**
  * Relation that creates a weak order without duplicates.
- * Avoid accidentally deleting different paths of the same capacity/distance in
- * a set. When the annotation is the same node IDs are compared, so there are
- * no equal ranges.
+ * When the annotation is the same node IDs are compared, so that the order in
+ * which nodes leave the queue is well defined.
  * @tparam T Type to be compared on.
  * @param x_anno First value.
  * @param y_anno Second value.
@@ -589,27 +764,106 @@ bool Greater(T x_anno, T y_anno, NodeID x, NodeID y)
 }
 
 /**
- * Compare two capacity annotations.
- * @param x First capacity annotation.
- * @param y Second capacity annotation.
+ * Compare two capacity annotations of different nodes.
+ * @param x_anno First capacity annotation.
+ * @param y_anno Second capacity annotation.
+ * @param x Node with the first annotation.
+ * @param y Node with the second annotation.
  * @return If x is better than y.
  */
-bool CapacityAnnotation::Comparator::operator()(const CapacityAnnotation *x,
-		const CapacityAnnotation *y) const
+/* static */ bool CapacityAnnotation::IsBefore(Value x_anno, Value y_anno, NodeID x, NodeID y)
 {
-	return x != y && Greater<int>(x->GetAnnotation(), y->GetAnnotation(),
-			x->GetNode(), y->GetNode());
+	return Greater<int>(x_anno, y_anno, x, y);
 }
 
 /**
- * Compare two distance annotations.
- * @param x First distance annotation.
- * @param y Second distance annotation.
+ * Compare two distance annotations of different nodes.
+ * @param x_anno First distance annotation.
+ * @param y_anno Second distance annotation.
+ * @param x Node with the first annotation.
+ * @param y Node with the second annotation.
  * @return If x is better than y.
  */
-bool DistanceAnnotation::Comparator::operator()(const DistanceAnnotation *x,
-		const DistanceAnnotation *y) const
+/* static */ bool DistanceAnnotation::IsBefore(Value x_anno, Value y_anno, NodeID x, NodeID y)
 {
-	return x != y && !Greater<uint>(x->GetAnnotation(), y->GetAnnotation(),
-			x->GetNode(), y->GetNode());
+	return !Greater<uint>(x_anno, y_anno, x, y);
+}
+
+/**
+ * Delete the paths the MCF passes left at the nodes of a job, like the flow mapper does.
+ * @param job Job to clean up.
+ */
+static void DeleteBenchmarkPaths(LinkGraphJob &job)
+{
+	for (NodeID node = 0; node < job.Size(); ++node) {
+		PathList &paths = job[node].Paths();
+		for (Path *path : paths) delete path;
+		paths.clear();
+	}
+}
+
+/**
+ * Time both MCF passes on a synthetic link graph. The nodes form a square grid
+ * over the map and are linked to their neighbours in the grid, roughly like the
+ * stations of a large network. Every node sends its supply to a few random other
+ * nodes. The graph only depends on its size, so runs before and after a change
+ * can be compared. The game state is not touched; the current link graph
+ * settings are used.
+ * @param size Number of nodes of the link graph.
+ * @param[out] first_pass Time taken by the first pass, in microseconds.
+ * @param[out] second_pass Time taken by the second pass, in microseconds.
+ */
+void BenchmarkMCF(uint size, uint64 *first_pass, uint64 *second_pass)
+{
+	static const uint DESTINATIONS = 4; ///< Number of destinations per node.
+
+	Randomizer random;
+	random.SetSeed(size);
+
+	uint width = 1;
+	while (width * width < size) width++;
+	uint spacing = max(1U, min(MapMaxX(), MapMaxY()) / width);
+
+	/* Neither the link graph nor the job live in their pools. */
+	LinkGraph lg(0);
+	lg.index = INVALID_LINK_GRAPH;
+	lg.Init(size);
+	for (NodeID node = 0; node < size; ++node) {
+		lg[node].UpdateLocation(TileXY((node % width) * spacing, (node / width) * spacing));
+		lg[node].UpdateSupply(100 + random.Next(900));
+	}
+	for (NodeID node = 0; node < size; ++node) {
+		uint neighbours[] = { node % width + 1 < width ? node + 1U : UINT_MAX, node + width };
+		for (uint to : neighbours) {
+			if (to >= size) continue;
+			lg[node].AddEdge(to, 10 + random.Next(990), 0, EUM_INCREASE);
+			lg[to].AddEdge(node, 10 + random.Next(990), 0, EUM_INCREASE);
+		}
+	}
+
+	LinkGraphJob job(lg);
+	job.Init();
+	for (NodeID node = 0; node < size; ++node) {
+		uint amount = lg[node].Supply() / DESTINATIONS;
+		for (uint i = 0; i < DESTINATIONS; ++i) {
+			NodeID to = random.Next(size);
+			if (to != node) job[node].DeliverSupply(to, amount);
+		}
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	{
+		MCF1stPass pass(job);
+	}
+	auto middle = std::chrono::steady_clock::now();
+	DeleteBenchmarkPaths(job);
+	auto restart = std::chrono::steady_clock::now();
+	{
+		MCF2ndPass pass(job);
+	}
+	auto end = std::chrono::steady_clock::now();
+	DeleteBenchmarkPaths(job);
+
+	*first_pass = std::chrono::duration_cast<std::chrono::microseconds>(middle - start).count();
+	*second_pass = std::chrono::duration_cast<std::chrono::microseconds>(end - restart).count();
 }
@@ -24,6 +24,9 @@ protected:
 	template<class Tannotation, class Tedge_iterator>
 	void Dijkstra(NodeID from, PathVector &paths);
 
+	template<class Tannotation, class Tedge_iterator>
+	void DijkstraBatch(const NodeID *sources, uint count, PathVector *paths);
+
 	uint PushFlow(Edge &edge, Path *path, uint accuracy, uint max_saturation);
 
 	void CleanupPaths(NodeID source, PathVector &paths);
@@ -89,4 +92,6 @@ public:
 	virtual ~MCFHandler() {}
 };
 
+void BenchmarkMCF(uint size, uint64 *first_pass, uint64 *second_pass);
+
 #endif /* MCF_H */
@@ -29,6 +29,10 @@ uint _map_tile_mask; ///< _map_size - 1 (to mask the mapsize)
 
 Tile *_m = nullptr;          ///< Tiles of the map
 TileExtended *_me = nullptr; ///< Extended Tiles of the map
+byte *_m_type = nullptr;     ///< Types of the tiles of the map
+byte *_m_height = nullptr;   ///< Heights of the tiles of the map
+bool _m_type_changed = true;   ///< Whether _m_type changed since the last incremental save.
+bool _m_height_changed = true; ///< Whether _m_height changed since the last incremental save.
 
 
 /**
@@ -58,9 +62,15 @@ void AllocateMap(uint size_x, uint size_y)
 
 	free(_m);
 	free(_me);
+	free(_m_type);
+	free(_m_height);
 
 	_m = CallocT<Tile>(_map_size);
 	_me = CallocT<TileExtended>(_map_size);
+	_m_type = CallocT<byte>(_map_size);
+	_m_height = CallocT<byte>(_map_size);
+	_m_type_changed = true;
+	_m_height_changed = true;
 }
 
 
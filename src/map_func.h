@@ -41,6 +41,31 @@ extern Tile *_m;
  */
 extern TileExtended *_me;
 
+/**
+ * Pointer to the tile type array.
+ *
+ * The type (bits 4..7), bridges (2..3) and rainforest/desert (0..1) of
+ * every tile. They are kept apart from the other tile data so scans over
+ * the tile types of the map do not have to pull in the rest of the tile.
+ */
+extern byte *_m_type;
+
+/**
+ * Pointer to the tile height array.
+ *
+ * The height of the northern corner of every tile. Just like the tile
+ * types, the heights are kept apart from the other tile data.
+ */
+extern byte *_m_height;
+
+/**
+ * Whether #_m_type, respectively #_m_height, changed since it was last
+ * written by an incremental save. Everything that writes to these arrays
+ * outside of loading a game must set them.
+ */
+extern bool _m_type_changed;
+extern bool _m_height_changed;
+
 void AllocateMap(uint size_x, uint size_y);
 
 /**
@@ -29,7 +29,9 @@
 #include "station_kdtree.h"
 #include "town_kdtree.h"
 #include "viewport_kdtree.h"
+#include "industry_kdtree.h"
 #include "newgrf_profiling.h"
+#include "pathfinder/yapf/yapf_cache.h"
 
 #include "safeguards.h"
 
@@ -82,6 +84,7 @@ void InitializeGame(uint size_x, uint size_y, bool reset_date, bool reset_settin
 
 	RebuildStationKdtree();
 	RebuildTownKdtree();
+	RebuildIndustryKdtree();
 	RebuildViewportKdtree();
 
 	ResetPersistentNewGRFData();
@@ -107,6 +110,8 @@ void InitializeGame(uint size_x, uint size_y, bool reset_date, bool reset_settin
 	InitializeBuildingCounts();
 
 	InitializeNPF();
+	YapfNotifyTrackLayoutChange(INVALID_TILE, INVALID_TRACK);
+	YapfNotifyWaterLayoutChange(INVALID_TILE);
 
 	InitializeCompanies();
 	AI::Initialize();
@@ -168,20 +168,20 @@ void NetworkSendCommand(TileIndex tile, uint32 p1, uint32 p2, uint32 cmd, Comman
 }
 
 /**
- * Sync our local command queue to the command queue of the given
- * socket. This is needed for the case where we receive a command
- * before saving the game for a joining client, but without the
- * execution of those commands. Not syncing those commands means
+ * Sync our local command queue to the given command queue for
+ * joining clients. This is needed for the case where we receive a
+ * command before saving the game for a joining client, but without
+ * the execution of those commands. Not syncing those commands means
  * that the client will never get them and as such will be in a
  * desynced state from the time it started with joining.
- * @param cs The client to sync the queue to.
+ * @param queue The queue to sync our queue to.
  */
-void NetworkSyncCommandQueue(NetworkClientSocket *cs)
+void NetworkSyncCommandQueue(CommandQueue *queue)
 {
 	for (CommandPacket *p = _local_execution_queue.Peek(); p != nullptr; p = p->next) {
 		CommandPacket c = *p;
 		c.callback = 0;
-		cs->outgoing_queue.Append(&c);
+		queue->Append(&c);
 	}
 }
 
@@ -248,6 +248,14 @@ static void DistributeCommandPacket(CommandPacket &cp, const NetworkClientSocket
 		}
 	}
 
+	/* Clients that start downloading the current map snapshot later on need it as well. */
+	CommandQueue *snapshot_queue = NetworkServerGetMapSnapshotCommandQueue();
+	if (snapshot_queue != nullptr) {
+		cp.callback = nullptr;
+		cp.my_cmd = false;
+		snapshot_queue->Append(&cp);
+	}
+
 	cp.callback = (nullptr != owner) ? nullptr : callback;
 	cp.my_cmd = (nullptr == owner);
 	_local_execution_queue.Append(&cp);
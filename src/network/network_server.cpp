@@ -29,7 +29,6 @@
 #include "../core/random_func.hpp"
 #include "../rev.h"
 #include <mutex>
-#include <condition_variable>
 
 #include "../safeguards.h"
 
@@ -52,153 +51,144 @@ INSTANTIATE_POOL_METHODS(NetworkClientSocket)
 /** Instantiate the listen sockets. */
 template SocketList TCPListenHandler<ServerNetworkGameSocketHandler, PACKET_SERVER_FULL, PACKET_SERVER_BANNED>::sockets;
 
-/** Writing a savegame directly to a number of packets. */
-struct PacketWriter : SaveFilter {
-	ServerNetworkGameSocketHandler *cs; ///< Socket we are associated with.
-	Packet *current;                    ///< The packet we're currently writing to.
-	size_t total_size;                  ///< Total size of the compressed savegame.
-	Packet *packets;                    ///< Packet queue of the savegame; send these "slowly" to the client.
-	std::mutex mutex;                   ///< Mutex for making threaded saving safe.
-	std::condition_variable exit_sig;   ///< Signal for threaded destruction of this packet writer.
-
-	/**
-	 * Create the packet writer.
-	 * @param cs The socket handler we're making the packets for.
-	 */
-	PacketWriter(ServerNetworkGameSocketHandler *cs) : SaveFilter(nullptr), cs(cs), current(nullptr), total_size(0), packets(nullptr)
-	{
-	}
-
-	/** Make sure everything is cleaned up. */
-	~PacketWriter()
+/**
+ * A savegame of the game that is sent to joining clients. Clients that start
+ * joining shortly after each other share a single snapshot, so the game only
+ * has to be saved and compressed once for all of them. Besides the savegame
+ * itself it keeps the commands that have to be executed after loading it, so
+ * a client that starts downloading a bit later can still catch up.
+ */
+struct MapSnapshot {
+	uint32 frame;           ///< The frame the snapshot was taken at.
+	CommandQueue commands;  ///< Commands queued at the time of the snapshot, and the ones that were distributed since.
+	std::vector<byte> data; ///< The compressed savegame, as far as it has been written.
+	bool finished;          ///< Whether the whole savegame has been written.
+	bool abandoned;         ///< Whether nobody is interested in the snapshot anymore, so saving should stop.
+	std::mutex mutex;       ///< Mutex for making threaded saving safe.
+
+	/** Create the snapshot of the current frame; the game has to be saved right after this. */
+	MapSnapshot() : frame(_frame_counter), finished(false), abandoned(false)
 	{
-		std::unique_lock<std::mutex> lock(this->mutex);
-
-		if (this->cs != nullptr) this->exit_sig.wait(lock);
-
-		/* This must all wait until the Destroy function is called. */
-
-		while (this->packets != nullptr) {
-			Packet *p = this->packets->next;
-			delete this->packets;
-			this->packets = p;
-		}
-
-		delete this->current;
+		NetworkSyncCommandQueue(&this->commands);
 	}
 
-	/**
-	 * Begin the destruction of this packet writer. It can happen in two ways:
-	 * in the first case the client disconnected while saving the map. In this
-	 * case the saving has not finished and killed this PacketWriter. In that
-	 * case we simply set cs to nullptr, triggering the appending to fail due to
-	 * the connection problem and eventually triggering the destructor. In the
-	 * second case the destructor is already called, and it is waiting for our
-	 * signal which we will send. Only then the packets will be removed by the
-	 * destructor.
-	 */
-	void Destroy()
+	/** Make sure the saving is cancelled before the snapshot disappears. */
+	~MapSnapshot()
 	{
 		std::unique_lock<std::mutex> lock(this->mutex);
+		if (this->finished) return;
 
-		this->cs = nullptr;
-
-		this->exit_sig.notify_all();
+		this->abandoned = true;
 		lock.unlock();
 
-		/* Make sure the saving is completely cancelled. Yes,
-		 * we need to handle the save finish as well as the
+		/* Yes, we need to handle the save finish as well as the
 		 * next connection might just be requesting a map. */
 		WaitTillSaved();
 		ProcessAsyncSaveFinish();
 	}
 
 	/**
-	 * Checks whether there are packets.
-	 * It's not 100% threading safe, but this is only asked for when checking
-	 * whether there still is something to send. Then another call will be made
-	 * to actually get the Packet, which will be the only one popping packets
-	 * and thus eventually setting this on false.
+	 * Whether clients that start joining now may still use this snapshot.
+	 * @return True iff the snapshot is recent enough.
 	 */
-	bool HasPackets()
+	bool IsJoinable() const
 	{
-		return this->packets != nullptr;
+		return _frame_counter - this->frame < _settings_client.network.map_snapshot_window;
 	}
 
 	/**
-	 * Pop a single created packet from the queue with packets.
+	 * Get the size of the savegame.
+	 * @param[out] size The size of the savegame, when it has been written completely.
+	 * @return True iff the savegame has been written completely.
 	 */
-	Packet *PopPacket()
+	bool GetSize(uint32 *size)
 	{
 		std::lock_guard<std::mutex> lock(this->mutex);
 
-		Packet *p = this->packets;
-		this->packets = p->next;
-		p->next = nullptr;
-
-		return p;
+		*size = (uint32)this->data.size();
+		return this->finished;
 	}
 
-	/** Append the current packet to the queue. */
-	void AppendQueue()
+	/**
+	 * Create the next packet of the map transfer.
+	 * @param[in,out] pos The amount of bytes the client already received.
+	 * @param[out] last Set when the returned packet is the last one of the transfer.
+	 * @return The packet, or \c nullptr when there is not enough data for it yet.
+	 */
+	Packet *GetPacket(size_t *pos, bool *last)
 	{
-		if (this->current == nullptr) return;
+		std::lock_guard<std::mutex> lock(this->mutex);
 
-		Packet **p = &this->packets;
-		while (*p != nullptr) {
-			p = &(*p)->next;
+		const size_t payload = SEND_MTU - sizeof(PacketSize) - sizeof(PacketType);
+		size_t to_write = min(payload, this->data.size() - *pos);
+		if (!this->finished) {
+			/* Only send full packets while the savegame is still being written. */
+			if (to_write != payload) return nullptr;
+		} else if (to_write == 0) {
+			*last = true;
+			return new Packet(PACKET_SERVER_MAP_DONE);
 		}
-		*p = this->current;
 
-		this->current = nullptr;
+		Packet *p = new Packet(PACKET_SERVER_MAP_DATA);
+		memcpy(p->buffer + p->size, this->data.data() + *pos, to_write);
+		p->size += (PacketSize)to_write;
+		*pos += to_write;
+		return p;
 	}
+};
 
-	void Write(byte *buf, size_t size) override
-	{
-		/* We want to abort the saving when the socket is closed. */
-		if (this->cs == nullptr) SlError(STR_NETWORK_ERROR_LOSTCONNECTION);
+/** The snapshot clients that start joining now will get, if any. */
+static std::shared_ptr<MapSnapshot> _map_snapshot;
 
-		if (this->current == nullptr) this->current = new Packet(PACKET_SERVER_MAP_DATA);
+/** Writing a savegame directly into a map snapshot. */
+struct MapSnapshotWriter : SaveFilter {
+	MapSnapshot *snapshot; ///< The snapshot we are writing to.
 
-		std::lock_guard<std::mutex> lock(this->mutex);
+	/**
+	 * Create the snapshot writer.
+	 * @param snapshot The snapshot to write to; it outlives the saving.
+	 */
+	MapSnapshotWriter(MapSnapshot *snapshot) : SaveFilter(nullptr), snapshot(snapshot)
+	{
+	}
 
-		byte *bufe = buf + size;
-		while (buf != bufe) {
-			size_t to_write = min(SEND_MTU - this->current->size, bufe - buf);
-			memcpy(this->current->buffer + this->current->size, buf, to_write);
-			this->current->size += (PacketSize)to_write;
-			buf += to_write;
+	void Write(byte *buf, size_t size) override
+	{
+		std::lock_guard<std::mutex> lock(this->snapshot->mutex);
 
-			if (this->current->size == SEND_MTU) {
-				this->AppendQueue();
-				if (buf != bufe) this->current = new Packet(PACKET_SERVER_MAP_DATA);
-			}
-		}
+		/* We want to abort the saving when no client needs the map anymore. */
+		if (this->snapshot->abandoned) SlError(STR_NETWORK_ERROR_LOSTCONNECTION);
 
-		this->total_size += size;
+		this->snapshot->data.insert(this->snapshot->data.end(), buf, buf + size);
 	}
 
 	void Finish() override
 	{
-		/* We want to abort the saving when the socket is closed. */
-		if (this->cs == nullptr) SlError(STR_NETWORK_ERROR_LOSTCONNECTION);
-
-		std::lock_guard<std::mutex> lock(this->mutex);
-
-		/* Make sure the last packet is flushed. */
-		this->AppendQueue();
+		std::lock_guard<std::mutex> lock(this->snapshot->mutex);
 
-		/* Add a packet stating that this is the end to the queue. */
-		this->current = new Packet(PACKET_SERVER_MAP_DONE);
-		this->AppendQueue();
+		if (this->snapshot->abandoned) SlError(STR_NETWORK_ERROR_LOSTCONNECTION);
 
-		/* Fast-track the size to the client. */
-		Packet *p = new Packet(PACKET_SERVER_MAP_SIZE);
-		p->Send_uint32((uint32)this->total_size);
-		this->cs->NetworkTCPSocketHandler::SendPacket(p);
+		this->snapshot->finished = true;
 	}
 };
 
+/**
+ * Get the queue the commands that are distributed now have to be added to, so
+ * clients that start downloading the current map snapshot can catch up later.
+ * @return The queue, or \c nullptr when no client can join the current snapshot anymore.
+ */
+CommandQueue *NetworkServerGetMapSnapshotCommandQueue()
+{
+	if (_map_snapshot == nullptr || !_map_snapshot->IsJoinable()) return nullptr;
+	return &_map_snapshot->commands;
+}
+
+/** Forget the current map snapshot, so new clients get a fresh one. */
+void NetworkServerResetMapSnapshot()
+{
+	_map_snapshot.reset();
+}
+
 
 /**
  * Create a new socket for the server side of the game connection.
@@ -224,10 +214,7 @@ ServerNetworkGameSocketHandler::~ServerNetworkGameSocketHandler()
 	if (_redirect_console_to_client == this->client_id) _redirect_console_to_client = INVALID_CLIENT_ID;
 	OrderBackup::ResetUser(this->client_id);
 
-	if (this->savegame != nullptr) {
-		this->savegame->Destroy();
-		this->savegame = nullptr;
-	}
+	this->savegame.reset();
 }
 
 Packet *ServerNetworkGameSocketHandler::ReceivePacket()
@@ -558,40 +545,58 @@ NetworkRecvStatus ServerNetworkGameSocketHandler::SendWait()
 /** This sends the map to the client */
 NetworkRecvStatus ServerNetworkGameSocketHandler::SendMap()
 {
-	static uint sent_packets; // How many packets we did send successfully last time
-
 	if (this->status < STATUS_AUTHORIZED) {
 		/* Illegal call, return error and ignore the packet */
 		return this->SendError(NETWORK_ERROR_NOT_AUTHORIZED);
 	}
 
 	if (this->status == STATUS_AUTHORIZED) {
-		this->savegame = new PacketWriter(this);
+		if (_map_snapshot == nullptr || !_map_snapshot->IsJoinable()) {
+			/* Make a dump of the current game */
+			_map_snapshot.reset();
+			WaitTillSaved();
+			_map_snapshot = std::make_shared<MapSnapshot>();
+			if (SaveWithFilter(new MapSnapshotWriter(_map_snapshot.get()), true) != SL_OK) usererror("network savedump failed");
+		}
+
+		this->savegame = _map_snapshot;
+		this->savegame_pos = 0;
+		this->savegame_size_sent = false;
 
-		/* Now send the _frame_counter and how many packets are coming */
+		/* Now send the frame of the snapshot and how many packets are coming */
 		Packet *p = new Packet(PACKET_SERVER_MAP_BEGIN);
-		p->Send_uint32(_frame_counter);
+		p->Send_uint32(this->savegame->frame);
 		this->SendPacket(p);
 
-		NetworkSyncCommandQueue(this);
+		/* Give the client all commands since the snapshot was taken. */
+		for (CommandPacket *cp = this->savegame->commands.Peek(); cp != nullptr; cp = cp->next) {
+			this->outgoing_queue.Append(cp);
+		}
+
 		this->status = STATUS_MAP;
 		/* Mark the start of download */
 		this->last_frame = _frame_counter;
 		this->last_frame_server = _frame_counter;
 
-		sent_packets = 4; // We start with trying 4 packets
-
-		/* Make a dump of the current game */
-		if (SaveWithFilter(this->savegame, true) != SL_OK) usererror("network savedump failed");
+		this->savegame_packets = 4; // We start with trying 4 packets
 	}
 
 	if (this->status == STATUS_MAP) {
 		bool last_packet = false;
 		bool has_packets = false;
 
-		for (uint i = 0; (has_packets = this->savegame->HasPackets()) && i < sent_packets; i++) {
-			Packet *p = this->savegame->PopPacket();
-			last_packet = p->buffer[2] == PACKET_SERVER_MAP_DONE;
+		uint32 size;
+		if (!this->savegame_size_sent && this->savegame->GetSize(&size)) {
+			/* Let the client know how much is coming, as soon as we know. */
+			Packet *p = new Packet(PACKET_SERVER_MAP_SIZE);
+			p->Send_uint32(size);
+			this->SendPacket(p);
+			this->savegame_size_sent = true;
+		}
+
+		for (uint i = 0; i < this->savegame_packets; i++) {
+			Packet *p = this->savegame->GetPacket(&this->savegame_pos, &last_packet);
+			if (p == nullptr) break;
 
 			this->SendPacket(p);
 
@@ -599,12 +604,14 @@ NetworkRecvStatus ServerNetworkGameSocketHandler::SendMap()
 				/* There is no more data, so break the for */
 				break;
 			}
+
+			/* We sent as many packets as we wanted, but there might be more. */
+			has_packets = i + 1 == this->savegame_packets;
 		}
 
 		if (last_packet) {
-			/* Done reading, make sure saving is done as well */
-			this->savegame->Destroy();
-			this->savegame = nullptr;
+			/* Done reading; other clients might still be using the snapshot */
+			this->savegame.reset();
 
 			/* Set the status to DONE_MAP, no we will wait for the client
 			 *  to send it is ready (maybe that happens like never ;)) */
@@ -626,9 +633,16 @@ NetworkRecvStatus ServerNetworkGameSocketHandler::SendMap()
 				best->status = STATUS_AUTHORIZED;
 				best->SendMap();
 
-				/* And update the rest. */
+				/* And let the rest share its snapshot, or update them when that is not possible. */
 				for (NetworkClientSocket *new_cs : NetworkClientSocket::Iterate()) {
-					if (new_cs->status == STATUS_MAP_WAIT) new_cs->SendWait();
+					if (new_cs->status != STATUS_MAP_WAIT) continue;
+
+					if (_map_snapshot != nullptr && _map_snapshot->IsJoinable()) {
+						new_cs->status = STATUS_AUTHORIZED;
+						new_cs->SendMap();
+					} else {
+						new_cs->SendWait();
+					}
 				}
 			}
 		}
@@ -639,7 +653,7 @@ NetworkRecvStatus ServerNetworkGameSocketHandler::SendMap()
 
 			case SPS_ALL_SENT:
 				/* All are sent, increase the sent_packets */
-				if (has_packets) sent_packets *= 2;
+				if (has_packets) this->savegame_packets *= 2;
 				break;
 
 			case SPS_PARTLY_SENT:
@@ -648,7 +662,7 @@ NetworkRecvStatus ServerNetworkGameSocketHandler::SendMap()
 
 			case SPS_NONE_SENT:
 				/* Not everything is sent, decrease the sent_packets */
-				if (sent_packets > 1) sent_packets /= 2;
+				if (this->savegame_packets > 1) this->savegame_packets /= 2;
 				break;
 		}
 	}
@@ -1005,12 +1019,15 @@ NetworkRecvStatus ServerNetworkGameSocketHandler::Receive_CLIENT_GETMAP(Packet *
 		return this->SendError(NETWORK_ERROR_NOT_AUTHORIZED);
 	}
 
-	/* Check if someone else is receiving the map */
-	for (NetworkClientSocket *new_cs : NetworkClientSocket::Iterate()) {
-		if (new_cs->status == STATUS_MAP) {
-			/* Tell the new client to wait */
-			this->status = STATUS_MAP_WAIT;
-			return this->SendWait();
+	/* Share the map snapshot that is being sent already, if it is recent enough. Otherwise
+	 * check if someone else is receiving the map, as only one snapshot is made at a time. */
+	if (_map_snapshot == nullptr || !_map_snapshot->IsJoinable()) {
+		for (NetworkClientSocket *new_cs : NetworkClientSocket::Iterate()) {
+			if (new_cs->status == STATUS_MAP) {
+				/* Tell the new client to wait */
+				this->status = STATUS_MAP_WAIT;
+				return this->SendWait();
+			}
 		}
 	}
 
@@ -1795,6 +1812,9 @@ void NetworkServer_Tick(bool send_frame)
 	}
 #endif
 
+	/* Nobody can start downloading the map snapshot anymore; clients that are still downloading it keep it alive. */
+	if (_map_snapshot != nullptr && !_map_snapshot->IsJoinable()) _map_snapshot.reset();
+
 	/* Now we are done with the frame, inform the clients that they can
 	 *  do their frame! */
 	for (NetworkClientSocket *cs : NetworkClientSocket::Iterate()) {
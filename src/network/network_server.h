@@ -12,6 +12,7 @@
 
 #include "network_internal.h"
 #include "core/tcp_listen.h"
+#include <memory>
 
 class ServerNetworkGameSocketHandler;
 /** Make the code look slightly nicer/simpler. */
@@ -70,7 +71,10 @@ public:
 	CommandQueue outgoing_queue; ///< The command-queue awaiting delivery
 	int receive_limit;           ///< Amount of bytes that we can receive at this moment
 
-	struct PacketWriter *savegame; ///< Writer used to write the savegame.
+	std::shared_ptr<struct MapSnapshot> savegame; ///< Snapshot of the map the client is downloading.
+	size_t savegame_pos;           ///< Amount of bytes of the snapshot that have been sent.
+	uint savegame_packets;         ///< Number of map packets to try sending at once.
+	bool savegame_size_sent;       ///< Whether the size of the snapshot has been sent.
 	NetworkAddress client_address; ///< IP-address of the client (so he can be banned)
 
 	ServerNetworkGameSocketHandler(SOCKET s);
@@ -119,5 +123,7 @@ public:
 void NetworkServer_Tick(bool send_frame);
 void NetworkServerSetCompanyPassword(CompanyID company_id, const char *password, bool already_hashed = true);
 void NetworkServerUpdateCompanyPassworded(CompanyID company_id, bool passworded);
+CommandQueue *NetworkServerGetMapSnapshotCommandQueue();
+void NetworkServerResetMapSnapshot();
 
 #endif /* NETWORK_SERVER_H */
@@ -10,6 +10,7 @@
 #include "stdafx.h"
 #include "debug.h"
 #include "industry.h"
+#include "industry_kdtree.h"
 #include "newgrf_industries.h"
 #include "newgrf_town.h"
 #include "newgrf_cargo.h"
@@ -90,14 +91,14 @@ uint32 GetIndustryIDAtOffset(TileIndex tile, const Industry *i, uint32 cur_grfid
 
 static uint32 GetClosestIndustry(TileIndex tile, IndustryType type, const Industry *current)
 {
-	uint32 best_dist = UINT32_MAX;
-	for (const Industry *i : Industry::Iterate()) {
-		if (i->type != type || i == current) continue;
+	if (Industry::GetIndustryTypeCount(type) == 0 || _industry_kdtree.Count() == 0) return UINT32_MAX;
 
-		best_dist = min(best_dist, DistanceManhattan(tile, i->location.tile));
-	}
+	std::pair<IndustryID, int> closest = _industry_kdtree.FindNearest(TileX(tile), TileY(tile), [type, current](IndustryID id) {
+		const Industry *i = Industry::Get(id);
+		return i->type == type && i != current;
+	});
 
-	return best_dist;
+	return closest.second == std::numeric_limits<int>::max() ? UINT32_MAX : (uint32)closest.second;
 }
 
 /**
@@ -66,6 +66,9 @@
 #include "framerate_type.h"
 
 #include "linkgraph/linkgraphschedule.h"
+#include "pathfinder/pathfinder_jobs.h"
+#include "pathfinder/pf_benchmark.h"
+#include "pathfinder/yapf/yapf_regions.h"
 
 #include <stdarg.h>
 #include <system_error>
@@ -1318,6 +1321,9 @@ static void CheckCaches()
 			assert(memcmp(&st->goods[c].cargo, buff, sizeof(StationCargoList)) == 0);
 		}
 	}
+
+	/* Check the abstract rail and water graphs against the map. */
+	YapfRegionsCheckCaches();
 }
 
 /**
@@ -1379,6 +1385,8 @@ void StateGameLoop()
 		IncreaseDate();
 		RunTileLoop();
 		CallVehicleTicks();
+		RunPathfinderJobs();
+		PfBenchmarkTick();
 		CallLandscapeTick();
 		BasePersistentStorageArray::SwitchMode(PSM_LEAVE_GAMELOOP);
 
@@ -24,6 +24,7 @@
 #include "../../stdafx.h"
 #include "../../core/alloc_func.hpp"
 #include "aystar.h"
+#include "../pf_benchmark.h"
 
 #include "../../safeguards.h"
 
@@ -258,6 +259,7 @@ int AyStar::Main()
 #endif
 	if (r != AYSTAR_STILL_BUSY) {
 		/* We're done, clean up */
+		_pf_closed_nodes += this->closedlist_hash.GetSize();
 		this->Clear();
 	}
 
@@ -0,0 +1,41 @@
+/*
+ * This file is part of OpenTTD.
+ * OpenTTD is free software; you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 2.
+ * OpenTTD is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details. You should have received a copy of the GNU General Public License along with OpenTTD. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file pathfinder_jobs.cpp Execution of pathfinder searches that are requested ahead of time. */
+
+#include "../stdafx.h"
+#include "pathfinder_jobs.h"
+#include "../worker_pool.h"
+
+#include <memory>
+#include <vector>
+
+#include "../safeguards.h"
+
+static std::vector<std::unique_ptr<PathfinderJob>> _pathfinder_jobs; ///< Jobs requested during the current tick.
+
+/**
+ * Request a search to be executed at the end of the current tick.
+ * @param job The search; ownership is taken over.
+ */
+void QueuePathfinderJob(PathfinderJob *job)
+{
+	_pathfinder_jobs.emplace_back(job);
+}
+
+/** Execute all requested searches and apply their results, in the order they were requested. */
+void RunPathfinderJobs()
+{
+	if (_pathfinder_jobs.empty()) return;
+
+	WorkerPool::Run((uint)_pathfinder_jobs.size(), [](uint i) {
+		_pathfinder_jobs[i]->Run();
+	});
+
+	for (auto &job : _pathfinder_jobs) job->Apply();
+	_pathfinder_jobs.clear();
+}
@@ -0,0 +1,40 @@
+/*
+ * This file is part of OpenTTD.
+ * OpenTTD is free software; you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 2.
+ * OpenTTD is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details. You should have received a copy of the GNU General Public License along with OpenTTD. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file pathfinder_jobs.h Pathfinder searches that are requested ahead of the moment their result is needed. */
+
+#ifndef PATHFINDER_JOBS_H
+#define PATHFINDER_JOBS_H
+
+/**
+ * A pathfinder search that is requested before its result is needed.
+ * All jobs requested during a tick are executed together, in parallel, at a
+ * fixed point of that tick at which nothing changes the game state. The game
+ * loop waits for them there, so they do not overlap with later ticks. Their
+ * results are then applied in the order the jobs were requested, so the
+ * outcome is the same for all clients no matter how the jobs were spread
+ * over the threads. Whoever consumes the result later must still check
+ * whether it is applicable, and search synchronously when it is not.
+ */
+class PathfinderJob {
+public:
+	virtual ~PathfinderJob() {}
+
+	/**
+	 * Execute the search. This may run on any thread, so it must only read the
+	 * game state and keep its result to itself.
+	 */
+	virtual void Run() = 0;
+
+	/** Apply the result of the search to the game state; called on the main thread. */
+	virtual void Apply() = 0;
+};
+
+void QueuePathfinderJob(PathfinderJob *job);
+void RunPathfinderJobs();
+
+#endif /* PATHFINDER_JOBS_H */
@@ -0,0 +1,180 @@
+/*
+ * This file is part of OpenTTD.
+ * OpenTTD is free software; you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 2.
+ * OpenTTD is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details. You should have received a copy of the GNU General Public License along with OpenTTD. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file pf_benchmark.cpp Replaying the pathfinder queries of a running game against all pathfinders. */
+
+#include "../stdafx.h"
+#include "pf_benchmark.h"
+#include "npf/npf_func.h"
+#include "yapf/yapf.h"
+#include "../train.h"
+#include "../roadveh.h"
+#include "../ship.h"
+#include "../console_func.h"
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include "../safeguards.h"
+
+std::atomic<uint> _pf_closed_nodes(0); ///< Number of nodes closed by all pathfinder searches so far.
+uint _pf_benchmark_ticks = 0;          ///< Number of ticks the queries are still being replayed.
+bool _pf_benchmark_replaying = false;  ///< Whether a query is being replayed right now; replays bypass the global segment cost cache.
+
+/** Vehicle types the queries are replayed for. */
+enum PfBenchmarkVehicle {
+	PFBV_TRAIN, ///< Trains.
+	PFBV_ROAD,  ///< Road vehicles.
+	PFBV_SHIP,  ///< Ships.
+	PFBV_END,
+};
+
+/** Pathfinders the queries are replayed against. */
+enum PfBenchmarkPathfinder {
+	PFBP_NPF,  ///< The new pathfinder.
+	PFBP_YAPF, ///< Yet another pathfinder.
+	PFBP_END,
+};
+
+/** The measurements of one pathfinder for one vehicle type. */
+struct PfBenchmarkStats {
+	std::vector<uint> latencies; ///< Time every query took, in nanoseconds.
+	uint64 nodes;                ///< Number of nodes closed by all queries.
+	uint not_found;              ///< Number of queries that did not find the destination.
+};
+
+static PfBenchmarkStats _pf_benchmark_stats[PFBV_END][PFBP_END]; ///< Measurements of every pathfinder.
+static uint _pf_benchmark_diverged[PFBV_END];                     ///< Number of queries the pathfinders chose differently for.
+
+/**
+ * Replay all pathfinder queries of the coming ticks.
+ * @param ticks The number of ticks to record.
+ */
+void PfBenchmarkStart(uint ticks)
+{
+	for (uint i = 0; i < PFBV_END; i++) {
+		for (PfBenchmarkStats &stats : _pf_benchmark_stats[i]) {
+			stats.latencies.clear();
+			stats.nodes = 0;
+			stats.not_found = 0;
+		}
+		_pf_benchmark_diverged[i] = 0;
+	}
+	_pf_benchmark_ticks = ticks;
+}
+
+/**
+ * Get a percentile of sorted latencies.
+ * @param latencies The sorted latencies.
+ * @param percent The percentile.
+ * @return The latency in microseconds.
+ */
+static double GetLatencyPercentile(const std::vector<uint> &latencies, uint percent)
+{
+	return latencies[(latencies.size() - 1) * percent / 100] / 1000.0;
+}
+
+/** Print the measurements of the replayed queries. */
+static void PfBenchmarkReport()
+{
+	static const char * const vehicle_names[] = { "train", "road vehicle", "ship" };
+	static const char * const pathfinder_names[] = { "NPF", "YAPF" };
+
+	for (uint i = 0; i < PFBV_END; i++) {
+		uint queries = (uint)_pf_benchmark_stats[i][PFBP_NPF].latencies.size();
+		if (queries == 0) continue;
+
+		IConsolePrintF(CC_DEFAULT, "%s: %u queries, %u with a different choice", vehicle_names[i], queries, _pf_benchmark_diverged[i]);
+		for (uint j = 0; j < PFBP_END; j++) {
+			PfBenchmarkStats &stats = _pf_benchmark_stats[i][j];
+			std::sort(stats.latencies.begin(), stats.latencies.end());
+			IConsolePrintF(CC_DEFAULT, "  %-4s latency p50 %.1f us, p90 %.1f us, p99 %.1f us, max %.1f us; %.1f nodes per query; %u not found",
+					pathfinder_names[j], GetLatencyPercentile(stats.latencies, 50), GetLatencyPercentile(stats.latencies, 90),
+					GetLatencyPercentile(stats.latencies, 99), GetLatencyPercentile(stats.latencies, 100),
+					(double)stats.nodes / queries, stats.not_found);
+		}
+	}
+	IConsolePrint(CC_DEFAULT, "Pathfinder benchmark finished.");
+}
+
+/** Count down the ticks to record; called once every game tick. */
+void PfBenchmarkTick()
+{
+	if (_pf_benchmark_ticks != 0 && --_pf_benchmark_ticks == 0) PfBenchmarkReport();
+}
+
+/**
+ * Run one query and measure it. The query neither uses nor fills the global
+ * segment cost cache, so it does not speed up the real query that follows it.
+ * @param stats The measurements to add the query to.
+ * @param query The query; gets whether the path was found and returns the choice.
+ * @return The choice of the pathfinder.
+ */
+template <class Tquery>
+static int MeasureQuery(PfBenchmarkStats &stats, Tquery query)
+{
+	bool path_found = true;
+	uint nodes = _pf_closed_nodes;
+	_pf_benchmark_replaying = true;
+	auto start = std::chrono::steady_clock::now();
+	int choice = query(path_found);
+	auto end = std::chrono::steady_clock::now();
+	_pf_benchmark_replaying = false;
+
+	stats.latencies.push_back((uint)std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+	stats.nodes += _pf_closed_nodes - nodes;
+	if (!path_found) stats.not_found++;
+	return choice;
+}
+
+/**
+ * Replay the query of a train against all pathfinders, without reserving anything.
+ * @param v The train.
+ * @param tile The tile the train is about to enter.
+ * @param enterdir Diagonal direction the train is coming from.
+ * @param tracks Usable tracks on the new tile.
+ */
+void PfBenchmarkTrain(const Train *v, TileIndex tile, DiagDirection enterdir, TrackBits tracks)
+{
+	PfBenchmarkStats *stats = _pf_benchmark_stats[PFBV_TRAIN];
+	int npf = MeasureQuery(stats[PFBP_NPF], [&](bool &path_found) { return NPFTrainChooseTrack(v, path_found, false, nullptr); });
+	int yapf = MeasureQuery(stats[PFBP_YAPF], [&](bool &path_found) { return YapfTrainChooseTrack(v, tile, enterdir, tracks, path_found, false, nullptr); });
+	if (npf != yapf) _pf_benchmark_diverged[PFBV_TRAIN]++;
+}
+
+/**
+ * Replay the query of a road vehicle against all pathfinders, without touching its path cache.
+ * @param v The road vehicle.
+ * @param tile The tile the road vehicle is about to enter.
+ * @param enterdir Diagonal direction the road vehicle is coming from.
+ * @param trackdirs Usable trackdirs on the new tile.
+ */
+void PfBenchmarkRoadVehicle(const RoadVehicle *v, TileIndex tile, DiagDirection enterdir, TrackdirBits trackdirs)
+{
+	PfBenchmarkStats *stats = _pf_benchmark_stats[PFBV_ROAD];
+	RoadVehPathCache path_cache;
+	int npf = MeasureQuery(stats[PFBP_NPF], [&](bool &path_found) { return NPFRoadVehicleChooseTrack(v, tile, enterdir, path_found); });
+	int yapf = MeasureQuery(stats[PFBP_YAPF], [&](bool &path_found) { return YapfRoadVehicleChooseTrack(v, tile, enterdir, trackdirs, path_found, path_cache); });
+	if (npf != yapf) _pf_benchmark_diverged[PFBV_ROAD]++;
+}
+
+/**
+ * Replay the query of a ship against all pathfinders, without touching its path cache.
+ * @param v The ship.
+ * @param tile The tile the ship is about to enter.
+ * @param enterdir Diagonal direction the ship is coming from.
+ * @param tracks Usable tracks on the new tile.
+ */
+void PfBenchmarkShip(const Ship *v, TileIndex tile, DiagDirection enterdir, TrackBits tracks)
+{
+	PfBenchmarkStats *stats = _pf_benchmark_stats[PFBV_SHIP];
+	ShipPathCache path_cache;
+	int npf = MeasureQuery(stats[PFBP_NPF], [&](bool &path_found) { return NPFShipChooseTrack(v, path_found); });
+	int yapf = MeasureQuery(stats[PFBP_YAPF], [&](bool &path_found) { return YapfShipChooseTrack(v, tile, enterdir, tracks, path_found, path_cache); });
+	if (npf != yapf) _pf_benchmark_diverged[PFBV_SHIP]++;
+}
@@ -0,0 +1,42 @@
+/*
+ * This file is part of OpenTTD.
+ * OpenTTD is free software; you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 2.
+ * OpenTTD is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details. You should have received a copy of the GNU General Public License along with OpenTTD. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file pf_benchmark.h Replaying the pathfinder queries of a running game against all pathfinders. */
+
+#ifndef PF_BENCHMARK_H
+#define PF_BENCHMARK_H
+
+#include "../track_type.h"
+#include "../direction_type.h"
+#include "../tile_type.h"
+
+#include <atomic>
+
+struct Train;
+struct RoadVehicle;
+struct Ship;
+
+extern std::atomic<uint> _pf_closed_nodes;
+extern uint _pf_benchmark_ticks;
+extern bool _pf_benchmark_replaying;
+
+/**
+ * Check whether the pathfinder queries are being replayed.
+ * @return True iff every query should be passed to the benchmark first.
+ */
+static inline bool PfBenchmarkIsRecording()
+{
+	return _pf_benchmark_ticks != 0;
+}
+
+void PfBenchmarkStart(uint ticks);
+void PfBenchmarkTick();
+void PfBenchmarkTrain(const Train *v, TileIndex tile, DiagDirection enterdir, TrackBits tracks);
+void PfBenchmarkRoadVehicle(const RoadVehicle *v, TileIndex tile, DiagDirection enterdir, TrackdirBits trackdirs);
+void PfBenchmarkShip(const Ship *v, TileIndex tile, DiagDirection enterdir, TrackBits tracks);
+
+#endif /* PF_BENCHMARK_H */
@@ -14,6 +14,14 @@
 #include "../../misc/hashtable.hpp"
 #include "../../misc/binaryheap.hpp"
 
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <vector>
+
+/** Enable it to let YAPF use the old hash table based node list, e.g. to compare the performance of both. */
+#define YAPF_NODELIST_HASHTABLE 0
+
 /**
  * Hash table based node list multi-container class.
  *  Implements open list, closed list and priority queue for A-star
@@ -157,4 +165,340 @@ public:
 	}
 };
 
+/**
+ * Node list multi-container class with the nodes stored in an arena.
+ *  Implements open list, closed list and priority queue for A-star
+ *  path finder. Nodes are referred to by their 32 bit index in the arena;
+ *  an open addressing hash table maps keys to the index of their open or
+ *  closed node, and a 4-ary heap of (estimate, index) pairs orders the open
+ *  nodes. The memory is kept for the next search instead of being freed.
+ */
+template <class Titem_, int Thash_bits_open_, int Thash_bits_closed_>
+class CNodeList_ArenaT {
+public:
+	typedef Titem_ Titem;             ///< Make #Titem_ visible from outside of class.
+	typedef typename Titem_::Key Key; ///< Make Titem_::Key a property of this class.
+
+protected:
+	static_assert(std::is_trivially_destructible<Titem_>::value, "Nodes are dropped without calling their destructor");
+
+	static const uint BLOCK_BITS = 10;                ///< The arena allocates (1 << BLOCK_BITS) nodes at once.
+	static const uint MAX_KEPT_BLOCKS = 64;           ///< Maximum number of blocks kept for the next search.
+	static const uint MAX_KEPT_STORAGES = 32;         ///< Maximum number of unused storages kept for the next searches.
+	static const uint HEAP_ARITY = 4;                 ///< Number of children of every heap entry.
+	static const uint32 INVALID_INDEX = UINT32_MAX;   ///< Index of no node; marks empty hash slots.
+	static const uint32 NOT_OPEN = UINT32_MAX;        ///< Heap position of nodes that are neither open nor closed.
+	static const uint32 CLOSED = UINT32_MAX - 1;      ///< Heap position of closed nodes.
+
+	/** Open node in the heap. */
+	struct HeapEntry {
+		int estimate; ///< Cost estimate of the node.
+		uint32 index; ///< Index of the node.
+	};
+
+	/** Memory of a node list, which is handed to the next node list when the search is done. */
+	struct Storage {
+		std::vector<Titem_ *> blocks;  ///< Blocks of the arena.
+		std::vector<uint32> heap_pos;  ///< Position of every node in the heap, #NOT_OPEN or #CLOSED.
+		std::vector<uint32> slots;     ///< Open addressing hash table with node indices.
+		std::vector<HeapEntry> heap;   ///< Heap of open nodes.
+
+		~Storage()
+		{
+			for (Titem_ *block : this->blocks) free(block);
+		}
+	};
+
+	typedef std::vector<std::unique_ptr<Storage>> StoragePool; ///< Unused storages.
+
+	Storage *m;          ///< Memory of this node list.
+	uint32 m_num_nodes;  ///< Number of nodes in the arena.
+	uint32 m_num_keys;   ///< Number of used hash slots.
+	uint m_hash_bits;    ///< Size of the hash table, in bits.
+	int m_open_count;    ///< Number of open nodes.
+	int m_closed_count;  ///< Number of closed nodes.
+	uint32 m_new_node;   ///< Index of the new node under construction.
+
+	/** Get the lock and the pool of unused storages. */
+	static StoragePool &GetPool(std::unique_lock<std::mutex> &lock)
+	{
+		static std::mutex mutex;
+		static StoragePool pool;
+		lock = std::unique_lock<std::mutex>(mutex);
+		return pool;
+	}
+
+	/** Get the node with the given index. */
+	inline Titem_ *GetNode(uint32 index) const
+	{
+		return this->m->blocks[index >> BLOCK_BITS] + (index & ((1 << BLOCK_BITS) - 1));
+	}
+
+	/**
+	 * Find the hash slot of a key.
+	 * @param key The key to look for.
+	 * @return The slot with the node of the key, or the empty slot where it belongs.
+	 */
+	inline uint FindSlot(const Key &key) const
+	{
+		uint mask = (1 << this->m_hash_bits) - 1;
+		uint pos = ((uint32)key.CalcHash() * 0x9E3779B1U) >> (32 - this->m_hash_bits);
+		for (;; pos = (pos + 1) & mask) {
+			uint32 index = this->m->slots[pos];
+			if (index == INVALID_INDEX || this->GetNode(index)->GetKey() == key) return pos;
+		}
+	}
+
+	/** Double the size of the hash table. */
+	void GrowHashTable()
+	{
+		std::vector<uint32> old_slots;
+		old_slots.swap(this->m->slots);
+		this->m_hash_bits++;
+		this->m->slots.assign((size_t)1 << this->m_hash_bits, INVALID_INDEX);
+		for (uint32 index : old_slots) {
+			if (index != INVALID_INDEX) this->m->slots[this->FindSlot(this->GetNode(index)->GetKey())] = index;
+		}
+	}
+
+	/** Put an entry at a position of the heap. */
+	inline void HeapSet(uint pos, const HeapEntry &entry)
+	{
+		this->m->heap[pos] = entry;
+		this->m->heap_pos[entry.index] = pos;
+	}
+
+	/** Move an entry from the given position of the heap up until it is in order. */
+	inline void HeapSiftUp(uint pos, HeapEntry entry)
+	{
+		std::vector<HeapEntry> &heap = this->m->heap;
+		while (pos > 0) {
+			uint parent = (pos - 1) / HEAP_ARITY;
+			if (!(entry.estimate < heap[parent].estimate)) break;
+			this->HeapSet(pos, heap[parent]);
+			pos = parent;
+		}
+		this->HeapSet(pos, entry);
+	}
+
+	/** Move an entry from the given position of the heap down until it is in order. */
+	inline void HeapSiftDown(uint pos, HeapEntry entry)
+	{
+		std::vector<HeapEntry> &heap = this->m->heap;
+		uint size = (uint)heap.size();
+		for (;;) {
+			uint first = pos * HEAP_ARITY + 1;
+			if (first >= size) break;
+			uint last = min(first + HEAP_ARITY, size);
+			uint best = first;
+			for (uint child = first + 1; child < last; child++) {
+				if (heap[child].estimate < heap[best].estimate) best = child;
+			}
+			if (!(heap[best].estimate < entry.estimate)) break;
+			this->HeapSet(pos, heap[best]);
+			pos = best;
+		}
+		this->HeapSet(pos, entry);
+	}
+
+	/** Remove the entry at a position of the heap. */
+	inline void HeapRemove(uint pos)
+	{
+		std::vector<HeapEntry> &heap = this->m->heap;
+		HeapEntry last = heap.back();
+		heap.pop_back();
+		if (pos == heap.size()) return;
+
+		if (pos > 0 && last.estimate < heap[(pos - 1) / HEAP_ARITY].estimate) {
+			this->HeapSiftUp(pos, last);
+		} else {
+			this->HeapSiftDown(pos, last);
+		}
+	}
+
+public:
+	/** default constructor */
+	CNodeList_ArenaT() : m_num_nodes(0), m_num_keys(0), m_hash_bits(max(Thash_bits_open_, Thash_bits_closed_)), m_open_count(0), m_closed_count(0), m_new_node(INVALID_INDEX)
+	{
+		{
+			std::unique_lock<std::mutex> lock;
+			StoragePool &pool = GetPool(lock);
+			if (pool.empty()) {
+				this->m = new Storage();
+			} else {
+				this->m = pool.back().release();
+				pool.pop_back();
+			}
+		}
+		this->m->slots.assign((size_t)1 << this->m_hash_bits, INVALID_INDEX);
+	}
+
+	/** destructor; hands the memory to the next node list */
+	~CNodeList_ArenaT()
+	{
+		while (this->m->blocks.size() > MAX_KEPT_BLOCKS) {
+			free(this->m->blocks.back());
+			this->m->blocks.pop_back();
+		}
+		this->m->heap_pos.clear();
+		this->m->heap.clear();
+
+		std::unique_lock<std::mutex> lock;
+		StoragePool &pool = GetPool(lock);
+		if (pool.size() < MAX_KEPT_STORAGES) {
+			pool.emplace_back(this->m);
+		} else {
+			delete this->m;
+		}
+	}
+
+	/** return number of open nodes */
+	inline int OpenCount()
+	{
+		return this->m_open_count;
+	}
+
+	/** return number of closed nodes */
+	inline int ClosedCount()
+	{
+		return this->m_closed_count;
+	}
+
+	/** allocate new data item from the arena */
+	inline Titem_ *CreateNewNode()
+	{
+		if (this->m_new_node == INVALID_INDEX) {
+			assert(this->m_num_nodes < INVALID_INDEX - 1);
+			if ((this->m_num_nodes >> BLOCK_BITS) == this->m->blocks.size()) this->m->blocks.push_back(MallocT<Titem_>(1 << BLOCK_BITS));
+			this->m_new_node = this->m_num_nodes++;
+			this->m->heap_pos.push_back(NOT_OPEN);
+			new (this->GetNode(this->m_new_node)) Titem_();
+		}
+		return this->GetNode(this->m_new_node);
+	}
+
+	/** Notify the nodelist that we don't want to discard the given node. */
+	inline void FoundBestNode(Titem_ &item)
+	{
+		if (this->m_new_node != INVALID_INDEX && &item == this->GetNode(this->m_new_node)) {
+			this->m_new_node = INVALID_INDEX;
+		}
+	}
+
+	/** insert given item as open node */
+	inline void InsertOpenNode(Titem_ &item)
+	{
+		if ((this->m_num_keys + 1) * 2 > (1U << this->m_hash_bits)) this->GrowHashTable();
+
+		uint pos = this->FindSlot(item.GetKey());
+		uint32 index = this->m->slots[pos];
+		if (this->m_new_node != INVALID_INDEX && &item == this->GetNode(this->m_new_node)) {
+			/* A new node, possibly replacing a node that is neither open nor closed anymore. */
+			assert(index == INVALID_INDEX || this->m->heap_pos[index] == NOT_OPEN);
+			if (index == INVALID_INDEX) this->m_num_keys++;
+			index = this->m_new_node;
+			this->m_new_node = INVALID_INDEX;
+			this->m->slots[pos] = index;
+		} else {
+			/* An existing node that was popped from the open list before. */
+			assert(index != INVALID_INDEX && &item == this->GetNode(index) && this->m->heap_pos[index] == NOT_OPEN);
+		}
+
+		this->m->heap.emplace_back();
+		this->HeapSiftUp((uint)this->m->heap.size() - 1, { item.GetCostEstimate(), index });
+		this->m_open_count++;
+	}
+
+	/** return the best open node */
+	inline Titem_ *GetBestOpenNode()
+	{
+		if (this->m->heap.empty()) return nullptr;
+		return this->GetNode(this->m->heap.front().index);
+	}
+
+	/** remove and return the best open node */
+	inline Titem_ *PopBestOpenNode()
+	{
+		if (this->m->heap.empty()) return nullptr;
+
+		uint32 index = this->m->heap.front().index;
+		this->HeapRemove(0);
+		this->m->heap_pos[index] = NOT_OPEN;
+		this->m_open_count--;
+		return this->GetNode(index);
+	}
+
+	/** return the open node specified by a key or nullptr if not found */
+	inline Titem_ *FindOpenNode(const Key &key)
+	{
+		uint32 index = this->m->slots[this->FindSlot(key)];
+		if (index == INVALID_INDEX || this->m->heap_pos[index] >= CLOSED) return nullptr;
+		return this->GetNode(index);
+	}
+
+	/** remove and return the open node specified by a key */
+	inline Titem_& PopOpenNode(const Key &key)
+	{
+		uint32 index = this->m->slots[this->FindSlot(key)];
+		assert(index != INVALID_INDEX && this->m->heap_pos[index] < CLOSED);
+		this->HeapRemove(this->m->heap_pos[index]);
+		this->m->heap_pos[index] = NOT_OPEN;
+		this->m_open_count--;
+		return *this->GetNode(index);
+	}
+
+	/** close node */
+	inline void InsertClosedNode(Titem_ &item)
+	{
+		uint32 index = this->m->slots[this->FindSlot(item.GetKey())];
+		assert(index != INVALID_INDEX && &item == this->GetNode(index) && this->m->heap_pos[index] == NOT_OPEN);
+		this->m->heap_pos[index] = CLOSED;
+		this->m_closed_count++;
+	}
+
+	/** return the closed node specified by a key or nullptr if not found */
+	inline Titem_ *FindClosedNode(const Key &key)
+	{
+		uint32 index = this->m->slots[this->FindSlot(key)];
+		if (index == INVALID_INDEX || this->m->heap_pos[index] != CLOSED) return nullptr;
+		return this->GetNode(index);
+	}
+
+	/** The number of items. */
+	inline int TotalCount()
+	{
+		return this->m_num_nodes;
+	}
+
+	/** Get a particular item. */
+	inline Titem_& ItemAt(int idx)
+	{
+		return *this->GetNode(idx);
+	}
+
+	/** Helper for creating output of this array. */
+	template <class D> void Dump(D &dmp) const
+	{
+		dmp.WriteLine("num_items = %d", this->m_num_nodes);
+		CStrA name;
+		for (uint32 i = 0; i < this->m_num_nodes; i++) {
+			name.Format("item[%d]", i);
+			dmp.WriteStructT(name.Data(), this->GetNode(i));
+		}
+	}
+};
+
+template <class Titem_, int Thash_bits_open_, int Thash_bits_closed_> const uint32 CNodeList_ArenaT<Titem_, Thash_bits_open_, Thash_bits_closed_>::INVALID_INDEX;
+template <class Titem_, int Thash_bits_open_, int Thash_bits_closed_> const uint32 CNodeList_ArenaT<Titem_, Thash_bits_open_, Thash_bits_closed_>::NOT_OPEN;
+
+#if YAPF_NODELIST_HASHTABLE
+/** Node list used by the YAPF pathfinders. */
+template <class Titem_, int Thash_bits_open_, int Thash_bits_closed_>
+using CYapfNodeListT = CNodeList_HashTableT<Titem_, Thash_bits_open_, Thash_bits_closed_>;
+#else
+/** Node list used by the YAPF pathfinders. */
+template <class Titem_, int Thash_bits_open_, int Thash_bits_closed_>
+using CYapfNodeListT = CNodeList_ArenaT<Titem_, Thash_bits_open_, Thash_bits_closed_>;
+#endif /* YAPF_NODELIST_HASHTABLE */
+
 #endif /* NODELIST_HPP */
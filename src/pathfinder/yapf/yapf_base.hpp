@@ -12,8 +12,12 @@
 
 #include "../../debug.h"
 #include "../../settings_type.h"
+#include "../pf_benchmark.h"
 
-extern int _total_pf_time_us;
+#include <atomic>
+
+extern std::atomic<int> _total_pf_time_us;
+extern std::atomic<int> _total_pf_nodes;
 
 /**
  * CYapfBaseT - A-star type path finder base class.
@@ -149,11 +153,13 @@ public:
 		}
 
 		bDestFound &= (m_pBestDestNode != nullptr);
+		_pf_closed_nodes += m_nodes.ClosedCount();
 
 		perf.Stop();
 		if (_debug_yapf_level >= 2) {
 			int t = perf.Get(1000000);
 			_total_pf_time_us += t;
+			_total_pf_nodes += m_nodes.ClosedCount();
 
 			if (_debug_yapf_level >= 3) {
 				UnitID veh_idx = (m_veh != nullptr) ? m_veh->unitnumber : 0;
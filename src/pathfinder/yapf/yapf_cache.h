@@ -19,4 +19,21 @@
  */
 void YapfNotifyTrackLayoutChange(TileIndex tile, Track track);
 
+/**
+ * Use this function to notify YAPF that a tile ships may pass has been built or removed.
+ * @param tile the tile that is changed, or INVALID_TILE when anything might have changed
+ */
+void YapfNotifyWaterLayoutChange(TileIndex tile);
+
+/** Statistics of the global cache of rail segment costs. */
+struct YapfCacheStats {
+	uint64 hits;      ///< Number of segments whose cost was found in the cache.
+	uint64 misses;    ///< Number of segments whose cost had to be calculated.
+	uint64 evictions; ///< Number of segments dropped because one of their tiles changed.
+	uint64 flushes;   ///< Number of times the whole cache was dropped.
+};
+
+YapfCacheStats YapfGetCacheStats(uint *segments);
+void YapfResetCacheStats();
+
 #endif /* YAPF_CACHE_H */
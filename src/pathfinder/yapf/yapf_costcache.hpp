@@ -11,6 +11,10 @@
 #define YAPF_COSTCACHE_HPP
 
 #include "../../date_func.h"
+#include "yapf_cache.h"
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
 
 /**
  * CYapfSegmentCostCacheNoneT - the formal only yapf cost cache provider that implements
@@ -87,6 +91,14 @@ public:
 	inline void PfNodeCacheFlush(Node &n)
 	{
 	}
+
+	/**
+	 * Called by the cost calculation with the tiles a freshly calculated segment covers.
+	 *  Local segments are never reused, so there is nothing to remember.
+	 */
+	inline void PfNodeCacheIndexTiles(Node &n, const std::vector<TileIndex> &tiles)
+	{
+	}
 };
 
 
@@ -95,15 +107,37 @@ public:
  *  of track layout changes and static notification function called whenever
  *  the track layout changes. It is implemented as base class because it needs
  *  to be shared between all rail YAPF types (one shared counter, one notification
- *  function.
+ *  function, one list of caches to tell about changed tiles).
  */
 struct CSegmentCostCacheBase
 {
 	static int   s_rail_change_counter;
+	static std::vector<CSegmentCostCacheBase *> s_caches; ///< All global segment cost caches.
+	static YapfCacheStats s_stats;                        ///< Statistics of all global segment cost caches.
+
+	virtual ~CSegmentCostCacheBase() {}
+
+	/**
+	 * Drop all cached segments that might depend on the given tile.
+	 * @param tile The tile that changed.
+	 */
+	virtual void InvalidateTile(TileIndex tile) = 0;
+
+	/**
+	 * Get the number of segments in this cache.
+	 * @return The number of segments.
+	 */
+	virtual uint GetNumSegments() const = 0;
 
 	static void NotifyTrackLayoutChange(TileIndex tile, Track track)
 	{
-		s_rail_change_counter++;
+		if (tile == INVALID_TILE) {
+			/* Everything might have changed. */
+			s_rail_change_counter++;
+			return;
+		}
+
+		for (CSegmentCostCacheBase *cache : s_caches) cache->InvalidateTile(tile);
 	}
 };
 
@@ -121,21 +155,104 @@ struct CSegmentCostCacheBase
 template <class Tsegment>
 struct CSegmentCostCacheT : public CSegmentCostCacheBase {
 	static const int C_HASH_BITS = 14;
+	static const uint C_BLOCK_BITS = 3;     ///< The tile index keeps track of blocks of (1 << C_BLOCK_BITS) by (1 << C_BLOCK_BITS) tiles.
+	static const int C_MIN_DROPPED = 4096;  ///< Minimum number of dropped segments before their storage is reclaimed.
 
 	typedef CHashTableT<Tsegment, C_HASH_BITS> HashTable;
 	typedef SmallArray<Tsegment> Heap;
 	typedef typename Tsegment::Key Key;    ///< key to hash table
+	typedef std::unordered_map<TileIndex, std::vector<Tsegment *>> TileIndexMap;
 
 	HashTable    m_map;
 	Heap         m_heap;
+	TileIndexMap m_tile_index;  ///< The segments that cover a tile of a block, by the first tile of the block.
+	int          m_num_dropped; ///< Number of segments in the heap that are not in the map anymore.
+
+	inline CSegmentCostCacheT() : m_num_dropped(0)
+	{
+		s_caches.push_back(this);
+	}
 
-	inline CSegmentCostCacheT() {}
+	~CSegmentCostCacheT()
+	{
+		s_caches.erase(std::find(s_caches.begin(), s_caches.end(), this));
+	}
 
 	/** flush (clear) the cache */
 	inline void Flush()
 	{
 		m_map.Clear();
 		m_heap.Clear();
+		m_tile_index.clear();
+		m_num_dropped = 0;
+		s_stats.flushes++;
+	}
+
+	/**
+	 * Get the first tile of the block of the tile index the given tile belongs to.
+	 * @param x The X coordinate of the tile.
+	 * @param y The Y coordinate of the tile.
+	 * @return The first tile of the block.
+	 */
+	static inline TileIndex GetBlock(uint x, uint y)
+	{
+		return TileXY(x >> C_BLOCK_BITS << C_BLOCK_BITS, y >> C_BLOCK_BITS << C_BLOCK_BITS);
+	}
+
+	/**
+	 * Remember which tiles are covered by a segment, so it can be dropped once any of them changes.
+	 * @param segment The segment.
+	 * @param tiles The tiles the segment covers.
+	 */
+	void IndexTiles(Tsegment &segment, const std::vector<TileIndex> &tiles)
+	{
+		TileIndex last_block = INVALID_TILE;
+		for (TileIndex tile : tiles) {
+			TileIndex block = GetBlock(TileX(tile), TileY(tile));
+			if (block == last_block) continue;
+			last_block = block;
+			m_tile_index[block].push_back(&segment);
+		}
+	}
+
+	void InvalidateTile(TileIndex tile) override
+	{
+		/* A segment also depends on the tile just past its end, so the neighbours of the tile are affected too. */
+		uint x = TileX(tile);
+		uint y = TileY(tile);
+		TileIndex first = GetBlock(max(x, 1U) - 1, max(y, 1U) - 1);
+		TileIndex last = GetBlock(min(x + 1, MapMaxX()), min(y + 1, MapMaxY()));
+
+		for (uint by = TileY(first); by <= TileY(last); by += 1 << C_BLOCK_BITS) {
+			for (uint bx = TileX(first); bx <= TileX(last); bx += 1 << C_BLOCK_BITS) {
+				auto it = m_tile_index.find(TileXY(bx, by));
+				if (it == m_tile_index.end()) continue;
+
+				for (Tsegment *segment : it->second) {
+					/* The segment might have been dropped via another block already. */
+					if (m_map.Find(segment->GetKey()) != segment) continue;
+					m_map.Pop(*segment);
+					m_num_dropped++;
+					s_stats.evictions++;
+				}
+				m_tile_index.erase(it);
+			}
+		}
+	}
+
+	/**
+	 * Dropped segments stay in the heap, as nodes of a running pathfinder might still point to them.
+	 * Check whether they take so much of it that starting over is better.
+	 * @return True iff the cache should be flushed.
+	 */
+	inline bool HasManyDropped() const
+	{
+		return m_num_dropped > C_MIN_DROPPED && m_num_dropped > m_map.Count();
+	}
+
+	uint GetNumSegments() const override
+	{
+		return m_map.Count();
 	}
 
 	inline Tsegment& Get(Key &key, bool *found)
@@ -188,14 +305,17 @@ protected:
 		/* some statistics */
 		if (last_date != _date) {
 			last_date = _date;
-			DEBUG(yapf, 2, "Pf time today: %5d ms", _total_pf_time_us / 1000);
-			_total_pf_time_us = 0;
+			int time_us = _total_pf_time_us.exchange(0);
+			int nodes = _total_pf_nodes.exchange(0);
+			DEBUG(yapf, 2, "Pf time today: %5d ms - %d nodes closed - %d nodes/ms", time_us / 1000, nodes, time_us < 1000 ? 0 : nodes / (time_us / 1000));
 		}
 
 		/* delete the cache sometimes... */
 		if (last_rail_change_counter != Cache::s_rail_change_counter) {
 			last_rail_change_counter = Cache::s_rail_change_counter;
 			C.Flush();
+		} else if (C.HasManyDropped()) {
+			C.Flush();
 		}
 		return C;
 	}
@@ -214,6 +334,11 @@ public:
 		bool found;
 		CachedData &item = m_global_cache.Get(key, &found);
 		Yapf().ConnectNodeToCachedData(n, item);
+		if (found) {
+			Cache::s_stats.hits++;
+		} else {
+			Cache::s_stats.misses++;
+		}
 		return found;
 	}
 
@@ -224,6 +349,15 @@ public:
 	inline void PfNodeCacheFlush(Node &n)
 	{
 	}
+
+	/**
+	 * Called by the cost calculation with the tiles a freshly calculated segment covers.
+	 *  A change to any of them (or their neighbours) drops the segment from the global cache.
+	 */
+	inline void PfNodeCacheIndexTiles(Node &n, const std::vector<TileIndex> &tiles)
+	{
+		if (Yapf().CanUseGlobalCache(n)) m_global_cache.IndexTiles(*n.m_segment, tiles);
+	}
 };
 
 #endif /* YAPF_COSTCACHE_HPP */
@@ -55,6 +55,7 @@ protected:
 	int           m_max_cost;
 	CBlobT<int>   m_sig_look_ahead_costs;
 	bool          m_disable_cache;
+	std::vector<TileIndex> m_segment_tiles; ///< Tiles covered by the segment whose cost is being calculated.
 
 public:
 	bool          m_stopped_on_first_two_way_signal;
@@ -62,7 +63,7 @@ protected:
 
 	static const int s_max_segment_cost = 10000;
 
-	CYapfCostRailT() : m_max_cost(0), m_disable_cache(false), m_stopped_on_first_two_way_signal(false)
+	CYapfCostRailT() : m_max_cost(0), m_disable_cache(_pf_benchmark_replaying), m_stopped_on_first_two_way_signal(false)
 	{
 		/* pre-compute look-ahead penalties into array */
 		int p0 = Yapf().PfGetSettings().rail_look_ahead_signal_p0;
@@ -323,6 +324,8 @@ public:
 
 		EndSegmentReasonBits end_segment_reason = ESRB_NONE;
 
+		m_segment_tiles.clear();
+
 		TrackFollower tf_local(v, Yapf().GetCompatibleRailTypes(), &Yapf().m_perf_ts_cost);
 
 		if (!has_parent) {
@@ -371,6 +374,15 @@ public:
 
 no_entry_cost: // jump here at the beginning if the node has no parent (it is the first node)
 
+			m_segment_tiles.push_back(cur.tile);
+			if (tf->m_tiles_skipped > 0) {
+				/* The skipped platform, tunnel and bridge tiles are part of the segment as well. */
+				TileIndexDiff diff = TileOffsByDiagDir(tf->m_exitdir);
+				for (TileIndex tile = cur.tile - diff * tf->m_tiles_skipped; tile != cur.tile; tile += diff) {
+					m_segment_tiles.push_back(tile);
+				}
+			}
+
 			/* All other tile costs will be calculated here. */
 			segment_cost += Yapf().OneTileCost(cur.tile, cur.td);
 
@@ -571,6 +583,8 @@ no_entry_cost: // jump here at the beginning if the node has no parent (it is th
 			segment.m_end_segment_reason = end_segment_reason & ESRB_CACHED_MASK;
 			/* Save end of segment back to the node. */
 			n.SetLastTileTrackdir(cur.tile, cur.td);
+			/* Let the cache know when the segment has to be calculated again. */
+			Yapf().PfNodeCacheIndexTiles(n, m_segment_tiles);
 		}
 
 		/* Do we have an excuse why not to continue pathfinding in this direction? */
@@ -118,6 +118,7 @@ protected:
 	TileIndex    m_destTile;
 	TrackdirBits m_destTrackdirs;
 	StationID    m_dest_station_id;
+	const YapfCorridor *m_corridor; ///< Regions the search is restricted to, or \c nullptr for no restriction.
 
 	/** to access inherited path finder */
 	Tpf& Yapf()
@@ -126,6 +127,8 @@ protected:
 	}
 
 public:
+	CYapfDestinationTileOrStationRailT() : m_corridor(nullptr) {}
+
 	void SetDestination(const Train *v)
 	{
 		switch (v->current_order.GetType()) {
@@ -155,6 +158,19 @@ public:
 		CYapfDestinationRailBase::SetDestination(v);
 	}
 
+	/**
+	 * Restrict the search to the regions along the path over the abstract rail region graph.
+	 * @param corridor The corridor to find and restrict the search to.
+	 * @param origin The tile the search starts at.
+	 * @return True iff the search has been restricted.
+	 */
+	bool SetCorridor(YapfCorridor *corridor, TileIndex origin)
+	{
+		if (!corridor->Find(TRANSPORT_RAIL, origin, m_destTile)) return false;
+		m_corridor = corridor;
+		return true;
+	}
+
 	/** Called by YAPF to detect if node ends in the desired destination */
 	inline bool PfDetectDestination(Node &n)
 	{
@@ -187,6 +203,9 @@ public:
 		}
 
 		TileIndex tile = n.GetLastTile();
+		/* Outside of the corridor there is nothing to be found. */
+		if (m_corridor != nullptr && !m_corridor->Contains(tile)) return false;
+
 		DiagDirection exitdir = TrackdirToExitdir(n.GetLastTrackdir());
 		int x1 = 2 * TileX(tile) + dg_dir_to_x_offs[(int)exitdir];
 		int y1 = 2 * TileY(tile) + dg_dir_to_y_offs[(int)exitdir];
@@ -31,7 +31,7 @@ typedef CYapfShipNodeT<CYapfNodeKeyExitDir>  CYapfShipNodeExitDir;
 typedef CYapfShipNodeT<CYapfNodeKeyTrackDir> CYapfShipNodeTrackDir;
 
 /* Default NodeList types */
-typedef CNodeList_HashTableT<CYapfShipNodeExitDir , 10, 12> CShipNodeListExitDir;
-typedef CNodeList_HashTableT<CYapfShipNodeTrackDir, 10, 12> CShipNodeListTrackDir;
+typedef CYapfNodeListT<CYapfShipNodeExitDir , 10, 12> CShipNodeListExitDir;
+typedef CYapfNodeListT<CYapfShipNodeTrackDir, 10, 12> CShipNodeListTrackDir;
 
 #endif /* YAPF_NODE_SHIP_HPP */
@@ -13,6 +13,7 @@
 #include "yapf_cache.h"
 #include "yapf_node_rail.hpp"
 #include "yapf_costrail.hpp"
+#include "yapf_regions.h"
 #include "yapf_destrail.hpp"
 #include "../../viewport_func.h"
 #include "../../newgrf_station.h"
@@ -34,7 +35,8 @@ template <typename Tpf> void DumpState(Tpf &pf1, Tpf &pf2)
 	fclose(f2);
 }
 
-int _total_pf_time_us = 0;
+std::atomic<int> _total_pf_time_us(0);
+std::atomic<int> _total_pf_nodes(0);
 
 template <class Types>
 class CYapfReserveTrack
@@ -108,6 +110,22 @@ private:
 		return tile != m_res_dest || td != m_res_dest_td;
 	}
 
+	/** Drop the cached segments covering a reserved track/platform. */
+	bool InvalidateSingleTrack(TileIndex tile, Trackdir td)
+	{
+		if (IsRailStationTile(tile)) {
+			TileIndex     t = tile;
+			TileIndexDiff diff = TileOffsByDiagDir(TrackdirToExitdir(ReverseTrackdir(td)));
+			do {
+				CSegmentCostCacheBase::NotifyTrackLayoutChange(t, TrackdirToTrack(td));
+				t = TILE_ADD(t, diff);
+			} while (IsCompatibleTrainStationTile(t, tile) && t != m_origin_tile);
+		} else {
+			CSegmentCostCacheBase::NotifyTrackLayoutChange(tile, TrackdirToTrack(td));
+		}
+		return tile != m_res_dest || td != m_res_dest_td;
+	}
+
 	/** Unreserve a single track/platform. Stops when the previous failer is reached. */
 	bool UnreserveSingleTrack(TileIndex tile, Trackdir td)
 	{
@@ -180,7 +198,10 @@ public:
 		if (target != nullptr) target->okay = true;
 
 		if (Yapf().CanUseGlobalCache(*m_res_node)) {
-			YapfNotifyTrackLayoutChange(INVALID_TILE, INVALID_TRACK);
+			/* The reservation costs of the segments along the path changed. */
+			for (Node *node = m_res_node; node->m_parent != nullptr; node = node->m_parent) {
+				node->IterateTiles(Yapf().GetVehicle(), Yapf(), *this, &CYapfReserveTrack<Types>::InvalidateSingleTrack);
+			}
 		}
 
 		return true;
@@ -399,6 +420,14 @@ public:
 
 	static Trackdir stChooseRailTrack(const Train *v, TileIndex tile, DiagDirection enterdir, TrackBits tracks, bool &path_found, bool reserve_track, PBSTileInfo *target)
 	{
+		if (_settings_game.pf.yapf.rail_hierarchical) {
+			/* Only refine the path over the abstract graph first; search everywhere when that fails. */
+			YapfCorridor corridor;
+			Tpf pf;
+			Trackdir result = pf.ChooseRailTrack(v, tile, enterdir, tracks, path_found, reserve_track, target, &corridor);
+			if (path_found) return result;
+		}
+
 		/* create pathfinder instance */
 		Tpf pf1;
 		Trackdir result1;
@@ -419,7 +448,7 @@ public:
 		return result1;
 	}
 
-	inline Trackdir ChooseRailTrack(const Train *v, TileIndex tile, DiagDirection enterdir, TrackBits tracks, bool &path_found, bool reserve_track, PBSTileInfo *target)
+	inline Trackdir ChooseRailTrack(const Train *v, TileIndex tile, DiagDirection enterdir, TrackBits tracks, bool &path_found, bool reserve_track, PBSTileInfo *target, YapfCorridor *corridor = nullptr)
 	{
 		if (target != nullptr) target->tile = INVALID_TILE;
 
@@ -427,6 +456,10 @@ public:
 		PBSTileInfo origin = FollowTrainReservation(v);
 		Yapf().SetOrigin(origin.tile, origin.trackdir, INVALID_TILE, INVALID_TRACKDIR, 1, true);
 		Yapf().SetDestination(v);
+		if (corridor != nullptr && !Yapf().SetCorridor(corridor, origin.tile)) {
+			path_found = false;
+			return INVALID_TRACKDIR;
+		}
 
 		/* find the best path */
 		path_found = Yapf().FindPath(v);
@@ -636,10 +669,31 @@ bool YapfTrainFindNearestSafeTile(const Train *v, TileIndex tile, Trackdir td, b
 	return pfnFindNearestSafeTile(v, tile, td, override_railtype);
 }
 
-/** if any track changes, this counter is incremented - that will invalidate segment cost cache */
+/** if all tracks might have changed, this counter is incremented - that will invalidate segment cost cache */
 int CSegmentCostCacheBase::s_rail_change_counter = 0;
+std::vector<CSegmentCostCacheBase *> CSegmentCostCacheBase::s_caches;
+YapfCacheStats CSegmentCostCacheBase::s_stats = {};
 
 void YapfNotifyTrackLayoutChange(TileIndex tile, Track track)
 {
 	CSegmentCostCacheBase::NotifyTrackLayoutChange(tile, track);
+	YapfRegionsNotifyChange(TRANSPORT_RAIL, tile);
+}
+
+/**
+ * Get the statistics of the global cache of rail segment costs.
+ * @param[out] segments The number of segments that are cached right now.
+ * @return The statistics since the last reset.
+ */
+YapfCacheStats YapfGetCacheStats(uint *segments)
+{
+	*segments = 0;
+	for (const CSegmentCostCacheBase *cache : CSegmentCostCacheBase::s_caches) *segments += cache->GetNumSegments();
+	return CSegmentCostCacheBase::s_stats;
+}
+
+/** Reset the statistics of the global cache of rail segment costs. */
+void YapfResetCacheStats()
+{
+	CSegmentCostCacheBase::s_stats = {};
 }
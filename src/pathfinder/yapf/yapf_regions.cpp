@@ -0,0 +1,385 @@
+/*
+ * This file is part of OpenTTD.
+ * OpenTTD is free software; you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 2.
+ * OpenTTD is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details. You should have received a copy of the GNU General Public License along with OpenTTD. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file yapf_regions.cpp Abstract graphs of the rail and water networks, used to guide long distance searches. */
+
+#include "../../stdafx.h"
+
+#include "yapf.hpp"
+#include "yapf_regions.h"
+#include "../../tilearea_type.h"
+
+#include <algorithm>
+#include <mutex>
+#include <queue>
+#include <unordered_map>
+
+#include "../../safeguards.h"
+
+static const uint16 INVALID_REGION_COMPONENT = UINT16_MAX; ///< Component of tiles without track.
+static const uint32 INVALID_REGION_NODE = UINT32_MAX;      ///< Node of tiles without track.
+static const uint MIN_CORRIDOR_DISTANCE = 4 * YAPF_REGION_SIZE; ///< Shorter searches are not worth going over the abstract graph.
+static const uint MAX_ABSTRACT_NODES = 65536; ///< Maximum number of nodes the search over the abstract graph may visit.
+
+/** A connection from a component of a region to a tile in another region. */
+struct RegionPortal {
+	uint16 component; ///< The component the connection starts at.
+	TileIndex to;     ///< The tile in the other region the connection leads to.
+
+	bool operator <(const RegionPortal &other) const
+	{
+		return this->component < other.component || (this->component == other.component && this->to < other.to);
+	}
+
+	bool operator ==(const RegionPortal &other) const
+	{
+		return this->component == other.component && this->to == other.to;
+	}
+};
+
+/**
+ * The network within one region. The tiles are grouped into components of
+ * tiles that are connected by track without leaving the region. The components
+ * are the nodes of the abstract graph, the portals its edges.
+ * Signals and 90 degree turn restrictions are ignored, so the abstract graph
+ * is connected at least as well as the real network.
+ */
+struct Region {
+	bool dirty;                        ///< Whether the region has to be calculated again before use.
+	std::vector<uint16> components;    ///< Component of every tile of the region; empty when there is no track at all.
+	std::vector<RegionPortal> portals; ///< Connections to other regions, sorted by component.
+
+	Region() : dirty(true) {}
+};
+
+/** All regions of the map for one transport type. */
+struct RegionGraph {
+	std::vector<Region> regions; ///< The regions.
+	std::mutex lock;             ///< Lock for searches; ship searches may run on several threads at once.
+};
+
+static RegionGraph _region_graphs[TRANSPORT_WATER + 1]; ///< The regions of every transport type; road is unused.
+
+/**
+ * Get the regions of a transport type.
+ * @param type The transport type.
+ * @return The regions.
+ */
+static inline RegionGraph &GetRegionGraph(TransportType type)
+{
+	assert(type == TRANSPORT_RAIL || type == TRANSPORT_WATER);
+	return _region_graphs[type];
+}
+
+/**
+ * Get the index of a tile within its region.
+ * @param tile The tile.
+ * @return The index within the region.
+ */
+static inline uint GetRegionLocalIndex(TileIndex tile)
+{
+	return ((TileY(tile) & (YAPF_REGION_SIZE - 1)) << YAPF_REGION_BITS) | (TileX(tile) & (YAPF_REGION_SIZE - 1));
+}
+
+/**
+ * Get the distance between two regions, in tiles.
+ * @param a The first region.
+ * @param b The second region.
+ * @return The Manhattan distance between the regions.
+ */
+static inline uint GetRegionDistance(uint a, uint b)
+{
+	uint regions_x = MapSizeX() >> YAPF_REGION_BITS;
+	return (Delta(a % regions_x, b % regions_x) + Delta(a / regions_x, b / regions_x)) * YAPF_REGION_SIZE;
+}
+
+/**
+ * Make sure there is a region for every part of the current map.
+ * @param graph The regions.
+ */
+static void AllocateRegions(RegionGraph &graph)
+{
+	size_t count = MapSize() >> (2 * YAPF_REGION_BITS);
+	if (graph.regions.size() != count) graph.regions.assign(count, Region());
+}
+
+/**
+ * Find the representative of a set of joined tiles.
+ * @param parent The parent of every tile.
+ * @param i The tile to find the representative of.
+ * @return The representative.
+ */
+static uint16 FindRegionRoot(std::vector<uint16> &parent, uint16 i)
+{
+	while (parent[i] != i) {
+		parent[i] = parent[parent[i]];
+		i = parent[i];
+	}
+	return i;
+}
+
+/**
+ * Follow a track to the next tile.
+ * @param type The transport type.
+ * @param tile The tile to start at.
+ * @param td The trackdir to follow.
+ * @return The tile the track leads to, or #INVALID_TILE when it cannot be followed.
+ */
+static TileIndex FollowRegionTrack(TransportType type, TileIndex tile, Trackdir td)
+{
+	if (type == TRANSPORT_RAIL) {
+		CFollowTrackRail ft(GetTileOwner(tile), GetRailTypeInfo(GetTileRailType(tile))->compatible_railtypes);
+		return ft.Follow(tile, td) ? ft.m_new_tile : INVALID_TILE;
+	}
+
+	CFollowTrackWater ft;
+	return ft.Follow(tile, td) ? ft.m_new_tile : INVALID_TILE;
+}
+
+/**
+ * Calculate the components and portals of a region.
+ * @param type The transport type.
+ * @param index The index of the region.
+ * @param region The region.
+ */
+static void UpdateRegion(TransportType type, uint index, Region &region)
+{
+	region.dirty = false;
+	region.components.clear();
+	region.portals.clear();
+
+	TileArea area(GetYapfRegionTile(index), YAPF_REGION_SIZE, YAPF_REGION_SIZE);
+
+	std::vector<uint16> parent(YAPF_REGION_SIZE * YAPF_REGION_SIZE, INVALID_REGION_COMPONENT);
+	std::vector<std::pair<uint16, TileIndex>> exits;
+	bool has_track = false;
+
+	TILE_AREA_LOOP(tile, area) {
+		TrackdirBits trackdirs = TrackStatusToTrackdirBits(GetTileTrackStatus(tile, type, 0));
+		if (trackdirs == TRACKDIR_BIT_NONE) continue;
+
+		has_track = true;
+		uint16 local = GetRegionLocalIndex(tile);
+		if (parent[local] == INVALID_REGION_COMPONENT) parent[local] = local;
+
+		while (trackdirs != TRACKDIR_BIT_NONE) {
+			Trackdir td = (Trackdir)FindFirstBit2x64(trackdirs);
+			trackdirs = KillFirstBit(trackdirs);
+			TileIndex next = FollowRegionTrack(type, tile, td);
+			if (next == INVALID_TILE) continue;
+
+			if (GetYapfRegionIndex(next) != index) {
+				exits.emplace_back(local, next);
+				continue;
+			}
+
+			uint16 other = GetRegionLocalIndex(next);
+			if (parent[other] == INVALID_REGION_COMPONENT) parent[other] = other;
+			parent[FindRegionRoot(parent, local)] = FindRegionRoot(parent, other);
+		}
+	}
+
+	if (!has_track) return;
+
+	/* Number the components consecutively. */
+	std::vector<uint16> ids(parent.size(), INVALID_REGION_COMPONENT);
+	uint16 num_components = 0;
+	region.components.assign(parent.size(), INVALID_REGION_COMPONENT);
+	for (uint16 i = 0; i < parent.size(); i++) {
+		if (parent[i] == INVALID_REGION_COMPONENT) continue;
+		uint16 root = FindRegionRoot(parent, i);
+		if (ids[root] == INVALID_REGION_COMPONENT) ids[root] = num_components++;
+		region.components[i] = ids[root];
+	}
+
+	for (const auto &exit : exits) region.portals.push_back({ region.components[exit.first], exit.second });
+	std::sort(region.portals.begin(), region.portals.end());
+	region.portals.erase(std::unique(region.portals.begin(), region.portals.end()), region.portals.end());
+}
+
+/**
+ * Get an up to date region.
+ * @param type The transport type.
+ * @param graph The regions of the transport type.
+ * @param index The index of the region.
+ * @return The region.
+ */
+static const Region &GetRegion(TransportType type, RegionGraph &graph, uint index)
+{
+	Region &region = graph.regions[index];
+	if (region.dirty) UpdateRegion(type, index, region);
+	return region;
+}
+
+/**
+ * Get the node of the abstract graph a tile belongs to.
+ * @param type The transport type.
+ * @param graph The regions of the transport type.
+ * @param tile The tile.
+ * @return The node, or #INVALID_REGION_NODE when there is no track on the tile.
+ */
+static uint32 GetRegionNode(TransportType type, RegionGraph &graph, TileIndex tile)
+{
+	uint index = GetYapfRegionIndex(tile);
+	const Region &region = GetRegion(type, graph, index);
+	if (region.components.empty()) return INVALID_REGION_NODE;
+
+	uint16 component = region.components[GetRegionLocalIndex(tile)];
+	if (component == INVALID_REGION_COMPONENT) return INVALID_REGION_NODE;
+	return index << 16 | component;
+}
+
+/**
+ * Search the abstract graph for the regions between two tiles.
+ * @param type The transport type of the network.
+ * @param origin The tile the path starts at.
+ * @param dest The tile the path has to end at. When it has no track itself,
+ *             like the land part of a dock, the track next to it is used.
+ * @param max_length The maximum number of regions along the path the corridor may cover.
+ * @return True iff a path was found and the corridor has been set up;
+ *         false when the tiles are not connected or are too close together to bother.
+ */
+bool YapfCorridor::Find(TransportType type, TileIndex origin, TileIndex dest, uint max_length)
+{
+	if (origin == INVALID_TILE || dest == INVALID_TILE || DistanceManhattan(origin, dest) < MIN_CORRIDOR_DISTANCE) return false;
+
+	RegionGraph &graph = GetRegionGraph(type);
+	std::lock_guard<std::mutex> lock(graph.lock);
+
+	AllocateRegions(graph);
+	uint32 start = GetRegionNode(type, graph, origin);
+	if (start == INVALID_REGION_NODE) return false;
+
+	std::vector<uint32> goals;
+	uint32 goal = GetRegionNode(type, graph, dest);
+	if (goal != INVALID_REGION_NODE) {
+		goals.push_back(goal);
+	} else {
+		for (DiagDirection dir = DIAGDIR_BEGIN; dir != DIAGDIR_END; dir++) {
+			TileIndex neighbour = TileAddByDiagDir(dest, dir);
+			if (!IsValidTile(neighbour)) continue;
+			goal = GetRegionNode(type, graph, neighbour);
+			if (goal != INVALID_REGION_NODE) goals.push_back(goal);
+		}
+		if (goals.empty()) return false;
+	}
+	uint goal_region = GetYapfRegionIndex(dest);
+
+	/** Cost to reach a node and the node it has been reached from. */
+	struct Visit {
+		uint cost;
+		uint32 parent;
+	};
+	typedef std::pair<uint, uint32> QueueItem; ///< Estimated cost of the whole path via a node, and the node.
+
+	std::unordered_map<uint32, Visit> visited;
+	std::priority_queue<QueueItem, std::vector<QueueItem>, std::greater<QueueItem>> open;
+	visited[start] = { 0, INVALID_REGION_NODE };
+	open.emplace(GetRegionDistance(start >> 16, goal_region), start);
+
+	uint32 found = INVALID_REGION_NODE;
+	while (!open.empty()) {
+		QueueItem item = open.top();
+		open.pop();
+
+		uint32 node = item.second;
+		uint index = node >> 16;
+		uint cost = visited[node].cost;
+		if (item.first != cost + GetRegionDistance(index, goal_region)) continue; // Reached cheaper in the meantime.
+		if (std::find(goals.begin(), goals.end(), node) != goals.end()) {
+			found = node;
+			break;
+		}
+		if (visited.size() > MAX_ABSTRACT_NODES) break;
+
+		const Region &region = GetRegion(type, graph, index);
+		RegionPortal first = { (uint16)(node & 0xFFFF), 0 };
+		for (auto it = std::lower_bound(region.portals.begin(), region.portals.end(), first); it != region.portals.end() && it->component == first.component; ++it) {
+			uint32 next = GetRegionNode(type, graph, it->to);
+			if (next == INVALID_REGION_NODE) continue;
+
+			uint next_cost = cost + GetRegionDistance(index, next >> 16);
+			auto v = visited.find(next);
+			if (v != visited.end() && v->second.cost <= next_cost) continue;
+
+			visited[next] = { next_cost, node };
+			open.emplace(next_cost + GetRegionDistance(next >> 16, goal_region), next);
+		}
+	}
+	if (found == INVALID_REGION_NODE) return false;
+
+	std::vector<uint> path;
+	for (uint32 node = found; node != INVALID_REGION_NODE; node = visited[node].parent) path.push_back(node >> 16);
+	std::reverse(path.begin(), path.end());
+	this->end_region = UINT_MAX;
+	if (path.size() > max_length) {
+		path.resize(max_length);
+		this->end_region = path.back();
+	}
+
+	/* The path is refined by the real search, give it some room around the abstract path. */
+	uint regions_x = MapSizeX() >> YAPF_REGION_BITS;
+	uint regions_y = MapSizeY() >> YAPF_REGION_BITS;
+	this->regions.assign(graph.regions.size(), false);
+	for (uint index : path) {
+		uint x = index % regions_x;
+		uint y = index / regions_x;
+		for (uint ny = max(y, 1U) - 1; ny <= min(y + 1, regions_y - 1); ny++) {
+			for (uint nx = max(x, 1U) - 1; nx <= min(x + 1, regions_x - 1); nx++) {
+				this->regions[ny * regions_x + nx] = true;
+			}
+		}
+	}
+	return true;
+}
+
+/**
+ * Mark the regions that depend on a tile as outdated.
+ * @param type The transport type of the network that changed.
+ * @param tile The tile that changed, or #INVALID_TILE when anything might have changed.
+ */
+void YapfRegionsNotifyChange(TransportType type, TileIndex tile)
+{
+	RegionGraph &graph = GetRegionGraph(type);
+	if (tile == INVALID_TILE) {
+		graph.regions.clear();
+		return;
+	}
+	if (graph.regions.size() != MapSize() >> (2 * YAPF_REGION_BITS)) return;
+
+	/* The portals of a region depend on the tiles just across its border too. */
+	graph.regions[GetYapfRegionIndex(tile)].dirty = true;
+	for (DiagDirection dir = DIAGDIR_BEGIN; dir != DIAGDIR_END; dir++) {
+		TileIndex neighbour = TileAddByDiagDir(tile, dir);
+		if (IsValidTile(neighbour)) graph.regions[GetYapfRegionIndex(neighbour)].dirty = true;
+	}
+}
+
+/**
+ * Check whether the up to date regions still match the network, i.e. whether
+ * no change to the map was missed. Mismatches are reported to the desync log.
+ */
+void YapfRegionsCheckCaches()
+{
+	static const TransportType types[] = { TRANSPORT_RAIL, TRANSPORT_WATER };
+	for (TransportType type : types) {
+		RegionGraph &graph = GetRegionGraph(type);
+		std::lock_guard<std::mutex> lock(graph.lock);
+
+		for (uint index = 0; index < graph.regions.size(); index++) {
+			const Region &region = graph.regions[index];
+			if (region.dirty) continue;
+
+			Region check;
+			UpdateRegion(type, index, check);
+			if (region.components != check.components || region.portals != check.portals) {
+				TileIndex tile = GetYapfRegionTile(index);
+				DEBUG(desync, 2, "yapf region mismatch: type %i, region %u (%u x %u)", (int)type, index, TileX(tile), TileY(tile));
+			}
+		}
+	}
+}
@@ -0,0 +1,88 @@
+/*
+ * This file is part of OpenTTD.
+ * OpenTTD is free software; you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 2.
+ * OpenTTD is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details. You should have received a copy of the GNU General Public License along with OpenTTD. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file yapf_regions.h Abstract graphs of the rail and water networks, used to guide long distance searches. */
+
+#ifndef YAPF_REGIONS_H
+#define YAPF_REGIONS_H
+
+#include "../../map_func.h"
+#include "../../transport_type.h"
+#include <vector>
+
+static const uint YAPF_REGION_BITS = 5;                     ///< Regions are (1 << YAPF_REGION_BITS) by (1 << YAPF_REGION_BITS) tiles.
+static const uint YAPF_REGION_SIZE = 1 << YAPF_REGION_BITS; ///< Number of tiles along the side of a region.
+
+/**
+ * Get the index of the region a tile belongs to.
+ * @param tile The tile.
+ * @return The index of the region.
+ */
+static inline uint GetYapfRegionIndex(TileIndex tile)
+{
+	return (TileY(tile) >> YAPF_REGION_BITS) * (MapSizeX() >> YAPF_REGION_BITS) + (TileX(tile) >> YAPF_REGION_BITS);
+}
+
+/**
+ * Get the northern tile of a region.
+ * @param index The index of the region.
+ * @return The tile with the lowest coordinates within the region.
+ */
+static inline TileIndex GetYapfRegionTile(uint index)
+{
+	uint regions_x = MapSizeX() >> YAPF_REGION_BITS;
+	return TileXY((index % regions_x) << YAPF_REGION_BITS, (index / regions_x) << YAPF_REGION_BITS);
+}
+
+/**
+ * The regions along a path over the abstract graph of a network, including
+ * their direct neighbours. A search that is restricted to these regions
+ * only has to refine the abstract path instead of searching the whole map.
+ * A corridor may cover only the start of a long path; the search is then
+ * done once it reaches the last region of the path within the corridor.
+ */
+class YapfCorridor {
+	std::vector<bool> regions; ///< Whether each region is part of the corridor.
+	uint end_region;           ///< Last region of the path within a partial corridor, or \c UINT_MAX when the corridor covers the whole path.
+
+public:
+	bool Find(TransportType type, TileIndex origin, TileIndex dest, uint max_length = UINT_MAX);
+
+	/**
+	 * Check whether a tile lies within the corridor.
+	 * @param tile The tile to check.
+	 * @return True iff the tile's region is part of the corridor.
+	 */
+	inline bool Contains(TileIndex tile) const
+	{
+		return this->regions[GetYapfRegionIndex(tile)];
+	}
+
+	/**
+	 * Check whether the corridor only covers the start of the path.
+	 * @return True iff the corridor ends before the destination.
+	 */
+	inline bool IsPartial() const
+	{
+		return this->end_region != UINT_MAX;
+	}
+
+	/**
+	 * Get the region a partial corridor ends in.
+	 * @return The index of the last region of the path within the corridor.
+	 */
+	inline uint GetEndRegion() const
+	{
+		assert(this->IsPartial());
+		return this->end_region;
+	}
+};
+
+void YapfRegionsNotifyChange(TransportType type, TileIndex tile);
+void YapfRegionsCheckCaches();
+
+#endif /* YAPF_REGIONS_H */
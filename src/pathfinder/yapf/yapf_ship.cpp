@@ -14,9 +14,13 @@
 
 #include "yapf.hpp"
 #include "yapf_node_ship.hpp"
+#include "yapf_cache.h"
+#include "yapf_regions.h"
 
 #include "../../safeguards.h"
 
+static const uint YAPF_SHIP_CORRIDOR_LENGTH = 8; ///< Number of regions along the abstract path a ship searches its path through at once.
+
 template <class Types>
 class CYapfDestinationTileWaterT
 {
@@ -30,8 +34,11 @@ protected:
 	TileIndex    m_destTile;
 	TrackdirBits m_destTrackdirs;
 	StationID    m_destStation;
+	const YapfCorridor *m_corridor; ///< Regions the search is restricted to, or \c nullptr for no restriction.
 
 public:
+	CYapfDestinationTileWaterT() : m_corridor(nullptr) {}
+
 	void SetDestination(const Ship *v)
 	{
 		if (v->current_order.IsType(OT_GOTO_STATION)) {
@@ -45,6 +52,20 @@ public:
 		}
 	}
 
+	/**
+	 * Restrict the search to the first regions along the path over the abstract water region graph.
+	 * When the destination lies beyond those regions, reaching the last of them is good enough.
+	 * @param corridor The corridor to find and restrict the search to.
+	 * @param origin The tile the search starts at.
+	 * @return True iff the search has been restricted.
+	 */
+	bool SetCorridor(YapfCorridor *corridor, TileIndex origin)
+	{
+		if (!corridor->Find(TRANSPORT_WATER, origin, m_destTile, YAPF_SHIP_CORRIDOR_LENGTH)) return false;
+		m_corridor = corridor;
+		return true;
+	}
+
 protected:
 	/** to access inherited path finder */
 	inline Tpf& Yapf()
@@ -61,6 +82,8 @@ public:
 
 	inline bool PfDetectDestinationTile(TileIndex tile, Trackdir trackdir)
 	{
+		if (m_corridor != nullptr && m_corridor->IsPartial() && GetYapfRegionIndex(tile) == m_corridor->GetEndRegion()) return true;
+
 		if (m_destStation != INVALID_STATION) {
 			return IsDockingTile(tile) && IsShipDestinationTile(tile, m_destStation);
 		}
@@ -82,11 +105,20 @@ public:
 		}
 
 		TileIndex tile = n.m_segment_last_tile;
+		/* Outside of the corridor there is nothing to be found. */
+		if (m_corridor != nullptr && !m_corridor->Contains(tile)) return false;
+
 		DiagDirection exitdir = TrackdirToExitdir(n.m_segment_last_td);
 		int x1 = 2 * TileX(tile) + dg_dir_to_x_offs[(int)exitdir];
 		int y1 = 2 * TileY(tile) + dg_dir_to_y_offs[(int)exitdir];
 		int x2 = 2 * TileX(m_destTile);
 		int y2 = 2 * TileY(m_destTile);
+		if (m_corridor != nullptr && m_corridor->IsPartial()) {
+			/* Head for the nearest tile of the region the corridor ends in. */
+			TileIndex end = GetYapfRegionTile(m_corridor->GetEndRegion());
+			x2 = 2 * Clamp<int>(TileX(tile), TileX(end), TileX(end) + YAPF_REGION_SIZE - 1);
+			y2 = 2 * Clamp<int>(TileY(tile), TileY(end), TileY(end) + YAPF_REGION_SIZE - 1);
+		}
 		int dx = abs(x1 - x2);
 		int dy = abs(y1 - y2);
 		int dmin = min(dx, dy);
@@ -137,6 +169,18 @@ public:
 	}
 
 	static Trackdir ChooseShipTrack(const Ship *v, TileIndex tile, DiagDirection enterdir, TrackBits tracks, bool &path_found, ShipPathCache &path_cache)
+	{
+		if (_settings_game.pf.yapf.ship_hierarchical) {
+			/* Only refine the start of the path over the abstract graph first; search everywhere when that fails. */
+			YapfCorridor corridor;
+			Trackdir result = ChooseShipTrack(v, tile, enterdir, tracks, path_found, path_cache, &corridor);
+			if (path_found) return result;
+			path_cache.clear();
+		}
+		return ChooseShipTrack(v, tile, enterdir, tracks, path_found, path_cache, nullptr);
+	}
+
+	static Trackdir ChooseShipTrack(const Ship *v, TileIndex tile, DiagDirection enterdir, TrackBits tracks, bool &path_found, ShipPathCache &path_cache, YapfCorridor *corridor)
 	{
 		/* handle special case - when next tile is destination tile */
 		if (tile == v->dest_tile) {
@@ -163,6 +207,10 @@ public:
 		/* set origin and destination nodes */
 		pf.SetOrigin(src_tile, trackdirs);
 		pf.SetDestination(v);
+		if (corridor != nullptr && !pf.SetCorridor(corridor, src_tile)) {
+			path_found = false;
+			return INVALID_TRACKDIR;
+		}
 		/* find best path */
 		path_found = pf.FindPath(v);
 
@@ -381,3 +429,8 @@ bool YapfShipCheckReverse(const Ship *v)
 
 	return reverse;
 }
+
+void YapfNotifyWaterLayoutChange(TileIndex tile)
+{
+	YapfRegionsNotifyChange(TRANSPORT_WATER, tile);
+}
@@ -713,6 +713,7 @@ CommandCost CmdRemoveSingleRail(TileIndex tile, DoCommandFlag flags, uint32 p1,
 						bool docking = IsDockingTile(tile);
 						MakeShore(tile);
 						SetDockingTile(tile, docking);
+						YapfNotifyWaterLayoutChange(tile);
 					} else {
 						DoClearSquare(tile);
 					}
@@ -22,6 +22,7 @@ typedef LinkGraph::BaseEdge Edge;
 const SettingDesc *GetSettingDescription(uint index);
 
 static uint16 _num_nodes;
+static NodeID _next_edge; ///< Destination of the edge saved after the current one.
 
 /**
  * Get a SaveLoad array for a link graph.
@@ -116,7 +117,8 @@ static const SaveLoad _node_desc[] = {
 };
 
 /**
- * SaveLoad desc for a link graph edge.
+ * SaveLoad desc for a link graph edge. The edges of a node are saved as a
+ * linked list, headed by an empty edge from the node to itself.
  */
 static const SaveLoad _edge_desc[] = {
 	SLE_CONDNULL(4, SL_MIN_VERSION, SLV_191), // distance
@@ -124,31 +126,65 @@ static const SaveLoad _edge_desc[] = {
 	     SLE_VAR(Edge, usage,                    SLE_UINT32),
 	     SLE_VAR(Edge, last_unrestricted_update, SLE_INT32),
 	 SLE_CONDVAR(Edge, last_restricted_update,   SLE_INT32, SLV_187, SL_MAX_VERSION),
-	     SLE_VAR(Edge, next_edge,                SLE_UINT16),
+	    SLEG_VAR(_next_edge,                     SLE_UINT16),
 	     SLE_END()
 };
 
 /**
- * Save/load a link graph.
- * @param lg Link graph to be saved or loaded.
+ * Save a link graph.
+ * @param lg Link graph to be saved.
  */
-void SaveLoad_LinkGraph(LinkGraph &lg)
+void Save_LinkGraph(const LinkGraph &lg)
 {
 	uint size = lg.Size();
 	for (NodeID from = 0; from < size; ++from) {
-		Node *node = &lg.nodes[from];
-		SlObject(node, _node_desc);
+		SlObject(const_cast<Node *>(&lg.nodes[from]), _node_desc);
+		const LinkGraph::EdgeVector &edges = lg.edges[from]->edges;
+		Edge head;
+		head.Init(from);
+		_next_edge = edges.empty() ? INVALID_NODE : edges[0].dest_node;
+		SlObject(&head, _edge_desc);
+		for (uint i = 0; i < edges.size(); ++i) {
+			_next_edge = i + 1 < edges.size() ? edges[i + 1].dest_node : INVALID_NODE;
+			SlObject(const_cast<Edge *>(&edges[i]), _edge_desc);
+		}
+	}
+}
+
+/**
+ * Load a link graph.
+ * @param lg Link graph to be loaded.
+ */
+void Load_LinkGraph(LinkGraph &lg)
+{
+	uint size = lg.Size();
+	for (NodeID from = 0; from < size; ++from) {
+		SlObject(&lg.nodes[from], _node_desc);
+		LinkGraph::EdgeVector &edges = lg.edges[from]->edges;
 		if (IsSavegameVersionBefore(SLV_191)) {
 			/* We used to save the full matrix ... */
+			std::vector<Edge> matrix(size);
+			std::vector<NodeID> next(size);
 			for (NodeID to = 0; to < size; ++to) {
-				SlObject(&lg.edges[from][to], _edge_desc);
+				matrix[to].Init(to);
+				SlObject(&matrix[to], _edge_desc);
+				next[to] = _next_edge;
+			}
+			for (NodeID to = next[from]; to != INVALID_NODE; to = next[to]) {
+				edges.push_back(matrix[to]);
 			}
 		} else {
 			/* ... but as that wasted a lot of space we save a sparse matrix now. */
-			for (NodeID to = from; to != INVALID_NODE; to = lg.edges[from][to].next_edge) {
-				SlObject(&lg.edges[from][to], _edge_desc);
+			Edge head;
+			head.Init(from);
+			SlObject(&head, _edge_desc);
+			for (NodeID to = _next_edge; to != INVALID_NODE; to = _next_edge) {
+				edges.emplace_back();
+				edges.back().Init(to);
+				SlObject(&edges.back(), _edge_desc);
 			}
 		}
+		lg.edges[from]->RebuildIndex();
 	}
 }
 
@@ -161,7 +197,7 @@ static void DoSave_LGRJ(LinkGraphJob *lgj)
 	SlObject(lgj, GetLinkGraphJobDesc());
 	_num_nodes = lgj->Size();
 	SlObject(const_cast<LinkGraph *>(&lgj->Graph()), GetLinkGraphDesc());
-	SaveLoad_LinkGraph(const_cast<LinkGraph &>(lgj->Graph()));
+	Save_LinkGraph(lgj->Graph());
 }
 
 /**
@@ -172,7 +208,7 @@ static void DoSave_LGRP(LinkGraph *lg)
 {
 	_num_nodes = lg->Size();
 	SlObject(lg, GetLinkGraphDesc());
-	SaveLoad_LinkGraph(*lg);
+	Save_LinkGraph(*lg);
 }
 
 /**
@@ -189,7 +225,7 @@ static void Load_LGRP()
 		LinkGraph *lg = new (index) LinkGraph();
 		SlObject(lg, GetLinkGraphDesc());
 		lg->Init(_num_nodes);
-		SaveLoad_LinkGraph(*lg);
+		Load_LinkGraph(*lg);
 	}
 }
 
@@ -209,7 +245,7 @@ static void Load_LGRJ()
 		LinkGraph &lg = const_cast<LinkGraph &>(lgj->Graph());
 		SlObject(&lg, GetLinkGraphDesc());
 		lg.Init(_num_nodes);
-		SaveLoad_LinkGraph(lg);
+		Load_LinkGraph(lg);
 	}
 }
 
@@ -48,63 +48,119 @@ static void Check_MAPS()
 
 static const uint MAP_SL_BUF_SIZE = 4096;
 
-static void Load_MAPT()
+/**
+ * Load a map array that has one byte per tile, both in the savegame and in memory.
+ * @param array The array to load.
+ */
+static void LoadMapArray(byte *array)
 {
-	std::array<byte, MAP_SL_BUF_SIZE> buf;
 	TileIndex size = MapSize();
 
-	for (TileIndex i = 0; i != size;) {
-		SlArray(buf.data(), MAP_SL_BUF_SIZE, SLE_UINT8);
-		for (uint j = 0; j != MAP_SL_BUF_SIZE; j++) _m[i++].type = buf[j];
+	/* When the savegame is memory mapped, it can be copied in one go. */
+	const byte *data = SlReadDirect(size);
+	if (data != nullptr) {
+		memcpy(array, data, size);
+		return;
+	}
+
+	for (TileIndex i = 0; i != size; i += MAP_SL_BUF_SIZE) {
+		SlArray(array + i, MAP_SL_BUF_SIZE, SLE_UINT8);
 	}
 }
 
-static void Save_MAPT()
+/**
+ * Load a map array that has one byte per tile in the savegame.
+ * @param store Function storing the byte of a tile.
+ */
+template <typename F>
+static void LoadMapBytes(F store)
 {
 	std::array<byte, MAP_SL_BUF_SIZE> buf;
 	TileIndex size = MapSize();
 
-	SlSetLength(size);
 	for (TileIndex i = 0; i != size;) {
-		for (uint j = 0; j != MAP_SL_BUF_SIZE; j++) buf[j] = _m[i++].type;
-		SlArray(buf.data(), MAP_SL_BUF_SIZE, SLE_UINT8);
+		/* Read straight from the savegame when it is in memory already. */
+		const byte *data = SlReadDirect(MAP_SL_BUF_SIZE);
+		if (data == nullptr) {
+			SlArray(buf.data(), MAP_SL_BUF_SIZE, SLE_UINT8);
+			data = buf.data();
+		}
+		for (uint j = 0; j != MAP_SL_BUF_SIZE; j++) store(i++, data[j]);
 	}
 }
 
-static void Load_MAPH()
+/**
+ * Load a map array that has two bytes per tile in the savegame.
+ * @param store Function storing the value of a tile.
+ */
+template <typename F>
+static void LoadMapWords(F store)
 {
-	std::array<byte, MAP_SL_BUF_SIZE> buf;
+	std::array<uint16, MAP_SL_BUF_SIZE> buf;
 	TileIndex size = MapSize();
 
 	for (TileIndex i = 0; i != size;) {
-		SlArray(buf.data(), MAP_SL_BUF_SIZE, SLE_UINT8);
-		for (uint j = 0; j != MAP_SL_BUF_SIZE; j++) _m[i++].height = buf[j];
+		/* Read straight from the savegame when it is in memory already; it is big endian. */
+		const byte *data = SlReadDirect(MAP_SL_BUF_SIZE * sizeof(uint16));
+		if (data != nullptr) {
+			for (uint j = 0; j != MAP_SL_BUF_SIZE; j++) store(i++, (uint16)(data[j * 2] << 8 | data[j * 2 + 1]));
+		} else {
+			SlArray(buf.data(), MAP_SL_BUF_SIZE, SLE_UINT16);
+			for (uint j = 0; j != MAP_SL_BUF_SIZE; j++) store(i++, buf[j]);
+		}
 	}
 }
 
-static void Save_MAPH()
+static void Load_MAPT()
+{
+	LoadMapArray(_m_type);
+}
+
+static void Save_MAPT()
 {
 	std::array<byte, MAP_SL_BUF_SIZE> buf;
 	TileIndex size = MapSize();
 
+	if (SlReusePreviousChunk(&_m_type_changed)) return;
+
 	SlSetLength(size);
 	for (TileIndex i = 0; i != size;) {
-		for (uint j = 0; j != MAP_SL_BUF_SIZE; j++) buf[j] = _m[i++].height;
+		for (uint j = 0; j != MAP_SL_BUF_SIZE; j++) buf[j] = _m_type[i++];
 		SlArray(buf.data(), MAP_SL_BUF_SIZE, SLE_UINT8);
 	}
 }
 
-static void Load_MAP1()
+static void Load_MAPH()
+{
+	LoadMapArray(_m_height);
+}
+
+static void Save_MAPH()
 {
 	std::array<byte, MAP_SL_BUF_SIZE> buf;
 	TileIndex size = MapSize();
 
+	if (SlReusePreviousChunk(&_m_height_changed)) return;
+
+	SlSetLength(size);
 	for (TileIndex i = 0; i != size;) {
+		for (uint j = 0; j != MAP_SL_BUF_SIZE; j++) buf[j] = _m_height[i++];
 		SlArray(buf.data(), MAP_SL_BUF_SIZE, SLE_UINT8);
-		for (uint j = 0; j != MAP_SL_BUF_SIZE; j++) _m[i++].m1 = buf[j];
 	}
 }
 
+/*
+ * The other map arrays are always saved, even by incremental saves. They are
+ * written directly from all over the code, so there is no place to track their
+ * changes, and finding changes by hashing them reads as much memory as simply
+ * saving them does.
+ */
+
+static void Load_MAP1()
+{
+	LoadMapBytes([](TileIndex t, byte b) { _m[t].m1 = b; });
+}
+
 static void Save_MAP1()
 {
 	std::array<byte, MAP_SL_BUF_SIZE> buf;
@@ -119,15 +175,11 @@ static void Save_MAP1()
 
 static void Load_MAP2()
 {
-	std::array<uint16, MAP_SL_BUF_SIZE> buf;
-	TileIndex size = MapSize();
-
-	for (TileIndex i = 0; i != size;) {
-		SlArray(buf.data(), MAP_SL_BUF_SIZE,
-			/* In those versions the m2 was 8 bits */
-			IsSavegameVersionBefore(SLV_5) ? SLE_FILE_U8 | SLE_VAR_U16 : SLE_UINT16
-		);
-		for (uint j = 0; j != MAP_SL_BUF_SIZE; j++) _m[i++].m2 = buf[j];
+	if (IsSavegameVersionBefore(SLV_5)) {
+		/* In those versions the m2 was 8 bits */
+		LoadMapBytes([](TileIndex t, byte b) { _m[t].m2 = b; });
+	} else {
+		LoadMapWords([](TileIndex t, uint16 v) { _m[t].m2 = v; });
 	}
 }
 
@@ -145,13 +197,7 @@ static void Save_MAP2()
 
 static void Load_MAP3()
 {
-	std::array<byte, MAP_SL_BUF_SIZE> buf;
-	TileIndex size = MapSize();
-
-	for (TileIndex i = 0; i != size;) {
-		SlArray(buf.data(), MAP_SL_BUF_SIZE, SLE_UINT8);
-		for (uint j = 0; j != MAP_SL_BUF_SIZE; j++) _m[i++].m3 = buf[j];
-	}
+	LoadMapBytes([](TileIndex t, byte b) { _m[t].m3 = b; });
 }
 
 static void Save_MAP3()
@@ -168,13 +214,7 @@ static void Save_MAP3()
 
 static void Load_MAP4()
 {
-	std::array<byte, MAP_SL_BUF_SIZE> buf;
-	TileIndex size = MapSize();
-
-	for (TileIndex i = 0; i != size;) {
-		SlArray(buf.data(), MAP_SL_BUF_SIZE, SLE_UINT8);
-		for (uint j = 0; j != MAP_SL_BUF_SIZE; j++) _m[i++].m4 = buf[j];
-	}
+	LoadMapBytes([](TileIndex t, byte b) { _m[t].m4 = b; });
 }
 
 static void Save_MAP4()
@@ -191,13 +231,7 @@ static void Save_MAP4()
 
 static void Load_MAP5()
 {
-	std::array<byte, MAP_SL_BUF_SIZE> buf;
-	TileIndex size = MapSize();
-
-	for (TileIndex i = 0; i != size;) {
-		SlArray(buf.data(), MAP_SL_BUF_SIZE, SLE_UINT8);
-		for (uint j = 0; j != MAP_SL_BUF_SIZE; j++) _m[i++].m5 = buf[j];
-	}
+	LoadMapBytes([](TileIndex t, byte b) { _m[t].m5 = b; });
 }
 
 static void Save_MAP5()
@@ -229,10 +263,7 @@ static void Load_MAP6()
 			}
 		}
 	} else {
-		for (TileIndex i = 0; i != size;) {
-			SlArray(buf.data(), MAP_SL_BUF_SIZE, SLE_UINT8);
-			for (uint j = 0; j != MAP_SL_BUF_SIZE; j++) _me[i++].m6 = buf[j];
-		}
+		LoadMapBytes([](TileIndex t, byte b) { _me[t].m6 = b; });
 	}
 }
 
@@ -250,13 +281,7 @@ static void Save_MAP6()
 
 static void Load_MAP7()
 {
-	std::array<byte, MAP_SL_BUF_SIZE> buf;
-	TileIndex size = MapSize();
-
-	for (TileIndex i = 0; i != size;) {
-		SlArray(buf.data(), MAP_SL_BUF_SIZE, SLE_UINT8);
-		for (uint j = 0; j != MAP_SL_BUF_SIZE; j++) _me[i++].m7 = buf[j];
-	}
+	LoadMapBytes([](TileIndex t, byte b) { _me[t].m7 = b; });
 }
 
 static void Save_MAP7()
@@ -273,13 +298,7 @@ static void Save_MAP7()
 
 static void Load_MAP8()
 {
-	std::array<uint16, MAP_SL_BUF_SIZE> buf;
-	TileIndex size = MapSize();
-
-	for (TileIndex i = 0; i != size;) {
-		SlArray(buf.data(), MAP_SL_BUF_SIZE, SLE_UINT16);
-		for (uint j = 0; j != MAP_SL_BUF_SIZE; j++) _me[i++].m8 = buf[j];
-	}
+	LoadMapWords([](TileIndex t, uint16 v) { _me[t].m8 = v; });
 }
 
 static void Save_MAP8()
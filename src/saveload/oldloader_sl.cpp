@@ -48,6 +48,8 @@ void FixOldMapArray()
 	/* TTO/TTD/TTDP savegames could have buoys at tile 0
 	 * (without assigned station struct) */
 	MemSetT(&_m[0], 0);
+	_m_type[0] = 0;
+	_m_height[0] = 0;
 	SetTileType(0, MP_WATER);
 	SetTileOwner(0, OWNER_WATER);
 }
@@ -1468,6 +1470,8 @@ static bool LoadOldMapPart1(LoadgameState *ls, int num)
 	if (_savegame_type == SGT_TTO) {
 		MemSetT(_m, 0, OLD_MAP_SIZE);
 		MemSetT(_me, 0, OLD_MAP_SIZE);
+		MemSetT(_m_type, 0, OLD_MAP_SIZE);
+		MemSetT(_m_height, 0, OLD_MAP_SIZE);
 	}
 
 	for (uint i = 0; i < OLD_MAP_SIZE; i++) {
@@ -1499,7 +1503,7 @@ static bool LoadOldMapPart2(LoadgameState *ls, int num)
 	uint i;
 
 	for (i = 0; i < OLD_MAP_SIZE; i++) {
-		_m[i].type = ReadByte(ls);
+		_m_type[i] = ReadByte(ls);
 	}
 	for (i = 0; i < OLD_MAP_SIZE; i++) {
 		_m[i].m5 = ReadByte(ls);
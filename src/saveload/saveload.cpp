@@ -20,6 +20,10 @@
  * </ol>
  */
 #include <deque>
+#include <map>
+#if defined(UNIX)
+#include <sys/mman.h>
+#endif
 
 #include "../stdafx.h"
 #include "../debug.h"
@@ -43,6 +47,7 @@
 #include "../string_func.h"
 #include "../fios.h"
 #include "../error.h"
+#include "../worker_pool.h"
 #include <atomic>
 
 #include "table/strings.h"
@@ -84,8 +89,8 @@ static const size_t MEMORY_CHUNK_SIZE = 128 * 1024;
 /** A buffer for reading (and buffering) savegame data. */
 struct ReadBuffer {
 	byte buf[MEMORY_CHUNK_SIZE]; ///< Buffer we're going to read from.
-	byte *bufp;                  ///< Location we're at reading the buffer.
-	byte *bufe;                  ///< End of the buffer we can read from.
+	const byte *bufp;            ///< Location we're at reading the buffer.
+	const byte *bufe;            ///< End of the buffer we can read from.
 	LoadFilter *reader;          ///< The filter used to actually read.
 	size_t read;                 ///< The amount of read bytes so far from the filter.
 
@@ -95,6 +100,14 @@ struct ReadBuffer {
 	 */
 	ReadBuffer(LoadFilter *reader) : bufp(nullptr), bufe(nullptr), reader(reader), read(0)
 	{
+		/* When the savegame is in memory already, read straight from there instead of copying it into our buffer. */
+		size_t len;
+		const byte *data = reader->ReadMapped(&len);
+		if (data != nullptr) {
+			this->bufp = data;
+			this->bufe = data + len;
+			this->read = len;
+		}
 	}
 
 	inline byte ReadByte()
@@ -111,6 +124,45 @@ struct ReadBuffer {
 		return *this->bufp++;
 	}
 
+	/**
+	 * Copy the next bytes to the given memory, refilling the buffer as often as needed.
+	 * @param ptr The memory to copy the bytes to.
+	 * @param len The number of bytes to copy.
+	 */
+	void CopyBytes(byte *ptr, size_t len)
+	{
+		while (len != 0) {
+			if (this->bufp == this->bufe) {
+				size_t read = this->reader->Read(this->buf, lengthof(this->buf));
+				if (read == 0) SlErrorCorrupt("Unexpected end of chunk");
+
+				this->read += read;
+				this->bufp = this->buf;
+				this->bufe = this->buf + read;
+			}
+
+			size_t to_copy = min<size_t>(this->bufe - this->bufp, len);
+			memcpy(ptr, this->bufp, to_copy);
+			this->bufp += to_copy;
+			ptr += to_copy;
+			len -= to_copy;
+		}
+	}
+
+	/**
+	 * Get direct access to the next bytes, when they are in the buffer already.
+	 * @param len The number of bytes to access; they count as read.
+	 * @return The bytes, or \c nullptr when they are not in the buffer.
+	 */
+	inline const byte *ReadDirect(size_t len)
+	{
+		if ((size_t)(this->bufe - this->bufp) < len) return nullptr;
+
+		const byte *p = this->bufp;
+		this->bufp += len;
+		return p;
+	}
+
 	/**
 	 * Get the size of the memory dump made so far.
 	 * @return The size.
@@ -140,6 +192,14 @@ struct MemoryDumper {
 		}
 	}
 
+	/** Start writing into a new block. */
+	void AllocateBlock()
+	{
+		this->buf = CallocT<byte>(MEMORY_CHUNK_SIZE);
+		this->blocks.push_back(this->buf);
+		this->bufe = this->buf + MEMORY_CHUNK_SIZE;
+	}
+
 	/**
 	 * Write a single byte into the dumper.
 	 * @param b The byte to write.
@@ -147,15 +207,49 @@ struct MemoryDumper {
 	inline void WriteByte(byte b)
 	{
 		/* Are we at the end of this chunk? */
-		if (this->buf == this->bufe) {
-			this->buf = CallocT<byte>(MEMORY_CHUNK_SIZE);
-			this->blocks.push_back(this->buf);
-			this->bufe = this->buf + MEMORY_CHUNK_SIZE;
-		}
+		if (this->buf == this->bufe) this->AllocateBlock();
 
 		*this->buf++ = b;
 	}
 
+	/**
+	 * Write a number of bytes into the dumper.
+	 * @param p   The bytes to write.
+	 * @param len The number of bytes to write.
+	 */
+	void WriteBytes(const byte *p, size_t len)
+	{
+		while (len != 0) {
+			if (this->buf == this->bufe) this->AllocateBlock();
+
+			size_t to_write = min<size_t>(this->bufe - this->buf, len);
+			memcpy(this->buf, p, to_write);
+			this->buf += to_write;
+			p += to_write;
+			len -= to_write;
+		}
+	}
+
+	/**
+	 * Copy everything that has been written since a given position.
+	 * @param start     The position to start copying from.
+	 * @param[out] dest The vector to copy the data to.
+	 */
+	void CopySince(size_t start, std::vector<byte> &dest) const
+	{
+		size_t end = this->GetSize();
+
+		dest.clear();
+		dest.reserve(end - start);
+		while (start != end) {
+			const byte *block = this->blocks[start / MEMORY_CHUNK_SIZE];
+			size_t offset = start % MEMORY_CHUNK_SIZE;
+			size_t to_copy = min(MEMORY_CHUNK_SIZE - offset, end - start);
+			dest.insert(dest.end(), block + offset, block + offset + to_copy);
+			start += to_copy;
+		}
+	}
+
 	/**
 	 * Flush this dumper into a writer.
 	 * @param writer The filter we want to use.
@@ -206,10 +300,18 @@ struct SaveLoadParams {
 
 	byte ff_state;                       ///< The state of fast-forward when saving started.
 	bool saveinprogress;                 ///< Whether there is currently a save in progress.
+
+	bool incremental;                    ///< Whether chunks that did not change may be copied from the previous save.
+	bool for_network;                    ///< Whether the savegame is sent to clients over the network.
+	uint32 chunk_id;                     ///< The chunk that is being saved.
+	bool *chunk_changed;                 ///< Change flag of the chunk that is being saved, when its data has to be recorded for the next save.
 };
 
 static SaveLoadParams _sl; ///< Parameters used for/at saveload.
 
+/** Data of the chunks that were recorded by incremental saves, by chunk id. */
+static std::map<uint32, std::vector<byte>> _previous_chunks;
+
 /* these define the chunks */
 extern const ChunkHandler _gamelog_chunk_handlers[];
 extern const ChunkHandler _map_chunk_handlers[];
@@ -730,15 +832,54 @@ static void SlCopyBytes(void *ptr, size_t length)
 	switch (_sl.action) {
 		case SLA_LOAD_CHECK:
 		case SLA_LOAD:
-			for (; length != 0; length--) *p++ = SlReadByte();
+			_sl.reader->CopyBytes(p, length);
 			break;
 		case SLA_SAVE:
-			for (; length != 0; length--) SlWriteByte(*p++);
+			_sl.dumper->WriteBytes(p, length);
 			break;
 		default: NOT_REACHED();
 	}
 }
 
+/** Convert a 16 bits integer between the savegame (big endian) and memory order. */
+static inline uint16 SlSwapBE(uint16 x) { return FROM_BE16(x); }
+/** Convert a 32 bits integer between the savegame (big endian) and memory order. */
+static inline uint32 SlSwapBE(uint32 x) { return FROM_BE32(x); }
+
+/**
+ * Save/Load an array of integers that have the same size in the savegame and in
+ * memory. Instead of going through #SlSaveLoadConv for every element, the whole
+ * array is copied at once and only the byte order is fixed up afterwards.
+ * @param array The array being manipulated.
+ * @param length The length of the array in elements.
+ */
+template <typename T>
+static void SlCopyArray(T *array, size_t length)
+{
+	switch (_sl.action) {
+		case SLA_LOAD_CHECK:
+		case SLA_LOAD:
+			_sl.reader->CopyBytes((byte *)array, length * sizeof(T));
+			for (size_t i = 0; i < length; i++) array[i] = SlSwapBE(array[i]);
+			break;
+
+		case SLA_SAVE: {
+			/* Convert via a small buffer, the array itself must not be touched. */
+			T buf[4096 / sizeof(T)];
+			while (length != 0) {
+				size_t n = min<size_t>(length, lengthof(buf));
+				for (size_t i = 0; i < n; i++) buf[i] = SlSwapBE(array[i]);
+				_sl.dumper->WriteBytes((const byte *)buf, n * sizeof(T));
+				array += n;
+				length -= n;
+			}
+			break;
+		}
+
+		default: NOT_REACHED();
+	}
+}
+
 /** Get the length of the current object */
 size_t SlGetFieldLength()
 {
@@ -986,6 +1127,19 @@ static inline size_t SlCalcArrayLen(size_t length, VarType conv)
 	return SlCalcConvFileLen(conv) * length;
 }
 
+/**
+ * Get direct access to the next bytes of the savegame that is being loaded,
+ * without copying them. This always works for memory mapped savegames, and
+ * otherwise only when the bytes happen to be in the read buffer already.
+ * @param length The number of bytes to access; they count as read.
+ * @return The bytes, or \c nullptr when they have to be read with e.g. #SlArray.
+ */
+const byte *SlReadDirect(size_t length)
+{
+	assert(_sl.action == SLA_LOAD || _sl.action == SLA_LOAD_CHECK);
+	return _sl.reader->ReadDirect(length);
+}
+
 /**
  * Save/Load an array.
  * @param array The array being manipulated
@@ -1025,6 +1179,11 @@ void SlArray(void *array, size_t length, VarType conv)
 	 * conversion is needed, use specialized copy-copy function to speed up things */
 	if (conv == SLE_INT8 || conv == SLE_UINT8) {
 		SlCopyBytes(array, length);
+	} else if (conv == SLE_INT16 || conv == SLE_UINT16) {
+		/* Same goes for the other integers that are stored with the same size, they just need their byte order fixed. */
+		SlCopyArray((uint16 *)array, length);
+	} else if (conv == SLE_INT32 || conv == SLE_UINT32) {
+		SlCopyArray((uint32 *)array, length);
 	} else {
 		byte *a = (byte*)array;
 		byte mem_size = SlCalcConvMemLen(conv);
@@ -1152,12 +1311,14 @@ static void *IntToReference(size_t index, SLRefType rt)
 }
 
 /**
- * Return the size in bytes of a list
- * @param list The std::list to find the size of
+ * Return the size in bytes of a list of references.
+ * @tparam PtrList Type of the list, either std::list or std::deque of pointers.
+ * @param list The list to find the size of
  */
+template <typename PtrList>
 static inline size_t SlCalcListLen(const void *list)
 {
-	const std::list<void *> *l = (const std::list<void *> *) list;
+	const PtrList *l = (const PtrList *) list;
 
 	int type_size = IsSavegameVersionBefore(SLV_69) ? 2 : 4;
 	/* Each entry is saved as type_size bytes, plus type_size bytes are used for the length
@@ -1167,27 +1328,28 @@ static inline size_t SlCalcListLen(const void *list)
 
 
 /**
- * Save/Load a list.
+ * Save/Load a list of references.
+ * @tparam PtrList Type of the list, either std::list or std::deque of pointers.
  * @param list The list being manipulated
  * @param conv SLRefType type of the list (Vehicle *, Station *, etc)
  */
+template <typename PtrList>
 static void SlList(void *list, SLRefType conv)
 {
 	/* Automatically calculate the length? */
 	if (_sl.need_length != NL_NONE) {
-		SlSetLength(SlCalcListLen(list));
+		SlSetLength(SlCalcListLen<PtrList>(list));
 		/* Determine length only? */
 		if (_sl.need_length == NL_CALCLENGTH) return;
 	}
 
-	typedef std::list<void *> PtrList;
 	PtrList *l = (PtrList *)list;
 
 	switch (_sl.action) {
 		case SLA_SAVE: {
 			SlWriteUint32((uint32)l->size());
 
-			PtrList::iterator iter;
+			typename PtrList::iterator iter;
 			for (iter = l->begin(); iter != l->end(); ++iter) {
 				void *ptr = *iter;
 				SlWriteUint32((uint32)ReferenceToInt(ptr, conv));
@@ -1209,7 +1371,7 @@ static void SlList(void *list, SLRefType conv)
 			PtrList temp = *l;
 
 			l->clear();
-			PtrList::iterator iter;
+			typename PtrList::iterator iter;
 			for (iter = temp.begin(); iter != temp.end(); ++iter) {
 				void *ptr = IntToReference((size_t)*iter, conv);
 				l->push_back(ptr);
@@ -1399,6 +1561,7 @@ size_t SlCalcObjMemberLength(const void *object, const SaveLoad *sld)
 		case SL_STR:
 		case SL_LST:
 		case SL_DEQUE:
+		case SL_PTRDEQ:
 			/* CONDITIONAL saveload types depend on the savegame version */
 			if (!SlIsObjectValidInSavegame(sld)) break;
 
@@ -1407,7 +1570,8 @@ size_t SlCalcObjMemberLength(const void *object, const SaveLoad *sld)
 				case SL_REF: return SlCalcRefLen();
 				case SL_ARR: return SlCalcArrayLen(sld->length, sld->conv);
 				case SL_STR: return SlCalcStringLen(GetVariableAddress(object, sld), sld->length, sld->conv);
-				case SL_LST: return SlCalcListLen(GetVariableAddress(object, sld));
+				case SL_LST: return SlCalcListLen<std::list<void *>>(GetVariableAddress(object, sld));
+				case SL_PTRDEQ: return SlCalcListLen<std::deque<void *>>(GetVariableAddress(object, sld));
 				case SL_DEQUE: return SlCalcDequeLen(GetVariableAddress(object, sld), sld->conv);
 				default: NOT_REACHED();
 			}
@@ -1478,6 +1642,7 @@ bool SlObjectMember(void *ptr, const SaveLoad *sld)
 		case SL_STR:
 		case SL_LST:
 		case SL_DEQUE:
+		case SL_PTRDEQ:
 			/* CONDITIONAL saveload types depend on the savegame version */
 			if (!SlIsObjectValidInSavegame(sld)) return false;
 			if (SlSkipVariableOnLoad(sld)) return false;
@@ -1504,7 +1669,8 @@ bool SlObjectMember(void *ptr, const SaveLoad *sld)
 					break;
 				case SL_ARR: SlArray(ptr, sld->length, conv); break;
 				case SL_STR: SlString(ptr, sld->length, sld->conv); break;
-				case SL_LST: SlList(ptr, (SLRefType)conv); break;
+				case SL_LST: SlList<std::list<void *>>(ptr, (SLRefType)conv); break;
+				case SL_PTRDEQ: SlList<std::deque<void *>>(ptr, (SLRefType)conv); break;
 				case SL_DEQUE: SlDeque(ptr, conv); break;
 				default: NOT_REACHED();
 			}
@@ -1709,6 +1875,22 @@ static void SlStubSaveProc()
 	SlAutolength(SlStubSaveProc2, nullptr);
 }
 
+/**
+ * Show how long saving or loading a chunk took, so the throughput of every chunk can be measured.
+ * @param action What has been done with the chunk.
+ * @param id The identifier of the chunk.
+ * @param bytes The number of (uncompressed) bytes of the chunk.
+ * @param start The moment handling the chunk started.
+ */
+static void SlDebugChunkThroughput(const char *action, uint32 id, size_t bytes, std::chrono::steady_clock::time_point start)
+{
+	if (_debug_sl_level < 3) return;
+
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	DEBUG(sl, 3, "%s chunk %c%c%c%c: " PRINTF_SIZE " bytes in %.3f ms (%.1f MB/s)", action, id >> 24, id >> 16, id >> 8, id, bytes, ms,
+			ms > 0 ? bytes / (ms * 1000.0) : 0.0);
+}
+
 /**
  * Save a chunk of data (eg. vehicles, stations, etc.). Each chunk is
  * prefixed by an ID identifying it, followed by data, and terminator where appropriate
@@ -1731,6 +1913,11 @@ static void SlSaveChunk(const ChunkHandler *ch)
 	}
 
 	_sl.block_mode = ch->flags & CH_TYPE_MASK;
+	_sl.chunk_id = ch->id;
+	_sl.chunk_changed = nullptr;
+	size_t start = _sl.dumper->GetSize();
+	auto start_time = std::chrono::steady_clock::now();
+
 	switch (ch->flags & CH_TYPE_MASK) {
 		case CH_RIFF:
 			_sl.need_length = NL_WANTLENGTH;
@@ -1749,6 +1936,42 @@ static void SlSaveChunk(const ChunkHandler *ch)
 			break;
 		default: NOT_REACHED();
 	}
+
+	if (_sl.chunk_changed != nullptr) {
+		/* Only now the data is known to be complete. */
+		_sl.dumper->CopySince(start, _previous_chunks[ch->id]);
+		*_sl.chunk_changed = false;
+	}
+
+	SlDebugChunkThroughput("Saved", ch->id, _sl.dumper->GetSize() - start, start_time);
+}
+
+/**
+ * Reuse the data a chunk wrote during the previous incremental save, if it did
+ * not change since. This is meant for chunks that rarely change, and must be
+ * called by the save procedure of a #CH_RIFF chunk before anything is written.
+ * When this returns true, the data has been written and the save procedure must
+ * return straight away. Otherwise the chunk has to be saved normally, and when
+ * this is an incremental save its data is recorded for the next one.
+ * @param[in,out] changed Whether the data of the chunk changed since it was last
+ *                        recorded; reset once it has been recorded again.
+ * @return True iff the data of the previous save has been written.
+ */
+bool SlReusePreviousChunk(bool *changed)
+{
+	assert(_sl.action == SLA_SAVE && _sl.block_mode == CH_RIFF);
+
+	if (!_sl.incremental || _sl.need_length != NL_WANTLENGTH) return false;
+
+	auto it = _previous_chunks.find(_sl.chunk_id);
+	if (!*changed && it != _previous_chunks.end()) {
+		_sl.need_length = NL_NONE;
+		_sl.dumper->WriteBytes(it->second.data(), it->second.size());
+		return true;
+	}
+
+	_sl.chunk_changed = changed;
+	return false;
 }
 
 /** Save all chunks */
@@ -1785,7 +2008,11 @@ static void SlLoadChunks()
 
 		ch = SlFindChunkHandler(id);
 		if (ch == nullptr) SlErrorCorrupt("Unknown chunk type");
+
+		size_t start = _sl.reader->GetSize();
+		auto start_time = std::chrono::steady_clock::now();
 		SlLoadChunk(ch);
+		SlDebugChunkThroughput("Loaded", id, _sl.reader->GetSize() - start, start_time);
 	}
 }
 
@@ -1826,20 +2053,27 @@ static void SlFixPointers()
 
 /** Yes, simply reading from a file. */
 struct FileReader : LoadFilter {
-	FILE *file; ///< The file to read from.
-	long begin; ///< The begin of the file.
+	FILE *file;          ///< The file to read from.
+	long begin;          ///< The begin of the file.
+	void *mapping;       ///< The file mapped into memory, if it is.
+	size_t mapping_size; ///< The size of the mapping.
 
 	/**
 	 * Create the file reader, so it reads from a specific file.
 	 * @param file The file to read from.
 	 */
-	FileReader(FILE *file) : LoadFilter(nullptr), file(file), begin(ftell(file))
+	FileReader(FILE *file) : LoadFilter(nullptr), file(file), begin(ftell(file)), mapping(nullptr), mapping_size(0)
 	{
 	}
 
 	/** Make sure everything is cleaned up. */
 	~FileReader()
 	{
+#if defined(UNIX)
+		if (this->mapping != nullptr) munmap(this->mapping, this->mapping_size);
+#endif
+		this->mapping = nullptr;
+
 		if (this->file != nullptr) fclose(this->file);
 		this->file = nullptr;
 
@@ -1855,6 +2089,32 @@ struct FileReader : LoadFilter {
 		return fread(buf, 1, size, this->file);
 	}
 
+	const byte *ReadMapped(size_t *len) override
+	{
+#if defined(UNIX)
+		if (this->file == nullptr || this->mapping != nullptr) return nullptr;
+
+		long pos = ftell(this->file);
+		if (pos < 0 || fseek(this->file, 0, SEEK_END) != 0) return nullptr;
+
+		/* The file stays at its end, so reading after the mapping fails like reading after the end of the file. */
+		long end = ftell(this->file);
+		void *mapping = end > pos ? mmap(nullptr, end, PROT_READ, MAP_PRIVATE, fileno(this->file), 0) : MAP_FAILED;
+		if (mapping == MAP_FAILED) {
+			fseek(this->file, pos, SEEK_SET);
+			return nullptr;
+		}
+		madvise(mapping, end, MADV_SEQUENTIAL);
+
+		this->mapping = mapping;
+		this->mapping_size = end;
+		*len = end - pos;
+		return (const byte *)mapping + pos;
+#else
+		return nullptr;
+#endif
+	}
+
 	void Reset() override
 	{
 		clearerr(this->file);
@@ -2012,6 +2272,11 @@ struct NoCompLoadFilter : LoadFilter {
 	{
 		return this->chain->Read(buf, size);
 	}
+
+	const byte *ReadMapped(size_t *len) override
+	{
+		return this->chain->ReadMapped(len);
+	}
 };
 
 /** Filter without any compression. */
@@ -2269,8 +2534,411 @@ struct LZMASaveFilter : SaveFilter {
 	}
 };
 
+/**
+ * Block-parallel LZMA: the savegame is cut into blocks of at most
+ * #PLZMA_BLOCK_SIZE bytes which are compressed independently of each other,
+ * so they can be (de)compressed by the worker threads in parallel.
+ * Every block is written as its uncompressed size and its compressed size,
+ * both as big endian uint32, followed by the block as complete xz stream.
+ * A block with an uncompressed size of 0 ends the savegame.
+ */
+static const size_t PLZMA_BLOCK_SIZE = 4 * 1024 * 1024;
+
+/** A single block of a block-parallel LZMA savegame. */
+struct PLZMABlock {
+	std::vector<byte> data;       ///< The uncompressed data.
+	std::vector<byte> compressed; ///< The compressed data.
+	bool failed;                  ///< Whether (de)compressing this block failed.
+};
+
+/**
+ * Read exactly the given number of bytes from a filter.
+ * @param chain The filter to read from.
+ * @param buf   The buffer to read into.
+ * @param len   The number of bytes to read.
+ */
+static void PLZMAReadFully(LoadFilter *chain, byte *buf, size_t len)
+{
+	while (len != 0) {
+		size_t read = chain->Read(buf, len);
+		if (read == 0) SlError(STR_GAME_SAVELOAD_ERROR_FILE_NOT_READABLE, "File read failed");
+		buf += read;
+		len -= read;
+	}
+}
+
+/** Filter using block-parallel LZMA compression. */
+struct PLZMALoadFilter : LoadFilter {
+	std::vector<PLZMABlock> blocks; ///< The blocks of the current batch.
+	size_t block;                   ///< The block we are reading from.
+	size_t pos;                     ///< The position in the block we are reading from.
+	bool finished;                  ///< Whether we encountered the end of the savegame.
+
+	/**
+	 * Initialise this filter.
+	 * @param chain The next filter in this chain.
+	 */
+	PLZMALoadFilter(LoadFilter *chain) : LoadFilter(chain), block(0), pos(0), finished(false)
+	{
+	}
+
+	/** Read the next batch of blocks and decompress them in parallel. */
+	void ReadBatch()
+	{
+		this->blocks.clear();
+		this->blocks.resize(WorkerPool::GetThreadCount());
+		this->block = 0;
+		this->pos = 0;
+
+		size_t count = 0;
+		for (; count < this->blocks.size(); count++) {
+			uint32 header[2];
+			PLZMAReadFully(this->chain, (byte *)header, sizeof(header));
+			uint32 size = FROM_BE32(header[0]);
+			uint32 compressed_size = FROM_BE32(header[1]);
+			if (size == 0) {
+				this->finished = true;
+				break;
+			}
+			if (size > PLZMA_BLOCK_SIZE || compressed_size > lzma_stream_buffer_bound(PLZMA_BLOCK_SIZE)) SlErrorCorrupt("Inconsistent size");
+
+			PLZMABlock &b = this->blocks[count];
+			b.data.resize(size);
+			b.compressed.resize(compressed_size);
+			PLZMAReadFully(this->chain, b.compressed.data(), compressed_size);
+		}
+		this->blocks.resize(count);
+
+		WorkerPool::Run((uint)count, [this](uint i) {
+			PLZMABlock &b = this->blocks[i];
+			/* Allow the same amount of memory as the LZMA filter does. */
+			uint64_t memlimit = 1 << 28;
+			size_t in_pos = 0;
+			size_t out_pos = 0;
+			lzma_ret r = lzma_stream_buffer_decode(&memlimit, 0, nullptr, b.compressed.data(), &in_pos, b.compressed.size(), b.data.data(), &out_pos, b.data.size());
+			b.failed = r != LZMA_OK || in_pos != b.compressed.size() || out_pos != b.data.size();
+		});
+
+		for (const PLZMABlock &b : this->blocks) {
+			if (b.failed) SlError(STR_GAME_SAVELOAD_ERROR_BROKEN_INTERNAL_ERROR, "liblzma returned error code");
+		}
+	}
+
+	size_t Read(byte *buf, size_t size) override
+	{
+		size_t read = 0;
+		while (read < size) {
+			if (this->block == this->blocks.size()) {
+				if (this->finished) break;
+				this->ReadBatch();
+				continue;
+			}
+
+			const std::vector<byte> &data = this->blocks[this->block].data;
+			size_t len = min(size - read, data.size() - this->pos);
+			memcpy(buf + read, data.data() + this->pos, len);
+			read += len;
+			this->pos += len;
+			if (this->pos == data.size()) {
+				this->block++;
+				this->pos = 0;
+			}
+		}
+		return read;
+	}
+
+	void Reset() override
+	{
+		this->blocks.clear();
+		this->block = 0;
+		this->pos = 0;
+		this->finished = false;
+		this->chain->Reset();
+	}
+};
+
+/** Filter using block-parallel LZMA compression. */
+struct PLZMASaveFilter : SaveFilter {
+	std::vector<PLZMABlock> blocks; ///< The blocks of the current batch; only the last one may be partially filled.
+	lzma_options_lzma options;      ///< The LZMA options to compress the blocks with.
+
+	/**
+	 * Initialise this filter.
+	 * @param chain             The next filter in this chain.
+	 * @param compression_level The requested level of compression.
+	 */
+	PLZMASaveFilter(SaveFilter *chain, byte compression_level) : SaveFilter(chain)
+	{
+		if (lzma_lzma_preset(&this->options, compression_level)) SlError(STR_GAME_SAVELOAD_ERROR_BROKEN_INTERNAL_ERROR, "cannot initialize compressor");
+		/* A dictionary larger than a block is of no use, but costs memory for every thread. */
+		this->options.dict_size = min<uint32>(this->options.dict_size, PLZMA_BLOCK_SIZE);
+	}
+
+	/** Compress all blocks of the batch in parallel and write them to the chain. */
+	void WriteBatch()
+	{
+		WorkerPool::Run((uint)this->blocks.size(), [this](uint i) {
+			PLZMABlock &b = this->blocks[i];
+			lzma_filter filters[] = {
+				{ LZMA_FILTER_LZMA2, &this->options },
+				{ LZMA_VLI_UNKNOWN, nullptr },
+			};
+			size_t out_pos = 0;
+			b.compressed.resize(lzma_stream_buffer_bound(b.data.size()));
+			lzma_ret r = lzma_stream_buffer_encode(filters, LZMA_CHECK_CRC32, nullptr, b.data.data(), b.data.size(), b.compressed.data(), &out_pos, b.compressed.size());
+			b.compressed.resize(out_pos);
+			b.failed = r != LZMA_OK;
+		});
+
+		for (PLZMABlock &b : this->blocks) {
+			if (b.failed) SlError(STR_GAME_SAVELOAD_ERROR_BROKEN_INTERNAL_ERROR, "liblzma returned error code");
+			this->WriteBlock(b.data.size(), b.compressed.data(), b.compressed.size());
+		}
+		this->blocks.clear();
+	}
+
+	/**
+	 * Write a single block to the chain.
+	 * @param size            The uncompressed size of the block.
+	 * @param compressed      The compressed data.
+	 * @param compressed_size The size of the compressed data.
+	 */
+	void WriteBlock(size_t size, byte *compressed, size_t compressed_size)
+	{
+		uint32 header[2] = { TO_BE32((uint32)size), TO_BE32((uint32)compressed_size) };
+		this->chain->Write((byte *)header, sizeof(header));
+		if (compressed_size != 0) this->chain->Write(compressed, compressed_size);
+	}
+
+	void Write(byte *buf, size_t size) override
+	{
+		while (size != 0) {
+			if (this->blocks.empty() || this->blocks.back().data.size() == PLZMA_BLOCK_SIZE) {
+				if (this->blocks.size() == WorkerPool::GetThreadCount()) this->WriteBatch();
+				this->blocks.emplace_back();
+				this->blocks.back().data.reserve(PLZMA_BLOCK_SIZE);
+			}
+
+			std::vector<byte> &data = this->blocks.back().data;
+			size_t len = min(size, PLZMA_BLOCK_SIZE - data.size());
+			data.insert(data.end(), buf, buf + len);
+			buf += len;
+			size -= len;
+		}
+	}
+
+	void Finish() override
+	{
+		this->WriteBatch();
+		this->WriteBlock(0, nullptr, 0);
+		this->chain->Finish();
+	}
+};
+
 #endif /* WITH_LIBLZMA */
 
+/********************************************
+ ********** START OF ZSTD CODE **************
+ ********************************************/
+
+#if defined(WITH_ZSTD)
+#include <zstd.h>
+
+/**
+ * Name of the optional trained dictionary, searched for in the base directories.
+ * It is meant to be trained on the contents of the map chunks, as those make up
+ * the bulk of any savegame. Only dictionaries with an identifier are used, so a
+ * savegame can tell which dictionary it needs to be loaded.
+ */
+static const char * const ZSTD_DICTIONARY_NAME = "savegame.zdict";
+
+/** The optional trained dictionary for zstd compressed savegames. */
+struct ZSTDDictionary {
+	std::vector<byte> data; ///< Raw contents of the dictionary.
+	ZSTD_DDict *ddict;      ///< Dictionary digested for decompression.
+	uint32 id;              ///< Identifier of the dictionary; 0 when there is no (usable) dictionary.
+
+	ZSTDDictionary() : ddict(nullptr), id(0)
+	{
+		size_t size;
+		FILE *f = FioFOpenFile(ZSTD_DICTIONARY_NAME, "rb", BASE_DIR, &size);
+		if (f == nullptr) return;
+
+		this->data.resize(size);
+		bool read = size != 0 && fread(this->data.data(), 1, size, f) == size;
+		FioFCloseFile(f);
+
+		uint32 id = read ? ZSTD_getDictID_fromDict(this->data.data(), size) : 0;
+		if (id != 0) this->ddict = ZSTD_createDDict(this->data.data(), size);
+		if (this->ddict == nullptr) {
+			DEBUG(sl, 0, "Ignoring invalid zstd dictionary '%s'", ZSTD_DICTIONARY_NAME);
+			this->data.clear();
+			return;
+		}
+
+		this->id = id;
+		DEBUG(sl, 1, "Using zstd dictionary '%s' with id %u", ZSTD_DICTIONARY_NAME, id);
+	}
+
+	~ZSTDDictionary()
+	{
+		ZSTD_freeDDict(this->ddict);
+	}
+};
+
+/**
+ * Get the zstd dictionary; it is loaded on first use.
+ * @return The dictionary, with an id of 0 when there is none.
+ */
+static const ZSTDDictionary &GetZSTDDictionary()
+{
+	/* Saving and sending the map can happen from other threads; this initialisation is thread safe. */
+	static const ZSTDDictionary dictionary;
+	return dictionary;
+}
+
+/** Filter using zstd compression. */
+struct ZSTDLoadFilter : LoadFilter {
+	ZSTD_DCtx *dctx;                   ///< Stream state that we are reading from.
+	ZSTD_inBuffer input;               ///< The part of #fread_buf that still has to be decompressed.
+	byte fread_buf[MEMORY_CHUNK_SIZE]; ///< Buffer for reading from the file.
+	bool started;                      ///< Whether we have already seen the frame header.
+	bool finished;                     ///< Whether the whole frame has been decompressed.
+
+	/**
+	 * Initialise this filter.
+	 * @param chain The next filter in this chain.
+	 */
+	ZSTDLoadFilter(LoadFilter *chain) : LoadFilter(chain), started(false), finished(false)
+	{
+		this->input = { this->fread_buf, 0, 0 };
+		this->dctx = ZSTD_createDCtx();
+		if (this->dctx == nullptr) SlError(STR_GAME_SAVELOAD_ERROR_BROKEN_INTERNAL_ERROR, "cannot initialize decompressor");
+	}
+
+	/** Clean everything up. */
+	~ZSTDLoadFilter()
+	{
+		ZSTD_freeDCtx(this->dctx);
+	}
+
+	/**
+	 * Make sure the dictionary the savegame was compressed with, if any, is used.
+	 * The frame header tells which dictionary that is, so read until it is complete.
+	 */
+	void SelectDictionary()
+	{
+		/* The largest possible frame header: magic number, descriptor, window size, dictionary id and content size. */
+		static const size_t MAX_FRAME_HEADER_SIZE = 4 + 1 + 1 + 4 + 8;
+
+		while (this->input.size < MAX_FRAME_HEADER_SIZE) {
+			size_t read = this->chain->Read(this->fread_buf + this->input.size, sizeof(this->fread_buf) - this->input.size);
+			if (read == 0) break;
+			this->input.size += read;
+		}
+
+		uint32 id = ZSTD_getDictID_fromFrame(this->fread_buf, this->input.size);
+		if (id == 0) return;
+
+		const ZSTDDictionary &dictionary = GetZSTDDictionary();
+		if (dictionary.id != id) SlError(STR_GAME_SAVELOAD_ERROR_BROKEN_INTERNAL_ERROR, "savegame needs a zstd dictionary that is not available");
+		if (ZSTD_isError(ZSTD_DCtx_refDDict(this->dctx, dictionary.ddict))) SlError(STR_GAME_SAVELOAD_ERROR_BROKEN_INTERNAL_ERROR, "cannot initialize decompressor");
+	}
+
+	size_t Read(byte *buf, size_t size) override
+	{
+		ZSTD_outBuffer output = { buf, size, 0 };
+
+		while (output.pos != output.size && !this->finished) {
+			if (this->input.pos == this->input.size) {
+				this->input.size = this->chain->Read(this->fread_buf, sizeof(this->fread_buf));
+				this->input.pos = 0;
+
+				if (!this->started && this->input.size != 0) {
+					this->SelectDictionary();
+					this->started = true;
+				}
+			}
+
+			size_t pos = output.pos;
+			size_t r = ZSTD_decompressStream(this->dctx, &output, &this->input);
+			if (ZSTD_isError(r)) SlError(STR_GAME_SAVELOAD_ERROR_BROKEN_INTERNAL_ERROR, "libzstd returned error code");
+			if (r == 0) this->finished = true;
+			if (this->input.size == 0 && output.pos == pos && !this->finished) SlErrorCorrupt("Unexpected end of compressed data");
+		}
+
+		return output.pos;
+	}
+};
+
+/** Filter using zstd compression. */
+struct ZSTDSaveFilter : SaveFilter {
+	ZSTD_CCtx *cctx; ///< Stream state that we are writing to.
+
+	/**
+	 * Initialise this filter.
+	 * @param chain             The next filter in this chain.
+	 * @param compression_level The requested level of compression.
+	 */
+	ZSTDSaveFilter(SaveFilter *chain, byte compression_level) : SaveFilter(chain)
+	{
+		this->cctx = ZSTD_createCCtx();
+		if (this->cctx == nullptr ||
+				ZSTD_isError(ZSTD_CCtx_setParameter(this->cctx, ZSTD_c_compressionLevel, compression_level)) ||
+				ZSTD_isError(ZSTD_CCtx_setParameter(this->cctx, ZSTD_c_checksumFlag, 1))) {
+			SlError(STR_GAME_SAVELOAD_ERROR_BROKEN_INTERNAL_ERROR, "cannot initialize compressor");
+		}
+
+		/* The dictionary is digested again for every save, so it is compressed with the requested level.
+		 * Clients joining a server need not have the dictionary, so it is never used for them. */
+		const ZSTDDictionary &dictionary = GetZSTDDictionary();
+		if (dictionary.id != 0 && !_sl.for_network && ZSTD_isError(ZSTD_CCtx_loadDictionary(this->cctx, dictionary.data.data(), dictionary.data.size()))) {
+			SlError(STR_GAME_SAVELOAD_ERROR_BROKEN_INTERNAL_ERROR, "cannot initialize compressor");
+		}
+	}
+
+	/** Clean up what we allocated. */
+	~ZSTDSaveFilter()
+	{
+		ZSTD_freeCCtx(this->cctx);
+	}
+
+	/**
+	 * Helper loop for writing the data.
+	 * @param p    The bytes to write.
+	 * @param len  Amount of bytes to write.
+	 * @param mode Directive for ZSTD_compressStream2.
+	 */
+	void WriteLoop(byte *p, size_t len, ZSTD_EndDirective mode)
+	{
+		byte buf[MEMORY_CHUNK_SIZE]; // output buffer
+		ZSTD_inBuffer input = { p, len, 0 };
+
+		for (;;) {
+			ZSTD_outBuffer output = { buf, sizeof(buf), 0 };
+			size_t r = ZSTD_compressStream2(this->cctx, &output, &input, mode);
+			if (ZSTD_isError(r)) SlError(STR_GAME_SAVELOAD_ERROR_BROKEN_INTERNAL_ERROR, "libzstd returned error code");
+			if (output.pos != 0) this->chain->Write(buf, output.pos);
+
+			/* When ending the frame, r is the amount of data that still has to be flushed. */
+			if (mode == ZSTD_e_end ? r == 0 : input.pos == input.size) break;
+		}
+	}
+
+	void Write(byte *buf, size_t size) override
+	{
+		this->WriteLoop(buf, size, ZSTD_e_continue);
+	}
+
+	void Finish() override
+	{
+		this->WriteLoop(nullptr, 0, ZSTD_e_end);
+		this->chain->Finish();
+	}
+};
+
+#endif /* WITH_ZSTD */
+
 /*******************************************
  ************* END OF CODE *****************
  *******************************************/
@@ -2286,25 +2954,34 @@ struct SaveLoadFormat {
 	byte min_compression;                 ///< the minimum compression level of this format
 	byte default_compression;             ///< the default compression level of this format
 	byte max_compression;                 ///< the maximum compression level of this format
+	bool explicit_only;                   ///< the format is never picked as default, only when it is explicitly chosen
 };
 
 /** The different saveload formats known/understood by OpenTTD. */
 static const SaveLoadFormat _saveload_formats[] = {
 #if defined(WITH_LZO)
 	/* Roughly 75% larger than zlib level 6 at only ~7% of the CPU usage. */
-	{"lzo",    TO_BE32X('OTTD'), CreateLoadFilter<LZOLoadFilter>,    CreateSaveFilter<LZOSaveFilter>,    0, 0, 0},
+	{"lzo",    TO_BE32X('OTTD'), CreateLoadFilter<LZOLoadFilter>,    CreateSaveFilter<LZOSaveFilter>,    0, 0, 0, false},
 #else
-	{"lzo",    TO_BE32X('OTTD'), nullptr,                            nullptr,                            0, 0, 0},
+	{"lzo",    TO_BE32X('OTTD'), nullptr,                            nullptr,                            0, 0, 0, false},
 #endif
 	/* Roughly 5 times larger at only 1% of the CPU usage over zlib level 6. */
-	{"none",   TO_BE32X('OTTN'), CreateLoadFilter<NoCompLoadFilter>, CreateSaveFilter<NoCompSaveFilter>, 0, 0, 0},
+	{"none",   TO_BE32X('OTTN'), CreateLoadFilter<NoCompLoadFilter>, CreateSaveFilter<NoCompSaveFilter>, 0, 0, 0, false},
 #if defined(WITH_ZLIB)
 	/* After level 6 the speed reduction is significant (1.5x to 2.5x slower per level), but the reduction in filesize is
 	 * fairly insignificant (~1% for each step). Lower levels become ~5-10% bigger by each level than level 6 while level
 	 * 1 is "only" 3 times as fast. Level 0 results in uncompressed savegames at about 8 times the cost of "none". */
-	{"zlib",   TO_BE32X('OTTZ'), CreateLoadFilter<ZlibLoadFilter>,   CreateSaveFilter<ZlibSaveFilter>,   0, 6, 9},
+	{"zlib",   TO_BE32X('OTTZ'), CreateLoadFilter<ZlibLoadFilter>,   CreateSaveFilter<ZlibSaveFilter>,   0, 6, 9, false},
+#else
+	{"zlib",   TO_BE32X('OTTZ'), nullptr,                            nullptr,                            0, 0, 0, false},
+#endif
+#if defined(WITH_ZSTD)
+	/* Level 3 compresses about as fast as lzo and results in savegames that are only slightly larger than lzma level 2 ones.
+	 * Higher levels get close to lzma level 6 at the same cost. Levels above 19 need far too much memory to be useful.
+	 * It is never the default, so savegames stay loadable by builds without libzstd unless it is explicitly chosen. */
+	{"zstd",   TO_BE32X('OTTS'), CreateLoadFilter<ZSTDLoadFilter>,   CreateSaveFilter<ZSTDSaveFilter>,   1, 3, 19, true},
 #else
-	{"zlib",   TO_BE32X('OTTZ'), nullptr,                            nullptr,                            0, 0, 0},
+	{"zstd",   TO_BE32X('OTTS'), nullptr,                            nullptr,                            0, 0, 0, true},
 #endif
 #if defined(WITH_LIBLZMA)
 	/* Level 2 compression is speed wise as fast as zlib level 6 compression (old default), but results in ~10% smaller saves.
@@ -2312,9 +2989,12 @@ static const SaveLoadFormat _saveload_formats[] = {
 	 * The next significant reduction in file size is at level 4, but that is already 4 times slower. Level 3 is primarily 50%
 	 * slower while not improving the filesize, while level 0 and 1 are faster, but don't reduce savegame size much.
 	 * It's OTTX and not e.g. OTTL because liblzma is part of xz-utils and .tar.xz is preferred over .tar.lzma. */
-	{"lzma",   TO_BE32X('OTTX'), CreateLoadFilter<LZMALoadFilter>,   CreateSaveFilter<LZMASaveFilter>,   0, 2, 9},
+	{"lzma",   TO_BE32X('OTTX'), CreateLoadFilter<LZMALoadFilter>,   CreateSaveFilter<LZMASaveFilter>,   0, 2, 9, false},
+	/* The same levels as lzma, but the savegame is split into blocks that are compressed in parallel. */
+	{"plzma",  TO_BE32X('OTTP'), CreateLoadFilter<PLZMALoadFilter>,  CreateSaveFilter<PLZMASaveFilter>,  0, 2, 9, true},
 #else
-	{"lzma",   TO_BE32X('OTTX'), nullptr,                            nullptr,                            0, 0, 0},
+	{"lzma",   TO_BE32X('OTTX'), nullptr,                            nullptr,                            0, 0, 0, false},
+	{"plzma",  TO_BE32X('OTTP'), nullptr,                            nullptr,                            0, 0, 0, true},
 #endif
 };
 
@@ -2330,7 +3010,7 @@ static const SaveLoadFormat *GetSavegameFormat(char *s, byte *compression_level)
 	const SaveLoadFormat *def = lastof(_saveload_formats);
 
 	/* find default savegame format, the highest one with which files can be written */
-	while (!def->init_write) def--;
+	while (!def->init_write || def->explicit_only) def--;
 
 	if (!StrEmpty(s)) {
 		/* Get the ":..." of the compression level out of the way */
@@ -2515,14 +3195,18 @@ void WaitTillSaved()
  * using the writer, either in threaded mode if possible, or single-threaded.
  * @param writer   The filter to write the savegame to.
  * @param threaded Whether to try to perform the saving asynchronously.
+ * @param for_network Whether the savegame is sent to clients over the network.
+ * @param incremental Whether chunks that did not change may be copied from the previous incremental save.
  * @return Return the result of the action. #SL_OK or #SL_ERROR
  */
-static SaveOrLoadResult DoSave(SaveFilter *writer, bool threaded)
+static SaveOrLoadResult DoSave(SaveFilter *writer, bool threaded, bool for_network, bool incremental = false)
 {
 	assert(!_sl.saveinprogress);
 
 	_sl.dumper = new MemoryDumper();
 	_sl.sf = writer;
+	_sl.incremental = incremental;
+	_sl.for_network = for_network;
 
 	_sl_version = SAVEGAME_VERSION;
 
@@ -2553,7 +3237,7 @@ SaveOrLoadResult SaveWithFilter(SaveFilter *writer, bool threaded)
 {
 	try {
 		_sl.action = SLA_SAVE;
-		return DoSave(writer, threaded);
+		return DoSave(writer, threaded, true);
 	} catch (...) {
 		ClearSaveLoadState();
 		return SL_ERROR;
@@ -2793,7 +3477,7 @@ SaveOrLoadResult SaveOrLoad(const char *filename, SaveLoadOperation fop, Detaile
 			DEBUG(desync, 1, "save: %08x; %02x; %s", _date, _date_fract, filename);
 			if (_network_server || !_settings_client.gui.threaded_saves) threaded = false;
 
-			return DoSave(new FileWriter(fh), threaded);
+			return DoSave(new FileWriter(fh), threaded, false, _do_autosave && _settings_client.gui.incremental_autosave);
 		}
 
 		/* LOAD game */
@@ -302,6 +302,10 @@ enum SaveLoadVersion : uint16 {
 	SLV_MULTITILE_DOCKS,                    ///< 216  PR#7380 Multiple docks per station.
 	SLV_TRADING_AGE,                        ///< 217  PR#7780 Configurable company trading age.
 	SLV_ENDING_YEAR,                        ///< 218  PR#7747 v1.10 Configurable ending year.
+	SLV_TILE_LOOP_ORDER,                    ///< 219  Selectable order of the tile loop.
+	SLV_YAPF_RAIL_HIERARCHICAL,             ///< 220  Hierarchical rail pathfinding.
+	SLV_ASYNC_PATHFINDING,                  ///< 221  Pathfinder searches ahead of time.
+	SLV_YAPF_SHIP_HIERARCHICAL,             ///< 222  Hierarchical ship pathfinding.
 
 	SL_MAX_VERSION,                         ///< Highest possible saveload version
 };
@@ -485,6 +489,7 @@ enum SaveLoadTypes {
 	SL_STR         =  3, ///< Save/load a string.
 	SL_LST         =  4, ///< Save/load a list.
 	SL_DEQUE       =  5, ///< Save/load a deque.
+	SL_PTRDEQ      =  6, ///< Save/load a deque of references.
 	/* non-normal save-load types */
 	SL_WRITEBYTE   =  8,
 	SL_VEH_INCLUDE =  9,
@@ -587,6 +592,16 @@ typedef SaveLoad SaveLoadGlobVarList;
  */
 #define SLE_CONDDEQUE(base, variable, type, from, to) SLE_GENERAL(SL_DEQUE, base, variable, type, 0, from, to)
 
+/**
+ * Storage of a deque of references in some savegame versions.
+ * @param base     Name of the class or struct containing the deque.
+ * @param variable Name of the variable in the class or struct referenced by \a base.
+ * @param type     Storage of the data in memory and in the savegame.
+ * @param from     First savegame version that has the deque.
+ * @param to       Last savegame version that has the deque.
+ */
+#define SLE_CONDPTRDEQ(base, variable, type, from, to) SLE_GENERAL(SL_PTRDEQ, base, variable, type, 0, from, to)
+
 /**
  * Storage of a variable in every version of a savegame.
  * @param base     Name of the class or struct containing the variable.
@@ -629,6 +644,14 @@ typedef SaveLoad SaveLoadGlobVarList;
  */
 #define SLE_LST(base, variable, type) SLE_CONDLST(base, variable, type, SL_MIN_VERSION, SL_MAX_VERSION)
 
+/**
+ * Storage of a deque of references in every savegame version.
+ * @param base     Name of the class or struct containing the deque.
+ * @param variable Name of the variable in the class or struct referenced by \a base.
+ * @param type     Storage of the data in memory and in the savegame.
+ */
+#define SLE_PTRDEQ(base, variable, type) SLE_CONDPTRDEQ(base, variable, type, SL_MIN_VERSION, SL_MAX_VERSION)
+
 /**
  * Empty space in every savegame version.
  * @param length Length of the empty space.
@@ -710,6 +733,15 @@ typedef SaveLoad SaveLoadGlobVarList;
  */
 #define SLEG_CONDLST(variable, type, from, to) SLEG_GENERAL(SL_LST, variable, type, 0, from, to)
 
+/**
+ * Storage of a global deque of references in some savegame versions.
+ * @param variable Name of the global variable.
+ * @param type     Storage of the data in memory and in the savegame.
+ * @param from     First savegame version that has the deque.
+ * @param to       Last savegame version that has the deque.
+ */
+#define SLEG_CONDPTRDEQ(variable, type, from, to) SLEG_GENERAL(SL_PTRDEQ, variable, type, 0, from, to)
+
 /**
  * Storage of a global variable in every savegame version.
  * @param variable Name of the global variable.
@@ -836,6 +868,7 @@ int SlIterateArray();
 void SlAutolength(AutolengthProc *proc, void *arg);
 size_t SlGetFieldLength();
 void SlSetLength(size_t length);
+bool SlReusePreviousChunk(bool *changed);
 size_t SlCalcObjMemberLength(const void *object, const SaveLoad *sld);
 size_t SlCalcObjLength(const void *object, const SaveLoad *sld);
 
@@ -844,6 +877,7 @@ void SlWriteByte(byte b);
 
 void SlGlobList(const SaveLoadGlobVarList *sldg);
 void SlArray(void *array, size_t length, VarType conv);
+const byte *SlReadDirect(size_t length);
 void SlObject(void *object, const SaveLoad *sld);
 bool SlObjectMember(void *object, const SaveLoad *sld);
 void NORETURN SlError(StringID string, const char *extra_msg = nullptr);
@@ -37,6 +37,17 @@ struct LoadFilter {
 	 */
 	virtual size_t Read(byte *buf, size_t len) = 0;
 
+	/**
+	 * Get direct access to the rest of the savegame, when the filter has it in
+	 * memory as it is. After this, the data counts as read.
+	 * @param[out] len The number of bytes that are accessible.
+	 * @return The data, or \c nullptr when it can only be read with #Read.
+	 */
+	virtual const byte *ReadMapped(size_t *len)
+	{
+		return nullptr;
+	}
+
 	/**
 	 * Reset this filter to read from the beginning of the file.
 	 */
@@ -110,6 +110,7 @@ struct GUISettings {
 	bool   disable_unsuitable_building;      ///< disable infrastructure building when no suitable vehicles are available
 	byte   autosave;                         ///< how often should we do autosaves?
 	bool   threaded_saves;                   ///< should we do threaded saves?
+	bool   incremental_autosave;             ///< should autosaves reuse the data of chunks that did not change since the previous autosave?
 	bool   keep_all_autosave;                ///< name the autosave in a different way
 	bool   autosave_on_exit;                 ///< save an autosave when you quit the game, but do not ask "Do you really want to quit?"
 	bool   autosave_on_network_disconnect;   ///< save an autosave when you get disconnected from a network game with an error?
@@ -243,6 +244,7 @@ struct NetworkSettings {
 	uint16 max_init_time;                                 ///< maximum amount of time, in game ticks, a client may take to initiate joining
 	uint16 max_join_time;                                 ///< maximum amount of time, in game ticks, a client may take to sync up during joining
 	uint16 max_download_time;                             ///< maximum amount of time, in game ticks, a client may take to download the map
+	uint16 map_snapshot_window;                           ///< amount of time, in game ticks, joining clients may share a map snapshot; 0 makes one for every client
 	uint16 max_password_time;                             ///< maximum amount of time, in game ticks, a client may take to enter the password
 	uint16 max_lag_time;                                  ///< maximum amount of time, in game ticks, a client may be lagging behind the server
 	bool   pause_on_join;                                 ///< pause the game when people join
@@ -287,6 +289,7 @@ struct GameCreationSettings {
 	byte   snow_line_height;                 ///< the configured snow line height
 	byte   tgen_smoothness;                  ///< how rough is the terrain from 0-3
 	byte   tree_placer;                      ///< the tree placer algorithm
+	byte   tile_loop_order;                  ///< the order in which the tile loop visits the tiles, see #TileLoopOrder
 	byte   heightmap_rotation;               ///< rotation director for the heightmap
 	byte   se_flat_world_height;             ///< land height a flat world gets in SE
 	byte   town_name;                        ///< the town name generator used for town names
@@ -402,6 +405,7 @@ struct YAPFSettings {
 	uint32 rail_pbs_cross_penalty;           ///< penalty for crossing a reserved tile
 	uint32 rail_pbs_station_penalty;         ///< penalty for crossing a reserved station tile
 	uint32 rail_pbs_signal_back_penalty;     ///< penalty for passing a pbs signal from the backside
+	bool   rail_hierarchical;                ///< first search long distance rail paths over the abstract graph of rail regions
 	uint32 rail_doubleslip_penalty;          ///< penalty for passing a double slip switch
 
 	uint32 rail_longer_platform_penalty;           ///< penalty for longer  station platform than train
@@ -410,6 +414,7 @@ struct YAPFSettings {
 	uint32 rail_shorter_platform_per_tile_penalty; ///< penalty for shorter station platform than train (per tile)
 	uint32 ship_curve45_penalty;                   ///< penalty for 45-deg curve for ships
 	uint32 ship_curve90_penalty;                   ///< penalty for 90-deg curve for ships
+	bool   ship_hierarchical;                      ///< first search long distance ship paths over the abstract graph of water regions
 };
 
 /** Settings related to all pathfinders. */
@@ -429,6 +434,7 @@ struct PathfinderSettings {
 	bool   reserve_paths;                    ///< always reserve paths regardless of signal type.
 	byte   wait_for_pbs_path;                ///< how long to wait for a path reservation.
 	byte   path_backoff_interval;            ///< ticks between checks for a free path.
+	bool   async_pathfinding;                ///< search the paths of vehicles ahead of time on worker threads.
 
 	NPFSettings  npf;                        ///< pathfinder settings for the new pathfinder
 	YAPFSettings yapf;                       ///< pathfinder settings for the yet another pathfinder
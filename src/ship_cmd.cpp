@@ -18,6 +18,8 @@
 #include "station_base.h"
 #include "newgrf_engine.h"
 #include "pathfinder/yapf/yapf.h"
+#include "pathfinder/pathfinder_jobs.h"
+#include "pathfinder/pf_benchmark.h"
 #include "newgrf_sound.h"
 #include "spritecache.h"
 #include "strings_func.h"
@@ -449,6 +451,52 @@ static void ShipArrivesAt(const Vehicle *v, Station *st)
 }
 
 
+static inline TrackBits GetAvailShipTracks(TileIndex tile, DiagDirection dir);
+
+/** Search, ahead of time, for the path a ship needs once it leaves its current tile. */
+class ShipPathJob : public PathfinderJob {
+	VehicleID id;       ///< The ship.
+	TileIndex tile;     ///< Tile the ship is expected to be on when the search runs.
+	Trackdir trackdir;  ///< Trackdir the ship is expected to follow on that tile.
+	ShipPathCache path; ///< The path from the next tile onwards; empty when nothing has been found.
+
+public:
+	ShipPathJob(const Ship *v, TileIndex tile, Trackdir trackdir) : id(v->index), tile(tile), trackdir(trackdir) {}
+
+	void Run() override
+	{
+		const Ship *v = Ship::GetIfValid(this->id);
+		if (v == nullptr || v->dest_tile == 0 || v->tile != this->tile || v->GetVehicleTrackdir() != this->trackdir) return;
+
+		DiagDirection enterdir = TrackdirToExitdir(this->trackdir);
+		TileIndex next = TileAddByDiagDir(this->tile, enterdir);
+		if (!IsValidTile(next)) return;
+
+		TrackBits tracks = GetAvailShipTracks(next, enterdir);
+		if (tracks == TRACK_BIT_NONE) return;
+
+		bool path_found = true;
+		Track track = YapfShipChooseTrack(v, next, enterdir, tracks, path_found, this->path);
+		if (track == INVALID_TRACK || !path_found) {
+			/* Leave handling lost ships to the regular search. */
+			this->path.clear();
+			return;
+		}
+		this->path.push_front(TrackEnterdirToTrackdir(track, enterdir));
+	}
+
+	void Apply() override
+	{
+		if (this->path.empty()) return;
+
+		Ship *v = Ship::Get(this->id);
+		if (!v->path.empty()) return;
+
+		v->path = std::move(this->path);
+		v->HandlePathfindingResult(true);
+	}
+};
+
 /**
  * Runs the pathfinder to choose a track to continue along.
  *
@@ -478,6 +526,11 @@ static Track ChooseShipTrack(Ship *v, TileIndex tile, DiagDirection enterdir, Tr
 
 			if (HasBit(tracks, track)) {
 				v->path.pop_front();
+				/* Extend the cached path while the ship is on its way, instead of when it is needed.
+				 * The tile after an aqueduct head is not the adjacent one, so leave those to the regular search. */
+				if (v->path.empty() && _settings_game.pf.async_pathfinding && _settings_game.pf.pathfinder_for_ships == VPF_YAPF && !IsTileType(tile, MP_TUNNELBRIDGE)) {
+					QueuePathfinderJob(new ShipPathJob(v, tile, TrackEnterdirToTrackdir(track, enterdir)));
+				}
 				/* HandlePathfindResult() is not called here because this is not a new pathfinder result. */
 				return track;
 			}
@@ -486,6 +539,8 @@ static Track ChooseShipTrack(Ship *v, TileIndex tile, DiagDirection enterdir, Tr
 			v->path.clear();
 		}
 
+		if (PfBenchmarkIsRecording()) PfBenchmarkShip(v, tile, enterdir, tracks);
+
 		switch (_settings_game.pf.pathfinder_for_ships) {
 			case VPF_NPF: track = NPFShipChooseTrack(v, path_found); break;
 			case VPF_YAPF: track = YapfShipChooseTrack(v, tile, enterdir, tracks, path_found, v->path); break;
@@ -106,10 +106,12 @@ Station::~Station()
 		LinkGraph *lg = LinkGraph::GetIfValid(this->goods[c].link_graph);
 		if (lg == nullptr) continue;
 
-		for (NodeID node = 0; node < lg->Size(); ++node) {
-			Station *st = Station::Get((*lg)[node].Station());
+		const LinkGraph *clg = lg;
+		for (NodeID node = 0; node < clg->Size(); ++node) {
+			Station *st = Station::Get((*clg)[node].Station());
 			st->goods[c].flows.erase(this->index);
-			if ((*lg)[node][this->goods[c].node].LastUpdate() != INVALID_DATE) {
+			if ((*clg)[node].HasEdgeTo(this->goods[c].node) &&
+					(*clg)[node][this->goods[c].node].LastUpdate() != INVALID_DATE) {
 				st->goods[c].flows.DeleteFlows(this->index);
 				RerouteCargo(st, c, this->index, st->index);
 			}
@@ -18,6 +18,7 @@
 #include "linkgraph/linkgraph_type.h"
 #include "newgrf_storage.h"
 #include "bitmap_type.h"
+#include <list>
 #include <map>
 #include <set>
 
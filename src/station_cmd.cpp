@@ -1414,10 +1414,10 @@ CommandCost CmdBuildRailStation(TileIndex tile_org, DoCommandFlag flags, uint32
 					TriggerStationAnimation(st, tile, SAT_BUILT);
 				}
 
+				YapfNotifyTrackLayoutChange(tile, track);
 				tile += tile_delta;
 			} while (--w);
 			AddTrackToSignalBuffer(tile_track, track, _current_company);
-			YapfNotifyTrackLayoutChange(tile_track, track);
 			tile_track += tile_delta ^ TileDiffXY(1, 1); // perpendicular to tile_delta
 		} while (--numtracks);
 
@@ -3457,6 +3457,44 @@ static void TruncateCargo(const CargoSpec *cs, GoodsEntry *ge, uint amount = UIN
 	}
 }
 
+/** Rating relevant state of the rated goods entries of a station, gathered into contiguous arrays. */
+struct StationRatingInputs {
+	uint count;                        ///< Number of gathered goods entries.
+	const CargoSpec *cs[NUM_CARGO];    ///< Cargo of each gathered goods entry.
+	byte last_speed[NUM_CARGO];        ///< GoodsEntry::last_speed.
+	byte waittime[NUM_CARGO];          ///< GoodsEntry::time_since_pickup.
+	byte last_age[NUM_CARGO];          ///< GoodsEntry::last_age.
+	uint max_waiting_cargo[NUM_CARGO]; ///< GoodsEntry::max_waiting_cargo.
+	int score[NUM_CARGO];              ///< Rating from speed, waiting time and waiting cargo; replaced by the rating callback.
+	int bonus[NUM_CARGO];              ///< Rating from statues and vehicle age; always applied.
+};
+
+/**
+ * Calculate the default rating scores of all gathered goods entries of a station.
+ * This has no branches depending on the goods entry, so the compiler can vectorise it.
+ * @param in Gathered goods entries.
+ * @param ship Whether the last vehicle loading at the station was a ship.
+ * @param statue Whether the owner of the station has a statue in its town.
+ */
+static void CalcStationRatingScores(StationRatingInputs &in, bool ship, bool statue)
+{
+	for (uint i = 0; i < in.count; i++) {
+		int speed = in.last_speed[i] - 85;
+		int rating = speed >= 0 ? speed >> 2 : 0;
+
+		byte waittime = ship ? in.waittime[i] >> 2 : in.waittime[i];
+		rating += (waittime <= 21) * 25 + (waittime <= 12) * 25 + (waittime <= 6) * 45 + (waittime <= 3) * 35;
+
+		rating -= 90;
+		uint waiting = in.max_waiting_cargo[i];
+		rating += (waiting <= 1500) * 55 + (waiting <= 1000) * 35 + (waiting <= 600) * 10 + (waiting <= 300) * 20 + (waiting <= 100) * 10;
+		in.score[i] = rating;
+
+		byte age = in.last_age[i];
+		in.bonus[i] = (statue ? 26 : 0) + (age < 3) * 10 + (age < 2) * 10 + (age < 1) * 13;
+	}
+}
+
 static void UpdateStationRating(Station *st)
 {
 	bool waiting_changed = false;
@@ -3464,142 +3502,133 @@ static void UpdateStationRating(Station *st)
 	byte_inc_sat(&st->time_since_load);
 	byte_inc_sat(&st->time_since_unload);
 
+	/* First gather the state of all rated cargoes and calculate their default
+	 * scores in one go. Everything that may draw random numbers, run callbacks
+	 * or touch other goods entries is done afterwards, in cargo order. */
+	StationRatingInputs in;
+	in.count = 0;
 	const CargoSpec *cs;
 	FOR_ALL_CARGOSPECS(cs) {
 		GoodsEntry *ge = &st->goods[cs->Index()];
-		/* Slowly increase the rating back to his original level in the case we
-		 *  didn't deliver cargo yet to this station. This happens when a bribe
-		 *  failed while you didn't moved that cargo yet to a station. */
-		if (!ge->HasRating() && ge->rating < INITIAL_STATION_RATING) {
-			ge->rating++;
+		if (!ge->HasRating()) {
+			/* Slowly increase the rating back to his original level in the case we
+			 *  didn't deliver cargo yet to this station. This happens when a bribe
+			 *  failed while you didn't moved that cargo yet to a station. */
+			if (ge->rating < INITIAL_STATION_RATING) ge->rating++;
+			continue;
 		}
 
 		/* Only change the rating if we are moving this cargo */
-		if (ge->HasRating()) {
-			byte_inc_sat(&ge->time_since_pickup);
-			if (ge->time_since_pickup == 255 && _settings_game.order.selectgoods) {
-				ClrBit(ge->status, GoodsEntry::GES_RATING);
-				ge->last_speed = 0;
-				TruncateCargo(cs, ge);
-				waiting_changed = true;
-				continue;
-			}
+		byte_inc_sat(&ge->time_since_pickup);
+		uint i = in.count++;
+		in.cs[i] = cs;
+		in.last_speed[i] = ge->last_speed;
+		in.waittime[i] = ge->time_since_pickup;
+		in.last_age[i] = ge->last_age;
+		in.max_waiting_cargo[i] = ge->max_waiting_cargo;
+	}
 
-			bool skip = false;
-			int rating = 0;
-			uint waiting = ge->cargo.AvailableCount();
-
-			/* num_dests is at least 1 if there is any cargo as
-			 * INVALID_STATION is also a destination.
-			 */
-			uint num_dests = (uint)ge->cargo.Packets()->MapSize();
-
-			/* Average amount of cargo per next hop, but prefer solitary stations
-			 * with only one or two next hops. They are allowed to have more
-			 * cargo waiting per next hop.
-			 * With manual cargo distribution waiting_avg = waiting / 2 as then
-			 * INVALID_STATION is the only destination.
-			 */
-			uint waiting_avg = waiting / (num_dests + 1);
-
-			if (HasBit(cs->callback_mask, CBM_CARGO_STATION_RATING_CALC)) {
-				/* Perform custom station rating. If it succeeds the speed, days in transit and
-				 * waiting cargo ratings must not be executed. */
-
-				/* NewGRFs expect last speed to be 0xFF when no vehicle has arrived yet. */
-				uint last_speed = ge->HasVehicleEverTriedLoading() ? ge->last_speed : 0xFF;
-
-				uint32 var18 = min(ge->time_since_pickup, 0xFF) | (min(ge->max_waiting_cargo, 0xFFFF) << 8) | (min(last_speed, 0xFF) << 24);
-				/* Convert to the 'old' vehicle types */
-				uint32 var10 = (st->last_vehicle_type == VEH_INVALID) ? 0x0 : (st->last_vehicle_type + 0x10);
-				uint16 callback = GetCargoCallback(CBID_CARGO_STATION_RATING_CALC, var10, var18, cs);
-				if (callback != CALLBACK_FAILED) {
-					skip = true;
-					rating = GB(callback, 0, 14);
-
-					/* Simulate a 15 bit signed value */
-					if (HasBit(callback, 14)) rating -= 0x4000;
-				}
-			}
+	CalcStationRatingScores(in, st->last_vehicle_type == VEH_SHIP, Company::IsValidID(st->owner) && HasBit(st->town->statues, st->owner));
+
+	for (uint i = 0; i < in.count; i++) {
+		cs = in.cs[i];
+		GoodsEntry *ge = &st->goods[cs->Index()];
+		if (ge->time_since_pickup == 255 && _settings_game.order.selectgoods) {
+			ClrBit(ge->status, GoodsEntry::GES_RATING);
+			ge->last_speed = 0;
+			TruncateCargo(cs, ge);
+			waiting_changed = true;
+			continue;
+		}
 
-			if (!skip) {
-				int b = ge->last_speed - 85;
-				if (b >= 0) rating += b >> 2;
-
-				byte waittime = ge->time_since_pickup;
-				if (st->last_vehicle_type == VEH_SHIP) waittime >>= 2;
-				if (waittime <= 21) rating += 25;
-				if (waittime <= 12) rating += 25;
-				if (waittime <= 6) rating += 45;
-				if (waittime <= 3) rating += 35;
-
-				rating -= 90;
-				if (ge->max_waiting_cargo <= 1500) rating += 55;
-				if (ge->max_waiting_cargo <= 1000) rating += 35;
-				if (ge->max_waiting_cargo <= 600) rating += 10;
-				if (ge->max_waiting_cargo <= 300) rating += 20;
-				if (ge->max_waiting_cargo <= 100) rating += 10;
+		int rating = in.score[i];
+		uint waiting = ge->cargo.AvailableCount();
+
+		/* num_dests is at least 1 if there is any cargo as
+		 * INVALID_STATION is also a destination.
+		 */
+		uint num_dests = (uint)ge->cargo.Packets()->MapSize();
+
+		/* Average amount of cargo per next hop, but prefer solitary stations
+		 * with only one or two next hops. They are allowed to have more
+		 * cargo waiting per next hop.
+		 * With manual cargo distribution waiting_avg = waiting / 2 as then
+		 * INVALID_STATION is the only destination.
+		 */
+		uint waiting_avg = waiting / (num_dests + 1);
+
+		if (HasBit(cs->callback_mask, CBM_CARGO_STATION_RATING_CALC)) {
+			/* Perform custom station rating. If it succeeds the speed, days in transit and
+			 * waiting cargo ratings must not be executed. */
+
+			/* NewGRFs expect last speed to be 0xFF when no vehicle has arrived yet. */
+			uint last_speed = ge->HasVehicleEverTriedLoading() ? ge->last_speed : 0xFF;
+
+			uint32 var18 = min(ge->time_since_pickup, 0xFF) | (min(ge->max_waiting_cargo, 0xFFFF) << 8) | (min(last_speed, 0xFF) << 24);
+			/* Convert to the 'old' vehicle types */
+			uint32 var10 = (st->last_vehicle_type == VEH_INVALID) ? 0x0 : (st->last_vehicle_type + 0x10);
+			uint16 callback = GetCargoCallback(CBID_CARGO_STATION_RATING_CALC, var10, var18, cs);
+			if (callback != CALLBACK_FAILED) {
+				rating = GB(callback, 0, 14);
+
+				/* Simulate a 15 bit signed value */
+				if (HasBit(callback, 14)) rating -= 0x4000;
 			}
+		}
 
-			if (Company::IsValidID(st->owner) && HasBit(st->town->statues, st->owner)) rating += 26;
+		rating += in.bonus[i];
 
-			byte age = ge->last_age;
-			if (age < 3) rating += 10;
-			if (age < 2) rating += 10;
-			if (age < 1) rating += 13;
+		{
+			int or_ = ge->rating; // old rating
 
-			{
-				int or_ = ge->rating; // old rating
+			/* only modify rating in steps of -2, -1, 0, 1 or 2 */
+			ge->rating = rating = or_ + Clamp(Clamp(rating, 0, 255) - or_, -2, 2);
 
-				/* only modify rating in steps of -2, -1, 0, 1 or 2 */
-				ge->rating = rating = or_ + Clamp(Clamp(rating, 0, 255) - or_, -2, 2);
+			/* if rating is <= 64 and more than 100 items waiting on average per destination,
+			 * remove some random amount of goods from the station */
+			if (rating <= 64 && waiting_avg >= 100) {
+				int dec = Random() & 0x1F;
+				if (waiting_avg < 200) dec &= 7;
+				waiting -= (dec + 1) * num_dests;
+				waiting_changed = true;
+			}
 
-				/* if rating is <= 64 and more than 100 items waiting on average per destination,
-				 * remove some random amount of goods from the station */
-				if (rating <= 64 && waiting_avg >= 100) {
-					int dec = Random() & 0x1F;
-					if (waiting_avg < 200) dec &= 7;
-					waiting -= (dec + 1) * num_dests;
+			/* if rating is <= 127 and there are any items waiting, maybe remove some goods. */
+			if (rating <= 127 && waiting != 0) {
+				uint32 r = Random();
+				if (rating <= (int)GB(r, 0, 7)) {
+					/* Need to have int, otherwise it will just overflow etc. */
+					waiting = max((int)waiting - (int)((GB(r, 8, 2) - 1) * num_dests), 0);
 					waiting_changed = true;
 				}
+			}
 
-				/* if rating is <= 127 and there are any items waiting, maybe remove some goods. */
-				if (rating <= 127 && waiting != 0) {
-					uint32 r = Random();
-					if (rating <= (int)GB(r, 0, 7)) {
-						/* Need to have int, otherwise it will just overflow etc. */
-						waiting = max((int)waiting - (int)((GB(r, 8, 2) - 1) * num_dests), 0);
-						waiting_changed = true;
-					}
-				}
+			/* At some point we really must cap the cargo. Previously this
+			 * was a strict 4095, but now we'll have a less strict, but
+			 * increasingly aggressive truncation of the amount of cargo. */
+			static const uint WAITING_CARGO_THRESHOLD  = 1 << 12;
+			static const uint WAITING_CARGO_CUT_FACTOR = 1 <<  6;
+			static const uint MAX_WAITING_CARGO        = 1 << 15;
 
-				/* At some point we really must cap the cargo. Previously this
-				 * was a strict 4095, but now we'll have a less strict, but
-				 * increasingly aggressive truncation of the amount of cargo. */
-				static const uint WAITING_CARGO_THRESHOLD  = 1 << 12;
-				static const uint WAITING_CARGO_CUT_FACTOR = 1 <<  6;
-				static const uint MAX_WAITING_CARGO        = 1 << 15;
+			if (waiting > WAITING_CARGO_THRESHOLD) {
+				uint difference = waiting - WAITING_CARGO_THRESHOLD;
+				waiting -= (difference / WAITING_CARGO_CUT_FACTOR);
 
-				if (waiting > WAITING_CARGO_THRESHOLD) {
-					uint difference = waiting - WAITING_CARGO_THRESHOLD;
-					waiting -= (difference / WAITING_CARGO_CUT_FACTOR);
+				waiting = min(waiting, MAX_WAITING_CARGO);
+				waiting_changed = true;
+			}
 
-					waiting = min(waiting, MAX_WAITING_CARGO);
-					waiting_changed = true;
-				}
+			/* We can't truncate cargo that's already reserved for loading.
+			 * Thus StoredCount() here. */
+			if (waiting_changed && waiting < ge->cargo.AvailableCount()) {
+				/* Feed back the exact own waiting cargo at this station for the
+				 * next rating calculation. */
+				ge->max_waiting_cargo = 0;
 
-				/* We can't truncate cargo that's already reserved for loading.
-				 * Thus StoredCount() here. */
-				if (waiting_changed && waiting < ge->cargo.AvailableCount()) {
-					/* Feed back the exact own waiting cargo at this station for the
-					 * next rating calculation. */
-					ge->max_waiting_cargo = 0;
-
-					TruncateCargo(cs, ge, ge->cargo.AvailableCount() - waiting);
-				} else {
-					/* If the average number per next hop is low, be more forgiving. */
-					ge->max_waiting_cargo = waiting_avg;
-				}
+				TruncateCargo(cs, ge, ge->cargo.AvailableCount() - waiting);
+			} else {
+				/* If the average number per next hop is low, be more forgiving. */
+				ge->max_waiting_cargo = waiting_avg;
 			}
 		}
 	}
@@ -3651,12 +3680,20 @@ void DeleteStaleLinks(Station *from)
 		GoodsEntry &ge = from->goods[c];
 		LinkGraph *lg = LinkGraph::GetIfValid(ge.link_graph);
 		if (lg == nullptr) continue;
-		Node node = (*lg)[ge.node];
-		for (EdgeIterator it(node.Begin()); it != node.End();) {
-			Edge edge = it->second;
-			Station *to = Station::Get((*lg)[it->first].Station());
-			assert(to->goods[c].node == it->first);
-			++it; // Do that before removing the edge. Anything else may crash.
+		/* Only read through clg, so the edges stay shared with running jobs
+		 * unless they are actually modified. */
+		const LinkGraph *clg = lg;
+		/* Refreshing links below may add nodes and edges, which moves the
+		 * edges around. Remember the destinations to check beforehand. */
+		std::vector<NodeID> to_nodes;
+		ConstNode from_node = (*clg)[ge.node];
+		for (ConstEdgeIterator it(from_node.Begin()); it != from_node.End(); ++it) {
+			to_nodes.push_back(it->first);
+		}
+		for (NodeID to_node : to_nodes) {
+			ConstEdge edge = (*clg)[ge.node][to_node];
+			Station *to = Station::Get((*clg)[to_node].Station());
+			assert(to->goods[c].node == to_node);
 			assert(_date >= edge.LastUpdate());
 			uint timeout = LinkGraph::MIN_TIMEOUT_DISTANCE + (DistanceManhattan(from->xy, to->xy) >> 3);
 			if ((uint)(_date - edge.LastUpdate()) > timeout) {
@@ -3688,7 +3725,7 @@ void DeleteStaleLinks(Station *from)
 						Vehicle *v = *iter;
 
 						LinkRefresher::Run(v, false); // Don't allow merging. Otherwise lg might get deleted.
-						if (edge.LastUpdate() == _date) {
+						if ((*clg)[ge.node][to_node].LastUpdate() == _date) {
 							updated = true;
 							break;
 						}
@@ -3707,16 +3744,16 @@ void DeleteStaleLinks(Station *from)
 
 				if (!updated) {
 					/* If it's still considered dead remove it. */
-					node.RemoveEdge(to->goods[c].node);
+					(*lg)[ge.node].RemoveEdge(to_node);
 					ge.flows.DeleteFlows(to->index);
 					RerouteCargo(from, c, to->index, from->index);
 				}
 			} else if (edge.LastUnrestrictedUpdate() != INVALID_DATE && (uint)(_date - edge.LastUnrestrictedUpdate()) > timeout) {
-				edge.Restrict();
+				(*lg)[ge.node][to_node].Restrict();
 				ge.flows.RestrictFlows(to->index);
 				RerouteCargo(from, c, to->index, from->index);
 			} else if (edge.LastRestrictedUpdate() != INVALID_DATE && (uint)(_date - edge.LastRestrictedUpdate()) > timeout) {
-				edge.Release();
+				(*lg)[ge.node][to_node].Release();
 			}
 		}
 		assert(_date >= lg->LastCompression());
@@ -9,11 +9,16 @@
 
 #include "stdafx.h"
 #include <math.h>
+#include <vector>
 #include "clear_map.h"
 #include "void_map.h"
 #include "genworld.h"
 #include "core/random_func.hpp"
 #include "landscape_type.h"
+#include "worker_pool.h"
+#include "tgp_kernels.h"
+#include "tgp.h"
+#include <chrono>
 
 #include "safeguards.h"
 
@@ -179,6 +184,15 @@ struct HeightMap
 	{
 		return h[x + y * dim_x];
 	}
+
+	/**
+	 * Get the size of the shortest side of the height map.
+	 * @return The logarithm of the shortest side.
+	 */
+	inline uint LogMinSize() const
+	{
+		return FindFirstBit(min(size_x, size_y));
+	}
 };
 
 /** Global height map instance */
@@ -201,6 +215,128 @@ static HeightMap _height_map = {nullptr, 0, 0, 0, 0};
 /** Walk through all items of _height_map.h */
 #define FOR_ALL_TILES_IN_HEIGHT(h) for (h = _height_map.h; h < &_height_map.h[_height_map.total_size]; h++)
 
+/** Number of rows (or columns) of the height map handled by a single job of the worker pool. */
+static const int HEIGHT_MAP_ROWS_PER_JOB = 32;
+/** Width and height of the blocks #HeightMapSmoothSlopes processes in parallel. */
+static const int SMOOTH_SLOPES_BLOCK_SIZE = 128;
+
+/**
+ * Get the number of jobs #HeightMapParallel splits the given number of rows into.
+ * @param count Number of rows.
+ * @return Number of jobs.
+ */
+static inline uint HeightMapJobCount(int count)
+{
+	return count > 0 ? CeilDiv(count, HEIGHT_MAP_ROWS_PER_JOB) : 0;
+}
+
+/**
+ * Process rows [0, count) of the height map in parallel on the worker pool.
+ * The split into jobs only depends on \a count, so per job results can be
+ * combined in job order to get the same result on any number of threads.
+ * @param count Number of rows.
+ * @param func Function called with the job number, the first row and one past the last row of the job.
+ */
+template <typename Tfunc>
+static void HeightMapParallel(int count, Tfunc func)
+{
+	WorkerPool::Run(HeightMapJobCount(count), [count, &func](uint job) {
+		int first = job * HEIGHT_MAP_ROWS_PER_JOB;
+		func(job, first, min(first + HEIGHT_MAP_ROWS_PER_JOB, count));
+	});
+}
+
+/**
+ * Store the average of two rows of heights, rounded towards zero.
+ * @param dst Row to write.
+ * @param a First row to average.
+ * @param b Second row to average.
+ * @param count Number of heights in the rows.
+ */
+static void TgpAverageRows(int16 *dst, const int16 *a, const int16 *b, int count)
+{
+	for (int i = 0; i < count; i++) dst[i] = (a[i] + b[i]) / 2;
+}
+
+/**
+ * Update the minimum, maximum and sum of heights with a row of heights.
+ * @param h The row of heights.
+ * @param count Number of heights in the row.
+ * @param[in,out] h_min The minimum height.
+ * @param[in,out] h_max The maximum height.
+ * @param[in,out] h_accu The sum of the heights.
+ */
+static void TgpMinMaxSum(const int16 *h, int count, int16 *h_min, int16 *h_max, int64 *h_accu)
+{
+	for (int i = 0; i < count; i++) {
+		if (h[i] < *h_min) *h_min = h[i];
+		if (h[i] > *h_max) *h_max = h[i];
+		*h_accu += h[i];
+	}
+}
+
+/**
+ * Rescale a row of heights from water_level..h_max into sea_level..h_max_new, clamped to 0..h_max_new - 1.
+ * @param h The row of heights.
+ * @param count Number of heights in the row.
+ * @param water_level The height that becomes sea level.
+ * @param h_max The old maximum height.
+ * @param h_max_new The new maximum height.
+ * @param sea_level The sea level.
+ */
+static void TgpRescale(int16 *h, int count, int water_level, int h_max, int h_max_new, int sea_level)
+{
+	for (int i = 0; i < count; i++) {
+		int16 v = (int16)(h_max_new * (h[i] - water_level) / (h_max - water_level)) + sea_level;
+		if (v < 0) v = 0;
+		if (v >= h_max_new) v = h_max_new - 1;
+		h[i] = v;
+	}
+}
+
+/** This fallback kernel checker always exists. */
+static bool TgpKernelsChecker()
+{
+	return true;
+}
+
+/** A set of row kernels, all giving the same results as the plain ones. */
+struct TgpKernels {
+	const char *name;               ///< Name of the set, for the benchmark.
+	TgpKernelChecker checker;       ///< The check function.
+	TgpAverageRowsProc average_rows; ///< Kernel averaging two rows.
+	TgpMinMaxSumProc min_max_sum;   ///< Kernel for the minimum, maximum and sum of a row.
+	TgpRescaleProc rescale;         ///< Kernel rescaling a row for the water level.
+	bool lookup_tables;             ///< Whether the sine transform and curve maps go through lookup tables; only the reference for the benchmark does without.
+};
+
+/** List of kernel sets ordered from best to worst. */
+static const TgpKernels _tgp_kernel_sets[] = {
+#ifdef WITH_SSE
+	{ "SSE2", &TgpKernelsSSE2Checker, &TgpAverageRowsSSE2, &TgpMinMaxSumSSE2, &TgpRescaleSSE2, true },
+#endif
+	{ "plain", &TgpKernelsChecker, &TgpAverageRows, &TgpMinMaxSum, &TgpRescale, true },
+	/* The transforms per tile, like before there were lookup tables; never chosen for generating. */
+	{ "reference", &TgpKernelsChecker, &TgpAverageRows, &TgpMinMaxSum, &TgpRescale, false },
+};
+
+/** The kernels used for generating; chosen by #InitializeTgpKernels. */
+static const TgpKernels *_tgp_kernels = nullptr;
+
+/** Choose the "best" set of kernels and set _tgp_kernels. */
+static void InitializeTgpKernels()
+{
+	if (_tgp_kernels != nullptr) return;
+
+	for (uint i = 0; i < lengthof(_tgp_kernel_sets); i++) {
+		if (_tgp_kernel_sets[i].checker()) {
+			_tgp_kernels = &_tgp_kernel_sets[i];
+			break;
+		}
+	}
+	assert(_tgp_kernels != nullptr);
+}
+
 /** Maximum number of TGP noise frequencies. */
 static const int MAX_TGP_FREQUENCIES = 10;
 
@@ -218,7 +354,7 @@ static height_t TGPGetMaxHeight()
 	/**
 	 * Desired maximum height - indexed by:
 	 *  - _settings_game.difficulty.terrain_type
-	 *  - min(MapLogX(), MapLogY()) - MIN_MAP_SIZE_BITS
+	 *  - the logarithm of the shortest side of the height map - MIN_MAP_SIZE_BITS
 	 *
 	 * It is indexed by map size as well as terrain type since the map size limits the height of
 	 * a usable mountain. For example, on a 64x64 map a 24 high single peak mountain (as if you
@@ -234,7 +370,7 @@ static height_t TGPGetMaxHeight()
 		{  12,  19,  25,  31,  67,  75,  87 }, ///< Alpinist
 	};
 
-	int max_height_from_table = max_height[_settings_game.difficulty.terrain_type][min(MapLogX(), MapLogY()) - MIN_MAP_SIZE_BITS];
+	int max_height_from_table = max_height[_settings_game.difficulty.terrain_type][_height_map.LogMinSize() - MIN_MAP_SIZE_BITS];
 	return I2H(min(max_height_from_table, _settings_game.construction.max_heightlevel));
 }
 
@@ -298,15 +434,17 @@ static inline bool IsValidXY(int x, int y)
 
 
 /**
- * Allocate array of (MapSizeX()+1)*(MapSizeY()+1) heights and init the _height_map structure members
+ * Allocate array of (size_x+1)*(size_y+1) heights and init the _height_map structure members
+ * @param size_x The size of the map along the X axis, usually MapSizeX().
+ * @param size_y The size of the map along the Y axis, usually MapSizeY().
  * @return true on success
  */
-static inline bool AllocHeightMap()
+static inline bool AllocHeightMap(uint size_x, uint size_y)
 {
 	height_t *h;
 
-	_height_map.size_x = MapSizeX();
-	_height_map.size_y = MapSizeY();
+	_height_map.size_x = size_x;
+	_height_map.size_y = size_y;
 
 	/* Allocate memory block for height map row pointers */
 	_height_map.total_size = (_height_map.size_x + 1) * (_height_map.size_y + 1);
@@ -349,7 +487,7 @@ static void HeightMapGenerate()
 	/* Trying to apply noise to uninitialized height map */
 	assert(_height_map.h != nullptr);
 
-	int start = max(MAX_TGP_FREQUENCIES - (int)min(MapLogX(), MapLogY()), 0);
+	int start = max(MAX_TGP_FREQUENCIES - (int)_height_map.LogMinSize(), 0);
 	bool first = true;
 
 	for (int frequency = start; frequency < MAX_TGP_FREQUENCIES; frequency++) {
@@ -375,24 +513,33 @@ static void HeightMapGenerate()
 
 		/* It is regular iteration round.
 		 * Interpolate height values at odd x, even y tiles */
-		for (int y = 0; y <= _height_map.size_y; y += 2 * step) {
-			for (int x = 0; x <= _height_map.size_x - 2 * step; x += 2 * step) {
-				height_t h00 = _height_map.height(x + 0 * step, y);
-				height_t h02 = _height_map.height(x + 2 * step, y);
-				height_t h01 = (h00 + h02) / 2;
-				_height_map.height(x + 1 * step, y) = h01;
+		HeightMapParallel(_height_map.size_y / (2 * step) + 1, [step](uint, int first, int last) {
+			for (int y = first * 2 * step; y < last * 2 * step; y += 2 * step) {
+				for (int x = 0; x <= _height_map.size_x - 2 * step; x += 2 * step) {
+					height_t h00 = _height_map.height(x + 0 * step, y);
+					height_t h02 = _height_map.height(x + 2 * step, y);
+					height_t h01 = (h00 + h02) / 2;
+					_height_map.height(x + 1 * step, y) = h01;
+				}
 			}
-		}
-
-		/* Interpolate height values at odd y tiles */
-		for (int y = 0; y <= _height_map.size_y - 2 * step; y += 2 * step) {
-			for (int x = 0; x <= _height_map.size_x; x += step) {
-				height_t h00 = _height_map.height(x, y + 0 * step);
-				height_t h20 = _height_map.height(x, y + 2 * step);
-				height_t h10 = (h00 + h20) / 2;
-				_height_map.height(x, y + 1 * step) = h10;
+		});
+
+		/* Interpolate height values at odd y tiles; every job only writes the rows between two of the interpolated rows */
+		HeightMapParallel((_height_map.size_y - 2 * step) / (2 * step) + 1, [step](uint, int first, int last) {
+			for (int y = first * 2 * step; y < last * 2 * step; y += 2 * step) {
+				if (step == 1) {
+					/* The whole row is interpolated, so it can be done in one go. */
+					_tgp_kernels->average_rows(&_height_map.height(0, y + 1), &_height_map.height(0, y), &_height_map.height(0, y + 2), _height_map.dim_x);
+					continue;
+				}
+				for (int x = 0; x <= _height_map.size_x; x += step) {
+					height_t h00 = _height_map.height(x, y + 0 * step);
+					height_t h20 = _height_map.height(x, y + 2 * step);
+					height_t h10 = (h00 + h20) / 2;
+					_height_map.height(x, y + 1 * step) = h10;
+				}
 			}
-		}
+		});
 
 		/* Add noise for next higher frequency (smaller steps) */
 		for (int y = 0; y <= _height_map.size_y; y += step) {
@@ -406,15 +553,32 @@ static void HeightMapGenerate()
 /** Returns min, max and average height from height map */
 static void HeightMapGetMinMaxAvg(height_t *min_ptr, height_t *max_ptr, height_t *avg_ptr)
 {
-	height_t h_min, h_max, h_avg, *h;
+	/** Partial results of a single job. */
+	struct MinMaxAccu {
+		height_t h_min, h_max;
+		int64 h_accu;
+	};
+
+	const int rows = _height_map.size_y + 1;
+	std::vector<MinMaxAccu> partial(HeightMapJobCount(rows));
+
+	/* Get h_min, h_max and accumulate heights into h_accu per job */
+	HeightMapParallel(rows, [&partial](uint job, int first, int last) {
+		MinMaxAccu &p = partial[job];
+		p.h_min = p.h_max = _height_map.height(0, first);
+		p.h_accu = 0;
+		for (int y = first; y < last; y++) {
+			_tgp_kernels->min_max_sum(&_height_map.height(0, y), _height_map.dim_x, &p.h_min, &p.h_max, &p.h_accu);
+		}
+	});
+
+	height_t h_min, h_max, h_avg;
 	int64 h_accu = 0;
 	h_min = h_max = _height_map.height(0, 0);
-
-	/* Get h_min, h_max and accumulate heights into h_accu */
-	FOR_ALL_TILES_IN_HEIGHT(h) {
-		if (*h < h_min) h_min = *h;
-		if (*h > h_max) h_max = *h;
-		h_accu += *h;
+	for (const MinMaxAccu &p : partial) {
+		h_min = min(h_min, p.h_min);
+		h_max = max(h_max, p.h_max);
+		h_accu += p.h_accu;
 	}
 
 	/* Get average height */
@@ -430,92 +594,128 @@ static void HeightMapGetMinMaxAvg(height_t *min_ptr, height_t *max_ptr, height_t
 static int *HeightMapMakeHistogram(height_t h_min, height_t h_max, int *hist_buf)
 {
 	int *hist = hist_buf - h_min;
-	height_t *h;
+	const int rows = _height_map.size_y + 1;
+	const int range = h_max - h_min + 1;
+	std::vector<int> partial(HeightMapJobCount(rows) * range);
+
+	/* Count the heights per job */
+	HeightMapParallel(rows, [&partial, h_min, h_max, range](uint job, int first, int last) {
+		int *part = partial.data() + job * range - h_min;
+		for (const height_t *h = &_height_map.height(0, first); h < &_height_map.height(0, last); h++) {
+			assert(*h >= h_min);
+			assert(*h <= h_max);
+			part[*h]++;
+		}
+	});
 
-	/* Count the heights and fill the histogram */
-	FOR_ALL_TILES_IN_HEIGHT(h) {
-		assert(*h >= h_min);
-		assert(*h <= h_max);
-		hist[*h]++;
+	/* Fill the histogram */
+	for (size_t i = 0; i < partial.size(); i++) {
+		hist_buf[i % range] += partial[i];
 	}
 	return hist;
 }
 
+/**
+ * Apply the sine wave redistribution to a single height.
+ * @param h The height to transform, at least \a h_min.
+ * @param h_min The lowest height to transform.
+ * @param h_max The highest height.
+ * @return The transformed height.
+ */
+static height_t SineTransformHeight(height_t h, height_t h_min, height_t h_max)
+{
+	/* Transform height into 0..1 space */
+	double fheight = (double)(h - h_min) / (double)(h_max - h_min);
+	/* Apply sine transform depending on landscape type */
+	switch (_settings_game.game_creation.landscape) {
+		case LT_TOYLAND:
+		case LT_TEMPERATE:
+			/* Move and scale 0..1 into -1..+1 */
+			fheight = 2 * fheight - 1;
+			/* Sine transform */
+			fheight = sin(fheight * M_PI_2);
+			/* Transform it back from -1..1 into 0..1 space */
+			fheight = 0.5 * (fheight + 1);
+			break;
+
+		case LT_ARCTIC:
+			{
+				/* Arctic terrain needs special height distribution.
+				 * Redistribute heights to have more tiles at highest (75%..100%) range */
+				double sine_upper_limit = 0.75;
+				double linear_compression = 2;
+				if (fheight >= sine_upper_limit) {
+					/* Over the limit we do linear compression up */
+					fheight = 1.0 - (1.0 - fheight) / linear_compression;
+				} else {
+					double m = 1.0 - (1.0 - sine_upper_limit) / linear_compression;
+					/* Get 0..sine_upper_limit into -1..1 */
+					fheight = 2.0 * fheight / sine_upper_limit - 1.0;
+					/* Sine wave transform */
+					fheight = sin(fheight * M_PI_2);
+					/* Get -1..1 back to 0..(1 - (1 - sine_upper_limit) / linear_compression) == 0.0..m */
+					fheight = 0.5 * (fheight + 1.0) * m;
+				}
+			}
+			break;
+
+		case LT_TROPIC:
+			{
+				/* Desert terrain needs special height distribution.
+				 * Half of tiles should be at lowest (0..25%) heights */
+				double sine_lower_limit = 0.5;
+				double linear_compression = 2;
+				if (fheight <= sine_lower_limit) {
+					/* Under the limit we do linear compression down */
+					fheight = fheight / linear_compression;
+				} else {
+					double m = sine_lower_limit / linear_compression;
+					/* Get sine_lower_limit..1 into -1..1 */
+					fheight = 2.0 * ((fheight - sine_lower_limit) / (1.0 - sine_lower_limit)) - 1.0;
+					/* Sine wave transform */
+					fheight = sin(fheight * M_PI_2);
+					/* Get -1..1 back to (sine_lower_limit / linear_compression)..1.0 */
+					fheight = 0.5 * ((1.0 - m) * fheight + (1.0 + m));
+				}
+			}
+			break;
+
+		default:
+			NOT_REACHED();
+			break;
+	}
+	/* Transform it back into h_min..h_max space */
+	h = (height_t)(fheight * (h_max - h_min) + h_min);
+	if (h < 0) h = I2H(0);
+	if (h >= h_max) h = h_max - 1;
+	return h;
+}
+
 /** Applies sine wave redistribution onto height map */
 static void HeightMapSineTransform(height_t h_min, height_t h_max)
 {
-	height_t *h;
+	if (!_tgp_kernels->lookup_tables) {
+		HeightMapParallel(_height_map.size_y + 1, [h_min, h_max](uint, int first, int last) {
+			for (height_t *h = &_height_map.height(0, first); h < &_height_map.height(0, last); h++) {
+				if (*h >= h_min) *h = SineTransformHeight(*h, h_min, h_max);
+			}
+		});
+		return;
+	}
 
-	FOR_ALL_TILES_IN_HEIGHT(h) {
-		double fheight;
-
-		if (*h < h_min) continue;
-
-		/* Transform height into 0..1 space */
-		fheight = (double)(*h - h_min) / (double)(h_max - h_min);
-		/* Apply sine transform depending on landscape type */
-		switch (_settings_game.game_creation.landscape) {
-			case LT_TOYLAND:
-			case LT_TEMPERATE:
-				/* Move and scale 0..1 into -1..+1 */
-				fheight = 2 * fheight - 1;
-				/* Sine transform */
-				fheight = sin(fheight * M_PI_2);
-				/* Transform it back from -1..1 into 0..1 space */
-				fheight = 0.5 * (fheight + 1);
-				break;
-
-			case LT_ARCTIC:
-				{
-					/* Arctic terrain needs special height distribution.
-					 * Redistribute heights to have more tiles at highest (75%..100%) range */
-					double sine_upper_limit = 0.75;
-					double linear_compression = 2;
-					if (fheight >= sine_upper_limit) {
-						/* Over the limit we do linear compression up */
-						fheight = 1.0 - (1.0 - fheight) / linear_compression;
-					} else {
-						double m = 1.0 - (1.0 - sine_upper_limit) / linear_compression;
-						/* Get 0..sine_upper_limit into -1..1 */
-						fheight = 2.0 * fheight / sine_upper_limit - 1.0;
-						/* Sine wave transform */
-						fheight = sin(fheight * M_PI_2);
-						/* Get -1..1 back to 0..(1 - (1 - sine_upper_limit) / linear_compression) == 0.0..m */
-						fheight = 0.5 * (fheight + 1.0) * m;
-					}
-				}
-				break;
-
-			case LT_TROPIC:
-				{
-					/* Desert terrain needs special height distribution.
-					 * Half of tiles should be at lowest (0..25%) heights */
-					double sine_lower_limit = 0.5;
-					double linear_compression = 2;
-					if (fheight <= sine_lower_limit) {
-						/* Under the limit we do linear compression down */
-						fheight = fheight / linear_compression;
-					} else {
-						double m = sine_lower_limit / linear_compression;
-						/* Get sine_lower_limit..1 into -1..1 */
-						fheight = 2.0 * ((fheight - sine_lower_limit) / (1.0 - sine_lower_limit)) - 1.0;
-						/* Sine wave transform */
-						fheight = sin(fheight * M_PI_2);
-						/* Get -1..1 back to (sine_lower_limit / linear_compression)..1.0 */
-						fheight = 0.5 * ((1.0 - m) * fheight + (1.0 + m));
-					}
-				}
-				break;
+	/* The result only depends on the height, so transform every occurring height once. */
+	height_t h_top;
+	HeightMapGetMinMaxAvg(nullptr, &h_top, nullptr);
+	std::vector<height_t> transformed(max(h_top - h_min + 1, 0));
+	for (int i = 0; i < (int)transformed.size(); i++) {
+		transformed[i] = SineTransformHeight(h_min + i, h_min, h_max);
+	}
 
-			default:
-				NOT_REACHED();
-				break;
+	HeightMapParallel(_height_map.size_y + 1, [h_min, &transformed](uint, int first, int last) {
+		for (height_t *h = &_height_map.height(0, first); h < &_height_map.height(0, last); h++) {
+			if (*h >= h_min) *h = transformed[*h - h_min];
 		}
-		/* Transform it back into h_min..h_max space */
-		*h = (height_t)(fheight * (h_max - h_min) + h_min);
-		if (*h < 0) *h = I2H(0);
-		if (*h >= h_max) *h = h_max - 1;
-	}
+	});
 }
 
 /**
@@ -563,9 +763,6 @@ static void HeightMapCurves(uint level)
 		{ lengthof(curve_map_4), curve_map_4 },
 	};
 
-	height_t ht[lengthof(curve_maps)];
-	MemSetT(ht, 0, lengthof(ht));
-
 	/* Set up a grid to choose curve maps based on location; attempt to get a somewhat square grid */
 	float factor = sqrt((float)_height_map.size_x / (float)_height_map.size_y);
 	uint sx = Clamp((int)(((1 << level) * factor) + 0.5), 1, 128);
@@ -576,88 +773,91 @@ static void HeightMapCurves(uint level)
 		c[i] = Random() % lengthof(curve_maps);
 	}
 
-	/* Apply curves */
-	for (int x = 0; x < _height_map.size_x; x++) {
-
-		/* Get our X grid positions and bi-linear ratio */
-		float fx = (float)(sx * x) / _height_map.size_x + 1.0f;
-		uint x1 = (uint)fx;
-		uint x2 = x1;
-		float xr = 2.0f * (fx - x1) - 1.0f;
-		xr = sin(xr * M_PI_2);
-		xr = sin(xr * M_PI_2);
-		xr = 0.5f * (xr + 1.0f);
-		float xri = 1.0f - xr;
-
-		if (x1 > 0) {
-			x1--;
-			if (x2 >= sx) x2--;
+	/** Position on the curve map grid along one axis, with the bi-linear ratio. */
+	struct grid_pos_t {
+		uint p1;  ///< The first grid position.
+		uint p2;  ///< The second grid position.
+		float r;  ///< The weight of the second grid position.
+		float ri; ///< The weight of the first grid position.
+	};
+
+	auto grid_pos = [](uint s, int i, int size) -> grid_pos_t {
+		/* Get our grid position and bi-linear ratio */
+		float f = (float)(s * i) / size + 1.0f;
+		uint p1 = (uint)f;
+		uint p2 = p1;
+		float r = 2.0f * (f - p1) - 1.0f;
+		r = sin(r * M_PI_2);
+		r = sin(r * M_PI_2);
+		r = 0.5f * (r + 1.0f);
+
+		if (p1 > 0) {
+			p1--;
+			if (p2 >= s) p2--;
 		}
 
-		for (int y = 0; y < _height_map.size_y; y++) {
-
-			/* Get our Y grid position and bi-linear ratio */
-			float fy = (float)(sy * y) / _height_map.size_y + 1.0f;
-			uint y1 = (uint)fy;
-			uint y2 = y1;
-			float yr = 2.0f * (fy - y1) - 1.0f;
-			yr = sin(yr * M_PI_2);
-			yr = sin(yr * M_PI_2);
-			yr = 0.5f * (yr + 1.0f);
-			float yri = 1.0f - yr;
-
-			if (y1 > 0) {
-				y1--;
-				if (y2 >= sy) y2--;
-			}
+		return { p1, p2, r, 1.0f - r };
+	};
 
-			uint corner_a = c[x1 + sx * y1];
-			uint corner_b = c[x1 + sx * y2];
-			uint corner_c = c[x2 + sx * y1];
-			uint corner_d = c[x2 + sx * y2];
-
-			/* Bitmask of which curve maps are chosen, so that we do not bother
-			 * calculating a curve which won't be used. */
-			uint corner_bits = 0;
-			corner_bits |= 1 << corner_a;
-			corner_bits |= 1 << corner_b;
-			corner_bits |= 1 << corner_c;
-			corner_bits |= 1 << corner_d;
-
-			height_t *h = &_height_map.height(x, y);
-
-			/* Do not touch sea level */
-			if (*h < I2H(1)) continue;
-
-			/* Only scale above sea level */
-			*h -= I2H(1);
-
-			/* Apply all curve maps that are used on this tile. */
-			for (uint t = 0; t < lengthof(curve_maps); t++) {
-				if (!HasBit(corner_bits, t)) continue;
-
-				bool found = false;
-				const control_point_t *cm = curve_maps[t].list;
-				for (uint i = 0; i < curve_maps[t].length - 1; i++) {
-					const control_point_t &p1 = cm[i];
-					const control_point_t &p2 = cm[i + 1];
-
-					if (*h >= p1.x && *h < p2.x) {
-						ht[t] = p1.y + (*h - p1.x) * (p2.y - p1.y) / (p2.x - p1.x);
-						found = true;
-						break;
-					}
-				}
-				assert(found);
-			}
+	auto apply_curve = [&curve_maps](uint t, height_t h) -> height_t {
+		const control_point_t *cm = curve_maps[t].list;
+		for (uint i = 0; i < curve_maps[t].length - 1; i++) {
+			const control_point_t &p1 = cm[i];
+			const control_point_t &p2 = cm[i + 1];
 
-			/* Apply interpolation of curve map results. */
-			*h = (height_t)((ht[corner_a] * yri + ht[corner_b] * yr) * xri + (ht[corner_c] * yri + ht[corner_d] * yr) * xr);
+			if (h >= p1.x && h < p2.x) return p1.y + (h - p1.x) * (p2.y - p1.y) / (p2.x - p1.x);
+		}
+		NOT_REACHED();
+	};
 
-			/* Readd sea level */
-			*h += I2H(1);
+	/* The grid positions only depend on either X or Y, so determine them once per row and column.
+	 * The curve maps only depend on the height, so apply them once for every height above sea level. */
+	const bool lookup = _tgp_kernels->lookup_tables;
+	std::vector<grid_pos_t> grid_x;
+	std::vector<grid_pos_t> grid_y;
+	std::vector<height_t> curves[lengthof(curve_maps)];
+	if (lookup) {
+		for (int x = 0; x < _height_map.size_x; x++) grid_x.push_back(grid_pos(sx, x, _height_map.size_x));
+		for (int y = 0; y < _height_map.size_y; y++) grid_y.push_back(grid_pos(sy, y, _height_map.size_y));
+		for (uint t = 0; t < lengthof(curve_maps); t++) {
+			for (height_t h = 0; h < mh; h++) curves[t].push_back(apply_curve(t, h));
 		}
 	}
+
+	/* Apply curves */
+	HeightMapParallel(_height_map.size_y, [&](uint, int first, int last) {
+		for (int y = first; y < last; y++) {
+			const grid_pos_t gy = lookup ? grid_y[y] : grid_pos(sy, y, _height_map.size_y);
+
+			for (int x = 0; x < _height_map.size_x; x++) {
+				const grid_pos_t gx = lookup ? grid_x[x] : grid_pos(sx, x, _height_map.size_x);
+
+				uint corner_a = c[gx.p1 + sx * gy.p1];
+				uint corner_b = c[gx.p1 + sx * gy.p2];
+				uint corner_c = c[gx.p2 + sx * gy.p1];
+				uint corner_d = c[gx.p2 + sx * gy.p2];
+
+				height_t *h = &_height_map.height(x, y);
+
+				/* Do not touch sea level */
+				if (*h < I2H(1)) continue;
+
+				/* Only scale above sea level */
+				*h -= I2H(1);
+				assert(*h < mh);
+
+				/* Apply interpolation of curve map results. */
+				if (lookup) {
+					*h = (height_t)((curves[corner_a][*h] * gy.ri + curves[corner_b][*h] * gy.r) * gx.ri + (curves[corner_c][*h] * gy.ri + curves[corner_d][*h] * gy.r) * gx.r);
+				} else {
+					*h = (height_t)((apply_curve(corner_a, *h) * gy.ri + apply_curve(corner_b, *h) * gy.r) * gx.ri + (apply_curve(corner_c, *h) * gy.ri + apply_curve(corner_d, *h) * gy.r) * gx.r);
+				}
+
+				/* Readd sea level */
+				*h += I2H(1);
+			}
+		}
+	});
 }
 
 /** Adjusts heights in height map to contain required amount of water tiles */
@@ -665,7 +865,6 @@ static void HeightMapAdjustWaterLevel(amplitude_t water_percent, height_t h_max_
 {
 	height_t h_min, h_max, h_avg, h_water_level;
 	int64 water_tiles, desired_water_tiles;
-	height_t *h;
 	int *hist;
 
 	HeightMapGetMinMaxAvg(&h_min, &h_max, &h_avg);
@@ -690,13 +889,13 @@ static void HeightMapAdjustWaterLevel(amplitude_t water_percent, height_t h_max_
 	 *   values from range: h_water_level..h_max are transformed into 0..h_max_new
 	 *   where h_max_new is depending on terrain type and map size.
 	 */
-	FOR_ALL_TILES_IN_HEIGHT(h) {
-		/* Transform height from range h_water_level..h_max into 0..h_max_new range */
-		*h = (height_t)(((int)h_max_new) * (*h - h_water_level) / (h_max - h_water_level)) + I2H(1);
-		/* Make sure all values are in the proper range (0..h_max_new) */
-		if (*h < 0) *h = I2H(0);
-		if (*h >= h_max_new) *h = h_max_new - 1;
-	}
+	HeightMapParallel(_height_map.size_y + 1, [h_water_level, h_max, h_max_new](uint, int first, int last) {
+		for (int y = first; y < last; y++) {
+			/* Transform height from range h_water_level..h_max into 0..h_max_new range;
+			 * make sure all values are in the proper range (0..h_max_new) */
+			_tgp_kernels->rescale(&_height_map.height(0, y), _height_map.dim_x, h_water_level, h_max, h_max_new, I2H(1));
+		}
+	});
 
 	free(hist_buf);
 }
@@ -727,55 +926,62 @@ static void HeightMapCoastLines(uint8 water_borders)
 {
 	int smallest_size = min(_settings_game.game_creation.map_x, _settings_game.game_creation.map_y);
 	const int margin = 4;
-	int y, x;
-	double max_x;
-	double max_y;
-
-	/* Lower to sea level */
-	for (y = 0; y <= _height_map.size_y; y++) {
-		if (HasBit(water_borders, BORDER_NE)) {
-			/* Top right */
-			max_x = abs((perlin_coast_noise_2D(_height_map.size_y - y, y, 0.9, 53) + 0.25) * 5 + (perlin_coast_noise_2D(y, y, 0.35, 179) + 1) * 12);
-			max_x = max((smallest_size * smallest_size / 64) + max_x, (smallest_size * smallest_size / 64) + margin - max_x);
-			if (smallest_size < 8 && max_x > 5) max_x /= 1.5;
-			for (x = 0; x < max_x; x++) {
-				_height_map.height(x, y) = 0;
-			}
-		}
 
-		if (HasBit(water_borders, BORDER_SW)) {
-			/* Bottom left */
-			max_x = abs((perlin_coast_noise_2D(_height_map.size_y - y, y, 0.85, 101) + 0.3) * 6 + (perlin_coast_noise_2D(y, y, 0.45,  67) + 0.75) * 8);
-			max_x = max((smallest_size * smallest_size / 64) + max_x, (smallest_size * smallest_size / 64) + margin - max_x);
-			if (smallest_size < 8 && max_x > 5) max_x /= 1.5;
-			for (x = _height_map.size_x; x > (_height_map.size_x - 1 - max_x); x--) {
-				_height_map.height(x, y) = 0;
+	/* Lower to sea level; every job only touches its own rows */
+	HeightMapParallel(_height_map.size_y + 1, [water_borders, smallest_size, margin](uint, int first, int last) {
+		for (int y = first; y < last; y++) {
+			double max_x;
+			int x;
+
+			if (HasBit(water_borders, BORDER_NE)) {
+				/* Top right */
+				max_x = abs((perlin_coast_noise_2D(_height_map.size_y - y, y, 0.9, 53) + 0.25) * 5 + (perlin_coast_noise_2D(y, y, 0.35, 179) + 1) * 12);
+				max_x = max((smallest_size * smallest_size / 64) + max_x, (smallest_size * smallest_size / 64) + margin - max_x);
+				if (smallest_size < 8 && max_x > 5) max_x /= 1.5;
+				for (x = 0; x < max_x; x++) {
+					_height_map.height(x, y) = 0;
+				}
 			}
-		}
-	}
 
-	/* Lower to sea level */
-	for (x = 0; x <= _height_map.size_x; x++) {
-		if (HasBit(water_borders, BORDER_NW)) {
-			/* Top left */
-			max_y = abs((perlin_coast_noise_2D(x, _height_map.size_y / 2, 0.9, 167) + 0.4) * 5 + (perlin_coast_noise_2D(x, _height_map.size_y / 3, 0.4, 211) + 0.7) * 9);
-			max_y = max((smallest_size * smallest_size / 64) + max_y, (smallest_size * smallest_size / 64) + margin - max_y);
-			if (smallest_size < 8 && max_y > 5) max_y /= 1.5;
-			for (y = 0; y < max_y; y++) {
-				_height_map.height(x, y) = 0;
+			if (HasBit(water_borders, BORDER_SW)) {
+				/* Bottom left */
+				max_x = abs((perlin_coast_noise_2D(_height_map.size_y - y, y, 0.85, 101) + 0.3) * 6 + (perlin_coast_noise_2D(y, y, 0.45,  67) + 0.75) * 8);
+				max_x = max((smallest_size * smallest_size / 64) + max_x, (smallest_size * smallest_size / 64) + margin - max_x);
+				if (smallest_size < 8 && max_x > 5) max_x /= 1.5;
+				for (x = _height_map.size_x; x > (_height_map.size_x - 1 - max_x); x--) {
+					_height_map.height(x, y) = 0;
+				}
 			}
 		}
+	});
+
+	/* Lower to sea level; every job only touches its own columns */
+	HeightMapParallel(_height_map.size_x + 1, [water_borders, smallest_size, margin](uint, int first, int last) {
+		for (int x = first; x < last; x++) {
+			double max_y;
+			int y;
+
+			if (HasBit(water_borders, BORDER_NW)) {
+				/* Top left */
+				max_y = abs((perlin_coast_noise_2D(x, _height_map.size_y / 2, 0.9, 167) + 0.4) * 5 + (perlin_coast_noise_2D(x, _height_map.size_y / 3, 0.4, 211) + 0.7) * 9);
+				max_y = max((smallest_size * smallest_size / 64) + max_y, (smallest_size * smallest_size / 64) + margin - max_y);
+				if (smallest_size < 8 && max_y > 5) max_y /= 1.5;
+				for (y = 0; y < max_y; y++) {
+					_height_map.height(x, y) = 0;
+				}
+			}
 
-		if (HasBit(water_borders, BORDER_SE)) {
-			/* Bottom right */
-			max_y = abs((perlin_coast_noise_2D(x, _height_map.size_y / 3, 0.85, 71) + 0.25) * 6 + (perlin_coast_noise_2D(x, _height_map.size_y / 3, 0.35, 193) + 0.75) * 12);
-			max_y = max((smallest_size * smallest_size / 64) + max_y, (smallest_size * smallest_size / 64) + margin - max_y);
-			if (smallest_size < 8 && max_y > 5) max_y /= 1.5;
-			for (y = _height_map.size_y; y > (_height_map.size_y - 1 - max_y); y--) {
-				_height_map.height(x, y) = 0;
+			if (HasBit(water_borders, BORDER_SE)) {
+				/* Bottom right */
+				max_y = abs((perlin_coast_noise_2D(x, _height_map.size_y / 3, 0.85, 71) + 0.25) * 6 + (perlin_coast_noise_2D(x, _height_map.size_y / 3, 0.35, 193) + 0.75) * 12);
+				max_y = max((smallest_size * smallest_size / 64) + max_y, (smallest_size * smallest_size / 64) + margin - max_y);
+				if (smallest_size < 8 && max_y > 5) max_y /= 1.5;
+				for (y = _height_map.size_y; y > (_height_map.size_y - 1 - max_y); y--) {
+					_height_map.height(x, y) = 0;
+				}
 			}
 		}
-	}
+	});
 }
 
 /** Start at given point, move in given direction, find and Smooth coast in that direction */
@@ -840,52 +1046,102 @@ static void HeightMapSmoothCoasts(uint8 water_borders)
  */
 static void HeightMapSmoothSlopes(height_t dh_max)
 {
-	for (int y = 0; y <= (int)_height_map.size_y; y++) {
-		for (int x = 0; x <= (int)_height_map.size_x; x++) {
-			height_t h_max = min(_height_map.height(x > 0 ? x - 1 : x, y), _height_map.height(x, y > 0 ? y - 1 : y)) + dh_max;
-			if (_height_map.height(x, y) > h_max) _height_map.height(x, y) = h_max;
-		}
+	/* Each tile only depends on the final heights of its neighbours towards
+	 * the start of the pass. Splitting the map into blocks and processing
+	 * them by anti-diagonal (wave) guarantees those neighbours are done, so
+	 * the blocks of one wave can run in parallel and the result is the same
+	 * as a plain sequential pass. */
+	const int bs = SMOOTH_SLOPES_BLOCK_SIZE;
+	const int blocks_x = _height_map.size_x / bs + 1;
+	const int blocks_y = _height_map.size_y / bs + 1;
+	const int waves = blocks_x + blocks_y - 1;
+
+	for (int wave = 0; wave < waves; wave++) {
+		int first = max(0, wave - (blocks_y - 1));
+		int last = min(wave, blocks_x - 1);
+		WorkerPool::Run(last - first + 1, [wave, first, bs, dh_max](uint i) {
+			int x0 = (first + i) * bs;
+			int y0 = (wave - first - i) * bs;
+			int x1 = min(x0 + bs, _height_map.size_x + 1);
+			int y1 = min(y0 + bs, _height_map.size_y + 1);
+			for (int y = y0; y < y1; y++) {
+				for (int x = x0; x < x1; x++) {
+					height_t h_max = min(_height_map.height(x > 0 ? x - 1 : x, y), _height_map.height(x, y > 0 ? y - 1 : y)) + dh_max;
+					if (_height_map.height(x, y) > h_max) _height_map.height(x, y) = h_max;
+				}
+			}
+		});
 	}
-	for (int y = _height_map.size_y; y >= 0; y--) {
-		for (int x = _height_map.size_x; x >= 0; x--) {
-			height_t h_max = min(_height_map.height(x < _height_map.size_x ? x + 1 : x, y), _height_map.height(x, y < _height_map.size_y ? y + 1 : y)) + dh_max;
-			if (_height_map.height(x, y) > h_max) _height_map.height(x, y) = h_max;
-		}
+	for (int wave = waves - 1; wave >= 0; wave--) {
+		int first = max(0, wave - (blocks_y - 1));
+		int last = min(wave, blocks_x - 1);
+		WorkerPool::Run(last - first + 1, [wave, first, bs, dh_max](uint i) {
+			int x0 = (first + i) * bs;
+			int y0 = (wave - first - i) * bs;
+			int x1 = min(x0 + bs, _height_map.size_x + 1);
+			int y1 = min(y0 + bs, _height_map.size_y + 1);
+			for (int y = y1 - 1; y >= y0; y--) {
+				for (int x = x1 - 1; x >= x0; x--) {
+					height_t h_max = min(_height_map.height(x < _height_map.size_x ? x + 1 : x, y), _height_map.height(x, y < _height_map.size_y ? y + 1 : y)) + dh_max;
+					if (_height_map.height(x, y) > h_max) _height_map.height(x, y) = h_max;
+				}
+			}
+		});
 	}
 }
 
+/**
+ * Run a stage of generating the height map, timing it for the benchmark.
+ * @param times The time taken by every stage so far, or \c nullptr when not timing.
+ * @param stage The stage that is run.
+ * @param func The stage to run.
+ */
+template <typename Tfunc>
+static void HeightMapStage(uint64 *times, TgpStage stage, Tfunc func)
+{
+	if (times == nullptr) {
+		func();
+		return;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	func();
+	times[stage] += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
 /**
  * Height map terraform post processing:
  *  - water level adjusting
  *  - coast Smoothing
  *  - slope Smoothing
  *  - height histogram redistribution by sine wave transform
+ * @param times The time taken by every stage so far, or \c nullptr when not timing.
  */
-static void HeightMapNormalize()
+static void HeightMapNormalize(uint64 *times = nullptr)
 {
 	int sea_level_setting = _settings_game.difficulty.quantity_sea_lakes;
 	const amplitude_t water_percent = sea_level_setting != (int)CUSTOM_SEA_LEVEL_NUMBER_DIFFICULTY ? _water_percent[sea_level_setting] : _settings_game.game_creation.custom_sea_level * 1024 / 100;
 	const height_t h_max_new = TGPGetMaxHeight();
 	const height_t roughness = 7 + 3 * _settings_game.game_creation.tgen_smoothness;
 
-	HeightMapAdjustWaterLevel(water_percent, h_max_new);
+	HeightMapStage(times, TGPS_WATER_LEVEL, [&] { HeightMapAdjustWaterLevel(water_percent, h_max_new); });
 
 	byte water_borders = _settings_game.construction.freeform_edges ? _settings_game.game_creation.water_borders : 0xF;
 	if (water_borders == BORDERS_RANDOM) water_borders = GB(Random(), 0, 4);
 
-	HeightMapCoastLines(water_borders);
-	HeightMapSmoothSlopes(roughness);
+	HeightMapStage(times, TGPS_COASTS, [&] { HeightMapCoastLines(water_borders); });
+	HeightMapStage(times, TGPS_SMOOTH_SLOPES, [&] { HeightMapSmoothSlopes(roughness); });
 
-	HeightMapSmoothCoasts(water_borders);
-	HeightMapSmoothSlopes(roughness);
+	HeightMapStage(times, TGPS_COASTS, [&] { HeightMapSmoothCoasts(water_borders); });
+	HeightMapStage(times, TGPS_SMOOTH_SLOPES, [&] { HeightMapSmoothSlopes(roughness); });
 
-	HeightMapSineTransform(I2H(1), h_max_new);
+	HeightMapStage(times, TGPS_SINE, [&] { HeightMapSineTransform(I2H(1), h_max_new); });
 
 	if (_settings_game.game_creation.variety > 0) {
-		HeightMapCurves(_settings_game.game_creation.variety);
+		HeightMapStage(times, TGPS_CURVES, [&] { HeightMapCurves(_settings_game.game_creation.variety); });
 	}
 
-	HeightMapSmoothSlopes(I2H(1));
+	HeightMapStage(times, TGPS_SMOOTH_SLOPES, [&] { HeightMapSmoothSlopes(I2H(1)); });
 }
 
 /**
@@ -960,15 +1216,19 @@ static double perlin_coast_noise_2D(const double x, const double y, const double
 }
 
 
-/** A small helper function to initialize the terrain */
-static void TgenSetTileHeight(TileIndex tile, int height)
+/**
+ * A small helper function to initialize the terrain.
+ * This is called from the worker threads, so it writes the map arrays directly
+ * and uses MakeClearUnmarked, as SetTileHeight and MakeClear also mark the
+ * arrays as changed. The caller does that once all tiles are done.
+ */
+static void TgenSetTileHeight(TileIndex tile, uint height)
 {
-	SetTileHeight(tile, height);
+	assert(height <= MAX_TILE_HEIGHT);
+	_m_height[tile] = height;
 
 	/* Only clear the tiles within the map area. */
-	if (IsInnerTile(tile)) {
-		MakeClear(tile, CLEAR_GRASS, 3);
-	}
+	if (IsInnerTile(tile)) MakeClearUnmarked(tile, CLEAR_GRASS, 3);
 }
 
 /**
@@ -980,7 +1240,9 @@ static void TgenSetTileHeight(TileIndex tile, int height)
  */
 void GenerateTerrainPerlin()
 {
-	if (!AllocHeightMap()) return;
+	InitializeTgpKernels();
+
+	if (!AllocHeightMap(MapSizeX(), MapSizeY())) return;
 	GenerateWorldSetAbortCallback(FreeHeightMap);
 
 	HeightMapGenerate();
@@ -999,15 +1261,66 @@ void GenerateTerrainPerlin()
 
 	int max_height = H2I(TGPGetMaxHeight());
 
-	/* Transfer height map into OTTD map */
-	for (int y = 0; y < _height_map.size_y; y++) {
-		for (int x = 0; x < _height_map.size_x; x++) {
-			TgenSetTileHeight(TileXY(x, y), Clamp(H2I(_height_map.height(x, y)), 0, max_height));
+	/* Transfer height map into OTTD map; this only touches the tile itself */
+	HeightMapParallel(_height_map.size_y, [max_height](uint, int first, int last) {
+		for (int y = first; y < last; y++) {
+			for (int x = 0; x < _height_map.size_x; x++) {
+				TgenSetTileHeight(TileXY(x, y), Clamp(H2I(_height_map.height(x, y)), 0, max_height));
+			}
 		}
-	}
+	});
+	_m_height_changed = true;
+	_m_type_changed = true;
 
 	IncreaseGeneratingWorldProgress(GWP_LANDSCAPE);
 
 	FreeHeightMap();
 	GenerateWorldSetAbortCallback(nullptr);
 }
+
+/**
+ * Time generating the height map of a square map with every set of kernels
+ * the CPU supports. Every set generates the height map from the same seed
+ * and the results are compared with those of the reference, which applies
+ * the sine transform and curve maps per tile without lookup tables. Only the
+ * height map is generated; the map itself and the random state of the game
+ * are left alone. The other map generation settings are the current ones.
+ * @param size_bits The logarithm of the length of the sides of the map.
+ * @param runs Number of times to generate the height map with every set.
+ * @return The time every set of kernels took, the reference last.
+ */
+std::vector<TgpBenchmarkResult> BenchmarkTerrainPerlin(uint size_bits, uint runs)
+{
+	assert(size_bits >= MIN_MAP_SIZE_BITS && size_bits <= MAX_MAP_SIZE_BITS);
+
+	InitializeTgpKernels();
+	const TgpKernels *used_kernels = _tgp_kernels;
+
+	SavedRandomSeeds saved_seeds;
+	SaveRandomSeeds(&saved_seeds);
+
+	std::vector<TgpBenchmarkResult> results;
+	std::vector<height_t> reference;
+	for (int i = lengthof(_tgp_kernel_sets) - 1; i >= 0; i--) {
+		if (!_tgp_kernel_sets[i].checker()) continue;
+		_tgp_kernels = &_tgp_kernel_sets[i];
+
+		TgpBenchmarkResult result = { _tgp_kernels->name, {}, true };
+		for (uint run = 0; run < runs; run++) {
+			SetRandomSeed(_settings_game.game_creation.generation_seed);
+			AllocHeightMap(1 << size_bits, 1 << size_bits);
+
+			HeightMapStage(result.time, TGPS_GENERATE, [] { HeightMapGenerate(); });
+			HeightMapNormalize(result.time);
+
+			if (reference.empty()) reference.assign(_height_map.h, _height_map.h + _height_map.total_size);
+			if (!std::equal(reference.begin(), reference.end(), _height_map.h)) result.identical = false;
+			FreeHeightMap();
+		}
+		results.insert(results.begin(), result);
+	}
+
+	RestoreRandomSeeds(saved_seeds);
+	_tgp_kernels = used_kernels;
+	return results;
+}
@@ -10,6 +10,27 @@
 #ifndef TGP_H
 #define TGP_H
 
+#include <vector>
+
+/** Stages of generating the height map, as timed by the benchmark. */
+enum TgpStage {
+	TGPS_GENERATE,      ///< Adding the noise of every frequency.
+	TGPS_WATER_LEVEL,   ///< Rescaling for the amount of water.
+	TGPS_COASTS,        ///< Making and smoothing the coast lines.
+	TGPS_SMOOTH_SLOPES, ///< Smoothing the slopes.
+	TGPS_SINE,          ///< The sine transform of the heights.
+	TGPS_CURVES,        ///< Applying the curve maps for variety.
+	TGPS_END,           ///< End marker.
+};
+
+/** Time taken to generate the height map with one set of row kernels. */
+struct TgpBenchmarkResult {
+	const char *kernels;    ///< Name of the set of kernels.
+	uint64 time[TGPS_END];  ///< Time taken by every stage over all runs, in microseconds.
+	bool identical;         ///< Whether every height map equals the one of the reference.
+};
+
 void GenerateTerrainPerlin();
+std::vector<TgpBenchmarkResult> BenchmarkTerrainPerlin(uint size_bits, uint runs);
 
 #endif /* TGP_H */
@@ -0,0 +1,29 @@
+/*
+ * This file is part of OpenTTD.
+ * OpenTTD is free software; you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 2.
+ * OpenTTD is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details. You should have received a copy of the GNU General Public License along with OpenTTD. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file tgp_kernels.h Types and functions of the row kernels of the TerraGenesis Perlin generator. */
+
+#ifndef TGP_KERNELS_H
+#define TGP_KERNELS_H
+
+/** Type for method for checking whether a set of kernels can be used. */
+typedef bool (*TgpKernelChecker)();
+/** Type for the kernel storing the average of two rows of heights. */
+typedef void (*TgpAverageRowsProc)(int16 *dst, const int16 *a, const int16 *b, int count);
+/** Type for the kernel updating the minimum, maximum and sum with a row of heights. */
+typedef void (*TgpMinMaxSumProc)(const int16 *h, int count, int16 *h_min, int16 *h_max, int64 *h_accu);
+/** Type for the kernel rescaling a row of heights from water_level..h_max to sea_level..h_max_new. */
+typedef void (*TgpRescaleProc)(int16 *h, int count, int water_level, int h_max, int h_max_new, int sea_level);
+
+#ifdef WITH_SSE
+bool TgpKernelsSSE2Checker();
+void TgpAverageRowsSSE2(int16 *dst, const int16 *a, const int16 *b, int count);
+void TgpMinMaxSumSSE2(const int16 *h, int count, int16 *h_min, int16 *h_max, int64 *h_accu);
+void TgpRescaleSSE2(int16 *h, int count, int water_level, int h_max, int h_max_new, int sea_level);
+#endif
+
+#endif /* TGP_KERNELS_H */
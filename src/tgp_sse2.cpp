@@ -0,0 +1,169 @@
+/*
+ * This file is part of OpenTTD.
+ * OpenTTD is free software; you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 2.
+ * OpenTTD is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details. You should have received a copy of the GNU General Public License along with OpenTTD. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file tgp_sse2.cpp Row kernels of the TerraGenesis Perlin generator that use SSE2. */
+
+#ifdef WITH_SSE
+
+#include "stdafx.h"
+#include "cpu.h"
+#include "tgp_kernels.h"
+#include "core/math_func.hpp"
+#include <emmintrin.h>
+
+#include "safeguards.h"
+
+/**
+ * Sign extend the low 16 bits of every 32 bits lane, i.e. a cast to int16 and back.
+ * @param v The lanes to truncate.
+ * @return The truncated lanes.
+ */
+static inline __m128i TruncateToInt16(__m128i v)
+{
+	return _mm_srai_epi32(_mm_slli_epi32(v, 16), 16);
+}
+
+/**
+ * Store the average of two rows of heights, rounded towards zero.
+ * @param dst Row to write.
+ * @param a First row to average.
+ * @param b Second row to average.
+ * @param count Number of heights in the rows.
+ */
+void TgpAverageRowsSSE2(int16 *dst, const int16 *a, const int16 *b, int count)
+{
+	int i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m128i va = _mm_loadu_si128((const __m128i *)(a + i));
+		__m128i vb = _mm_loadu_si128((const __m128i *)(b + i));
+
+		/* Widen to 32 bits so the sum cannot overflow. */
+		__m128i lo = _mm_add_epi32(_mm_srai_epi32(_mm_unpacklo_epi16(va, va), 16), _mm_srai_epi32(_mm_unpacklo_epi16(vb, vb), 16));
+		__m128i hi = _mm_add_epi32(_mm_srai_epi32(_mm_unpackhi_epi16(va, va), 16), _mm_srai_epi32(_mm_unpackhi_epi16(vb, vb), 16));
+
+		/* Add one to negative sums, so the shift rounds towards zero like the division does. */
+		lo = _mm_srai_epi32(_mm_add_epi32(lo, _mm_srli_epi32(lo, 31)), 1);
+		hi = _mm_srai_epi32(_mm_add_epi32(hi, _mm_srli_epi32(hi, 31)), 1);
+
+		_mm_storeu_si128((__m128i *)(dst + i), _mm_packs_epi32(lo, hi));
+	}
+	for (; i < count; i++) dst[i] = (a[i] + b[i]) / 2;
+}
+
+/**
+ * Update the minimum, maximum and sum of heights with a row of heights.
+ * @param h The row of heights.
+ * @param count Number of heights in the row.
+ * @param[in,out] h_min The minimum height.
+ * @param[in,out] h_max The maximum height.
+ * @param[in,out] h_accu The sum of the heights.
+ */
+void TgpMinMaxSumSSE2(const int16 *h, int count, int16 *h_min, int16 *h_max, int64 *h_accu)
+{
+	const __m128i ones = _mm_set1_epi16(1);
+	__m128i vmin = _mm_set1_epi16(*h_min);
+	__m128i vmax = _mm_set1_epi16(*h_max);
+	int64 accu = 0;
+
+	int i = 0;
+	const int vec_end = count & ~7;
+	while (i < vec_end) {
+		/* Every lane grows by at most 2 * 32768 per step, so flush the 32 bits sums regularly. */
+		const int block_end = min(vec_end, i + 8 * 4096);
+		__m128i vsum = _mm_setzero_si128();
+		for (; i < block_end; i += 8) {
+			__m128i v = _mm_loadu_si128((const __m128i *)(h + i));
+			vmin = _mm_min_epi16(vmin, v);
+			vmax = _mm_max_epi16(vmax, v);
+			vsum = _mm_add_epi32(vsum, _mm_madd_epi16(v, ones));
+		}
+
+		int32 sums[4];
+		_mm_storeu_si128((__m128i *)sums, vsum);
+		accu += (int64)sums[0] + sums[1] + sums[2] + sums[3];
+	}
+
+	int16 mins[8], maxs[8];
+	_mm_storeu_si128((__m128i *)mins, vmin);
+	_mm_storeu_si128((__m128i *)maxs, vmax);
+	for (int j = 0; j < 8; j++) {
+		if (mins[j] < *h_min) *h_min = mins[j];
+		if (maxs[j] > *h_max) *h_max = maxs[j];
+	}
+
+	for (; i < count; i++) {
+		if (h[i] < *h_min) *h_min = h[i];
+		if (h[i] > *h_max) *h_max = h[i];
+		accu += h[i];
+	}
+	*h_accu += accu;
+}
+
+/**
+ * Rescale four heights, widened to 32 bits, for #TgpRescaleSSE2.
+ * The numerator and denominator are exact in doubles and far from the
+ * 53 bits of precision, so the truncated quotient equals the integer division.
+ * @param v The heights.
+ * @param water_level The height that becomes sea level.
+ * @param scale The new maximum height.
+ * @param range The old height range above water level.
+ * @param sea_level The sea level.
+ * @return The rescaled heights, wrapped to 16 bits.
+ */
+static inline __m128i RescaleHeights(__m128i v, __m128i water_level, __m128d scale, __m128d range, __m128i sea_level)
+{
+	__m128i d = _mm_sub_epi32(v, water_level);
+	__m128d lo = _mm_div_pd(_mm_mul_pd(_mm_cvtepi32_pd(d), scale), range);
+	__m128d hi = _mm_div_pd(_mm_mul_pd(_mm_cvtepi32_pd(_mm_shuffle_epi32(d, _MM_SHUFFLE(1, 0, 3, 2))), scale), range);
+	__m128i q = _mm_unpacklo_epi64(_mm_cvttpd_epi32(lo), _mm_cvttpd_epi32(hi));
+	return TruncateToInt16(_mm_add_epi32(TruncateToInt16(q), sea_level));
+}
+
+/**
+ * Rescale a row of heights from water_level..h_max into sea_level..h_max_new, clamped to 0..h_max_new - 1.
+ * @param h The row of heights.
+ * @param count Number of heights in the row.
+ * @param water_level The height that becomes sea level.
+ * @param h_max The old maximum height.
+ * @param h_max_new The new maximum height.
+ * @param sea_level The sea level.
+ */
+void TgpRescaleSSE2(int16 *h, int count, int water_level, int h_max, int h_max_new, int sea_level)
+{
+	const __m128i vwater = _mm_set1_epi32(water_level);
+	const __m128i vsea = _mm_set1_epi32(sea_level);
+	const __m128d scale = _mm_set1_pd(h_max_new);
+	const __m128d range = _mm_set1_pd(h_max - water_level);
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i top = _mm_set1_epi16(h_max_new - 1);
+
+	int i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(h + i));
+		__m128i lo = RescaleHeights(_mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16), vwater, scale, range, vsea);
+		__m128i hi = RescaleHeights(_mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16), vwater, scale, range, vsea);
+		v = _mm_min_epi16(_mm_max_epi16(_mm_packs_epi32(lo, hi), zero), top);
+		_mm_storeu_si128((__m128i *)(h + i), v);
+	}
+	for (; i < count; i++) {
+		int16 v = (int16)(h_max_new * (h[i] - water_level) / (h_max - water_level)) + sea_level;
+		if (v < 0) v = 0;
+		if (v >= h_max_new) v = h_max_new - 1;
+		h[i] = v;
+	}
+}
+
+/**
+ * Check whether the SSE2 kernels can be used.
+ * @return True when the CPU supports SSE2.
+ */
+bool TgpKernelsSSE2Checker()
+{
+	return HasCPUIDFlag(1, 3, 26);
+}
+
+#endif /* WITH_SSE */
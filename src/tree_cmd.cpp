@@ -19,6 +19,7 @@
 #include "company_func.h"
 #include "sound_func.h"
 #include "water.h"
+#include "pathfinder/yapf/yapf_cache.h"
 #include "company_base.h"
 #include "core/random_func.hpp"
 #include "newgrf_generic.h"
@@ -718,7 +719,10 @@ static void TileLoop_Trees(TileIndex tile)
 			} else {
 				/* just one tree, change type into MP_CLEAR */
 				switch (GetTreeGround(tile)) {
-					case TREE_GROUND_SHORE: MakeShore(tile); break;
+					case TREE_GROUND_SHORE:
+						MakeShore(tile);
+						YapfNotifyWaterLayoutChange(tile);
+						break;
 					case TREE_GROUND_GRASS: MakeClear(tile, CLEAR_GRASS, GetTreeDensity(tile)); break;
 					case TREE_GROUND_ROUGH: MakeClear(tile, CLEAR_ROUGH, 3); break;
 					case TREE_GROUND_ROUGH_SNOW: {
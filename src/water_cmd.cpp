@@ -38,6 +38,7 @@
 #include "company_gui.h"
 #include "newgrf_generic.h"
 #include "industry.h"
+#include "pathfinder/yapf/yapf_cache.h"
 
 #include "table/strings.h"
 
@@ -249,6 +250,8 @@ void MakeWaterKeepingClass(TileIndex tile, Owner o)
 
 	if (wc != WATER_CLASS_INVALID) CheckForDockingTile(tile);
 	MarkTileDirtyByTile(tile);
+	/* The water tracks of the tile changed, e.g. from a depot's axis to all directions. */
+	YapfNotifyWaterLayoutChange(tile);
 }
 
 static CommandCost RemoveShipDepot(TileIndex tile, DoCommandFlag flags)
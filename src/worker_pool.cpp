@@ -0,0 +1,180 @@
+/*
+ * This file is part of OpenTTD.
+ * OpenTTD is free software; you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 2.
+ * OpenTTD is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details. You should have received a copy of the GNU General Public License along with OpenTTD. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file worker_pool.cpp Implementation of the pool of worker threads. */
+
+#include "stdafx.h"
+#include "worker_pool.h"
+#include "thread.h"
+#include "core/math_func.hpp"
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+#include "safeguards.h"
+
+/** Maximum number of worker threads we are going to start. */
+static const uint MAX_WORKER_THREADS = 16;
+
+/** A batch of jobs that has been submitted to the pool. */
+struct WorkerBatch {
+	const WorkerPool::Job *job; ///< Function to call for every job.
+	uint count;                 ///< Number of jobs in this batch.
+	uint next;                  ///< Next job that still has to be picked up.
+	uint done;                  ///< Number of jobs that have finished.
+};
+
+static std::mutex _worker_mutex;                  ///< Lock protecting all state of the worker pool.
+static std::condition_variable _worker_wakeup;    ///< Signalled when there is new work or when exiting.
+static std::condition_variable _worker_finished;  ///< Signalled when a batch has finished.
+static std::deque<WorkerBatch *> _worker_batches; ///< Batches that still have jobs to pick up.
+static std::vector<std::thread> _worker_threads;  ///< The started worker threads.
+static bool _worker_threads_started = false;      ///< Whether we already tried to start the threads.
+static bool _worker_exit = false;                 ///< Whether the workers should stop.
+
+/**
+ * Pick up the next job of the oldest batch with unclaimed jobs.
+ * Must be called with #_worker_mutex held.
+ * @param[out] job Number of the claimed job.
+ * @return The batch the job belongs to, or \c nullptr if there is no work.
+ */
+static WorkerBatch *ClaimJob(uint *job)
+{
+	while (!_worker_batches.empty()) {
+		WorkerBatch *batch = _worker_batches.front();
+		if (batch->next < batch->count) {
+			*job = batch->next++;
+			return batch;
+		}
+		_worker_batches.pop_front();
+	}
+	return nullptr;
+}
+
+/**
+ * Mark a job of a batch as done and wake the submitter when it was the last one.
+ * Must be called with #_worker_mutex held.
+ * @param batch The batch the job belonged to.
+ */
+static void FinishJob(WorkerBatch *batch)
+{
+	if (++batch->done == batch->count) _worker_finished.notify_all();
+}
+
+/** Main loop of a worker thread. */
+static void WorkerThreadLoop()
+{
+	std::unique_lock<std::mutex> lock(_worker_mutex);
+	for (;;) {
+		uint job;
+		WorkerBatch *batch = ClaimJob(&job);
+		if (batch == nullptr) {
+			if (_worker_exit) return;
+			_worker_wakeup.wait(lock);
+			continue;
+		}
+
+		lock.unlock();
+		(*batch->job)(job);
+		lock.lock();
+		FinishJob(batch);
+	}
+}
+
+/**
+ * Start the worker threads, if that did not happen yet.
+ * Must be called with #_worker_mutex held.
+ */
+static void StartWorkerThreads()
+{
+	if (_worker_threads_started) return;
+	_worker_threads_started = true;
+
+	/* The submitting thread helps out, so one thread less is needed. */
+	uint threads = min(std::thread::hardware_concurrency(), MAX_WORKER_THREADS + 1);
+	for (uint i = 1; i < threads; i++) {
+		std::thread t;
+		if (!StartNewThread(&t, "ottd:worker", &WorkerThreadLoop)) break;
+		_worker_threads.push_back(std::move(t));
+	}
+}
+
+/**
+ * Get the number of threads that execute jobs, including the submitting thread.
+ * @return The number of threads.
+ */
+/* static */ uint WorkerPool::GetThreadCount()
+{
+	std::lock_guard<std::mutex> lock(_worker_mutex);
+	StartWorkerThreads();
+	return (uint)_worker_threads.size() + 1;
+}
+
+/**
+ * Execute a batch of jobs and wait for all of them to finish.
+ * Can be called from any thread, also concurrently, but not from within a job.
+ * @param count Number of jobs; \a job is called for every number in [0, count).
+ * @param job Function to execute for every job.
+ */
+/* static */ void WorkerPool::Run(uint count, const Job &job)
+{
+	if (count == 0) return;
+
+	std::unique_lock<std::mutex> lock(_worker_mutex);
+	StartWorkerThreads();
+
+	if (count == 1 || _worker_threads.empty() || _worker_exit) {
+		lock.unlock();
+		for (uint i = 0; i < count; i++) job(i);
+		return;
+	}
+
+	WorkerBatch batch = { &job, count, 0, 0 };
+	_worker_batches.push_back(&batch);
+	_worker_wakeup.notify_all();
+
+	/* Help out with our own batch until all of its jobs are claimed. */
+	while (batch.next < batch.count) {
+		uint i = batch.next++;
+		lock.unlock();
+		job(i);
+		lock.lock();
+		FinishJob(&batch);
+	}
+
+	while (batch.done < batch.count) _worker_finished.wait(lock);
+
+	/* All jobs are claimed, but the batch may still be queued if nobody noticed yet. */
+	for (auto it = _worker_batches.begin(); it != _worker_batches.end(); ++it) {
+		if (*it == &batch) {
+			_worker_batches.erase(it);
+			break;
+		}
+	}
+}
+
+/** Stop all worker threads; jobs submitted after this are executed on the calling thread. */
+/* static */ void WorkerPool::Exit()
+{
+	{
+		std::lock_guard<std::mutex> lock(_worker_mutex);
+		_worker_exit = true;
+		_worker_wakeup.notify_all();
+	}
+
+	for (std::thread &t : _worker_threads) {
+		if (t.joinable()) t.join();
+	}
+	_worker_threads.clear();
+}
+
+/** Stops the worker threads before the state they use is destroyed on exit. */
+static struct WorkerPoolCleanup {
+	~WorkerPoolCleanup() { WorkerPool::Exit(); }
+} _worker_pool_cleanup;
@@ -0,0 +1,35 @@
+/*
+ * This file is part of OpenTTD.
+ * OpenTTD is free software; you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 2.
+ * OpenTTD is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details. You should have received a copy of the GNU General Public License along with OpenTTD. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file worker_pool.h Pool of worker threads for running independent jobs in parallel. */
+
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <functional>
+
+/**
+ * A pool of worker threads shared by the whole game. Work is handed out as a
+ * batch of numbered jobs; the thread submitting the batch helps executing it
+ * and only returns once every job of the batch has finished.
+ *
+ * The pool itself does not give any guarantee about the order in which jobs
+ * are executed. Callers that need deterministic results (e.g. anything that
+ * affects the game state) must let every job write to its own slot and do any
+ * reduction afterwards, in job order, on the submitting thread.
+ */
+class WorkerPool {
+public:
+	/** Function executed for every job; gets the number of the job. */
+	typedef std::function<void(uint)> Job;
+
+	static void Run(uint count, const Job &job);
+	static uint GetThreadCount();
+	static void Exit();
+};
+
+#endif /* WORKER_POOL_H */